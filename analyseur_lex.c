@@ -1,67 +1,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-
-typedef enum {
-    PROGRAM = 1,
-    BEGIN, 
-    END, 
-    VAR, 
-    INTEGER, 
-    CHAR, 
-    IF, 
-    THEN, 
-    ELSE, 
-    WHILE, 
-    DO,
-    READ, 
-    READLN, 
-    WRITE, 
-    WRITELN, 
-    ID, 
-    NB, 
-    OPREL, 
-    OPADD, 
-    OPMUL,
-    PV, 
-    DP, 
-    V, 
-    PERIODE, 
-    LPAR, 
-    RPAR, 
-    AFF, 
-    COMM_OUV, 
-    COMM_FER, 
-    EOF_TOKEN, 
-    ERROR
-} TokenType;
-
-typedef struct {
-    TokenType type;
-    char lexeme[100];
-} Token;
-
-/* keywords */
-const char *keywords[] = {
-    "program", "begin", "end", "var", "integer", "char", "if", "then", "else",
-    "while", "do", "read", "readln", "write", "writeln"
-};
-const TokenType keywordTypes[] = {
-    PROGRAM, BEGIN, END, VAR, INTEGER, CHAR, IF, THEN, ELSE,
-    WHILE, DO, READ, READLN, WRITE, WRITELN
-};
-const int KEYWORDS_COUNT = 15;
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-int isKeyword(const char *word, TokenType *type) {
-    for (int i = 0; i < KEYWORDS_COUNT; ++i) {
-        if (strcmp(word, keywords[i]) == 0) {
-            *type = keywordTypes[i];
-            return 1;
-        }
-    }
-    return 0;
-}
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "analyseur_lex.h"
+#include "mots_cles.h"
+#include "tokens_bin.h"
 
 const char *tokenTypeToString(TokenType t) {
     switch (t) {
@@ -100,18 +54,87 @@ const char *tokenTypeToString(TokenType t) {
     }
 }
 
-Token getNextToken(FILE *file) {
+/* Character classes driving both lexers. Every byte maps to one class;
+   CC_SINGLE bytes form a token on their own, whose type is in single_type. */
+enum {
+    CC_OTHER = 0,
+    CC_SPACE,
+    CC_LETTER,
+    CC_DIGIT,
+    CC_SINGLE,
+    CC_LT,
+    CC_GT,
+    CC_COLON,
+    CC_PIPE
+};
+
+static const unsigned char char_class[256] = {
+    [' '] = CC_SPACE, ['\t'] = CC_SPACE, ['\n'] = CC_SPACE, ['\r'] = CC_SPACE,
+    ['a' ... 'z'] = CC_LETTER, ['A' ... 'Z'] = CC_LETTER,
+    ['0' ... '9'] = CC_DIGIT,
+    ['('] = CC_SINGLE, [')'] = CC_SINGLE, ['='] = CC_SINGLE,
+    ['+'] = CC_SINGLE, ['-'] = CC_SINGLE,
+    ['*'] = CC_SINGLE, ['/'] = CC_SINGLE, ['%'] = CC_SINGLE,
+    [';'] = CC_SINGLE, [','] = CC_SINGLE, ['.'] = CC_SINGLE,
+    ['<'] = CC_LT, ['>'] = CC_GT, [':'] = CC_COLON, ['|'] = CC_PIPE
+};
+
+static const unsigned char single_type[256] = {
+    ['('] = LPAR, [')'] = RPAR, ['='] = OPREL,
+    ['+'] = OPADD, ['-'] = OPADD,
+    ['*'] = OPMUL, ['/'] = OPMUL, ['%'] = OPMUL,
+    [';'] = PV, [','] = V, ['.'] = PERIODE,
+    ['<'] = OPREL, ['>'] = OPREL, [':'] = DP, ['|'] = ERROR
+};
+
+/* characters consumed since lexer_start(), for token source offsets */
+static _Thread_local unsigned long lex_pos = 0;
+
+static int lex_getc(FILE *file) {
+    int c = fgetc(file);
+    if (c != EOF) lex_pos++;
+    return c;
+}
+
+static void lex_ungetc(int c, FILE *file) {
+    ungetc(c, file);
+    lex_pos--;
+}
+
+static Token scanToken(FILE *file) {
     Token token;
+    int c, d;
+    int pos = 0;
+    int too_long = 0;
+
     token.type = ERROR;
     token.lexeme[0] = '\0';
+    token.text = NULL;
 
-    int c;
-    int pos = 0;
+    /* skip whitespace and comments; a comment just restarts the loop */
+    for (;;) {
+        do {
+            c = lex_getc(file);
+        } while (c != EOF && char_class[c] == CC_SPACE);
 
-    /* skip whitespace */
-    do {
-        c = fgetc(file);
-    } while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+        if (c != '(') break;
+        d = lex_getc(file);
+        if (d != '*') {
+            if (d != EOF) lex_ungetc(d, file);
+            break;
+        }
+
+        int star = 0;
+        token.offset = (unsigned)(lex_pos - 2);
+        while ((c = lex_getc(file)) != EOF && !(star && c == ')')) star = (c == '*');
+        if (c == EOF) {
+            token.type = ERROR;
+            strcpy(token.lexeme, "Commentaire non fermé");
+            return token;
+        }
+    }
+
+    token.offset = (unsigned)(c == EOF ? lex_pos : lex_pos - 1);
 
     if (c == EOF) {
         token.type = EOF_TOKEN;
@@ -121,205 +144,415 @@ Token getNextToken(FILE *file) {
 
     token.lexeme[pos++] = (char)c;
     token.lexeme[pos] = '\0';
+    token.type = single_type[c];
+
+    switch (char_class[c]) {
+        /* ( ) = + - * / % ; , . */
+        case CC_SINGLE:
+            return token;
 
-    /* comment or left parenthesis */
-    if (c == '(') {
-        int d = fgetc(file);
-        if (d == '*') { 
-            while (1) {
-                int x = fgetc(file);
-                if (x == EOF) {
-                    token.type = ERROR;
-                    strcpy(token.lexeme, "Commentaire non fermé");
-                    return token;
+        /* relational operators < <= <> > >= */
+        case CC_LT:
+        case CC_GT:
+            d = lex_getc(file);
+            if (d == '=' || (c == '<' && d == '>')) token.lexeme[pos++] = (char)d;
+            else if (d != EOF) lex_ungetc(d, file);
+            token.lexeme[pos] = '\0';
+            return token;
+
+        /* assignment or colon */
+        case CC_COLON:
+            d = lex_getc(file);
+            if (d == '=') {
+                token.type = AFF;
+                strcpy(token.lexeme, ":=");
+                return token;
+            }
+            if (d != EOF) lex_ungetc(d, file);
+            return token;
+
+        /* || is additive, a lone | is invalid */
+        case CC_PIPE:
+            d = lex_getc(file);
+            if (d == '|') {
+                token.type = OPADD;
+                strcpy(token.lexeme, "||");
+                return token;
+            }
+            if (d != EOF) lex_ungetc(d, file);
+            break;
+
+        /* identifiers and keywords */
+        case CC_LETTER:
+            while ((d = lex_getc(file)) != EOF) {
+                if (char_class[d] != CC_LETTER && char_class[d] != CC_DIGIT) {
+                    lex_ungetc(d, file);
+                    break;
                 }
-                if (x == '*') {
-                    int y = fgetc(file);
-                    if (y == ')') {
-                        return getNextToken(file);
-                    } else {
-                        if (y != EOF) ungetc(y, file);
-                    }
+                if (pos < (int)sizeof(token.lexeme) - 1) token.lexeme[pos++] = (char)d;
+                else too_long = 1;
+            }
+            token.lexeme[pos] = '\0';
+            if (too_long) break;
+            if (!keyword_lookup(token.lexeme, (unsigned)pos, &token.type)) token.type = ID;
+            return token;
+
+        /* numbers */
+        case CC_DIGIT:
+            while ((d = lex_getc(file)) != EOF) {
+                if (char_class[d] != CC_DIGIT) {
+                    lex_ungetc(d, file);
+                    break;
                 }
+                if (pos < (int)sizeof(token.lexeme) - 1) token.lexeme[pos++] = (char)d;
+                else too_long = 1;
             }
-        } else {
-            if (d != EOF) ungetc(d, file);
-            token.type = LPAR;
-            token.lexeme[0] = '(';
-            token.lexeme[1] = '\0';
+            token.lexeme[pos] = '\0';
+            if (too_long) break;
+            token.type = NB;
             return token;
-        }
     }
 
-    /* relational operators */
-    if (c == '<') {
-        int d = fgetc(file);
-        if (d == '=') { 
-            token.type = OPREL; 
-            strcpy(token.lexeme, "<="); 
-            return token; 
-        }
-        if (d == '>') { 
-            token.type = OPREL; 
-            strcpy(token.lexeme, "<>"); 
-            return token; 
-        }
-        if (d != EOF) ungetc(d, file);
-        token.type = OPREL; 
-        token.lexeme[0] = '<'; 
-        token.lexeme[1] = '\0'; 
+    /* the lexeme would not fit: an error rather than another name */
+    if (too_long) {
+        token.type = ERROR;
+        strcpy(token.lexeme, "Lexème trop long");
         return token;
     }
-    if (c == '>') {
-        int d = fgetc(file);
-        if (d == '=') { 
-            token.type = OPREL; 
-            strcpy(token.lexeme, ">="); 
-            return token; 
+
+    /* unknown char */
+    token.type = ERROR;
+    sprintf(token.lexeme, "Caractère invalide: %c", (char)c);
+    return token;
+}
+
+void lexer_start(void) {
+    lex_pos = 0;
+}
+
+Token getNextToken(FILE *file) {
+    Token token = scanToken(file);
+    token.length = (unsigned)(lex_pos - token.offset);
+    return token;
+}
+
+/* ---------- zero-copy lexer over a mapped source ---------- */
+
+int source_open(Source *src, const char *filename) {
+    int fd = strcmp(filename, "-") == 0 ? STDIN_FILENO : open(filename, O_RDONLY);
+    struct stat st;
+
+    memset(src, 0, sizeof(*src));
+    if (fd < 0) return -1;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        src->size = (size_t)st.st_size;
+        if (src->size == 0) {
+            src->text = "";
+        } else {
+            void *map = mmap(NULL, src->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                if (fd != STDIN_FILENO) close(fd);
+                return -1;
+            }
+            madvise(map, src->size, MADV_SEQUENTIAL);
+            src->text = map;
+            src->mapped = 1;
         }
-        if (d != EOF) ungetc(d, file);
-        token.type = OPREL; 
-        token.lexeme[0] = '>'; 
-        token.lexeme[1] = '\0'; 
-        return token;
-    }
-    if (c == '=') {
-        token.type = OPREL; 
-        token.lexeme[0] = '='; 
-        token.lexeme[1] = '\0'; 
-        return token;
+    } else {
+        /* pipe or terminal: slurp it into one growing buffer */
+        size_t capacity = 1 << 16;
+        char *buffer = malloc(capacity);
+        ssize_t n;
+        while (buffer != NULL && (n = read(fd, buffer + src->size, capacity - src->size)) > 0) {
+            src->size += (size_t)n;
+            if (src->size == capacity) {
+                char *grown = realloc(buffer, capacity *= 2);
+                if (grown == NULL) free(buffer);
+                buffer = grown;
+            }
+        }
+        if (buffer == NULL) {
+            if (fd != STDIN_FILENO) close(fd);
+            return -1;
+        }
+        src->text = buffer;
     }
 
-    /* assignment or colon */
-    if (c == ':') {
-        int d = fgetc(file);
-        if (d == '=') { 
-            token.type = AFF; 
-            strcpy(token.lexeme, ":="); 
-            return token; }
-        if (d != EOF) ungetc(d, file);
-        token.type = DP; 
-        token.lexeme[0] = ':'; 
-        token.lexeme[1] = '\0'; 
-        return token;
-    }
+    if (fd != STDIN_FILENO) close(fd);
+    return 0;
+}
 
-    /* additive operators + - || */
-    if (c == '+' || c == '-') {
-        token.type = OPADD;
-        token.lexeme[0] = (char)c;
-        token.lexeme[1] = '\0';
-        return token;
-    }
-    if (c == '|') {
-        int d = fgetc(file);
-        if (d == '|') { 
-            token.type = OPADD; 
-            strcpy(token.lexeme, "||"); 
-            return token; 
-        }
+void source_from_buffer(Source *src, const char *text, size_t size) {
+    src->text = text;
+    src->size = size;
+    src->pos = 0;
+    src->mapped = -1;
+}
 
-        if (d != EOF) ungetc(d, file);
-        token.type = ERROR;
-        sprintf(token.lexeme, "Caractère invalide: %c", '|');
-        return token;
-    }
+void source_close(Source *src) {
+    if (src->mapped == 1) munmap((void *)src->text, src->size);
+    else if (src->mapped == 0 && src->size > 0) free((void *)src->text);
+    memset(src, 0, sizeof(*src));
+}
 
-    /* multiplicative operators */
-    if (c == '*' || c == '/' || c == '%') {
-        token.type = OPMUL;
-        token.lexeme[0] = (char)c;
-        token.lexeme[1] = '\0';
-        return token;
+/*
+ * Run scanners for the mapped lexer. Each returns the first byte at or
+ * after p that ends the run (end if none). The vector loops only load
+ * whole blocks inside [p, end); the scalar loop finishes the tail and is
+ * the whole implementation without SSE2.
+ */
+#if defined(__AVX2__)
+#define LEX_VEC 32
+typedef __m256i lex_vec;
+#define vec_load(p)        _mm256_loadu_si256((const __m256i *)(p))
+#define vec_set1(c)        _mm256_set1_epi8((char)(c))
+#define vec_eq(a, b)       _mm256_cmpeq_epi8(a, b)
+#define vec_lt(a, b)       _mm256_cmpgt_epi8(b, a)
+#define vec_or(a, b)       _mm256_or_si256(a, b)
+#define vec_and(a, b)      _mm256_and_si256(a, b)
+#define vec_add(a, b)      _mm256_add_epi8(a, b)
+#define vec_mask(v)        ((uint32_t)_mm256_movemask_epi8(v))
+#define VEC_ALL            0xFFFFFFFFu
+#elif defined(__SSE2__)
+#define LEX_VEC 16
+typedef __m128i lex_vec;
+#define vec_load(p)        _mm_loadu_si128((const __m128i *)(p))
+#define vec_set1(c)        _mm_set1_epi8((char)(c))
+#define vec_eq(a, b)       _mm_cmpeq_epi8(a, b)
+#define vec_lt(a, b)       _mm_cmplt_epi8(a, b)
+#define vec_or(a, b)       _mm_or_si128(a, b)
+#define vec_and(a, b)      _mm_and_si128(a, b)
+#define vec_add(a, b)      _mm_add_epi8(a, b)
+#define vec_mask(v)        ((uint32_t)_mm_movemask_epi8(v))
+#define VEC_ALL            0xFFFFu
+#endif
+
+#ifdef LEX_VEC
+/* unsigned (x - lo) < n, done as a signed compare after biasing by 0x80 */
+static inline lex_vec vec_in_range(lex_vec v, unsigned char lo, unsigned char n) {
+    return vec_lt(vec_add(v, vec_set1(0x80 - lo)), vec_set1(0x80 + n));
+}
+
+static inline lex_vec vec_is_space(lex_vec v) {
+    return vec_or(vec_or(vec_eq(v, vec_set1(' ')), vec_eq(v, vec_set1('\t'))),
+                  vec_or(vec_eq(v, vec_set1('\n')), vec_eq(v, vec_set1('\r'))));
+}
+
+static inline lex_vec vec_is_digit(lex_vec v) {
+    return vec_in_range(v, '0', 10);
+}
+
+static inline lex_vec vec_is_alnum(lex_vec v) {
+    return vec_or(vec_in_range(vec_or(v, vec_set1(0x20)), 'a', 26), vec_is_digit(v));
+}
+#endif
+
+static inline const unsigned char *skip_space(const unsigned char *p, const unsigned char *end) {
+#ifdef LEX_VEC
+    if (p < end && char_class[*p] != CC_SPACE) return p;
+    while (end - p >= LEX_VEC) {
+        uint32_t stop = ~vec_mask(vec_is_space(vec_load(p))) & VEC_ALL;
+        if (stop) return p + __builtin_ctz(stop);
+        p += LEX_VEC;
     }
+#endif
+    while (p < end && char_class[*p] == CC_SPACE) p++;
+    return p;
+}
 
-    /* punctuation */
-    if (c == ';') {
-        token.type = PV;
-        token.lexeme[0] = ';';
-        token.lexeme[1] = '\0';
-        return token; 
+static inline const unsigned char *scan_alnum(const unsigned char *p, const unsigned char *end) {
+#ifdef LEX_VEC
+    while (end - p >= LEX_VEC) {
+        uint32_t stop = ~vec_mask(vec_is_alnum(vec_load(p))) & VEC_ALL;
+        if (stop) return p + __builtin_ctz(stop);
+        p += LEX_VEC;
     }
-    if (c == ',') { 
-        token.type = V;
-        token.lexeme[0] = ','; 
-        token.lexeme[1] = '\0'; 
-        return token; 
+#endif
+    while (p < end && (char_class[*p] == CC_LETTER || char_class[*p] == CC_DIGIT)) p++;
+    return p;
+}
+
+static inline const unsigned char *scan_digits(const unsigned char *p, const unsigned char *end) {
+#ifdef LEX_VEC
+    while (end - p >= LEX_VEC) {
+        uint32_t stop = ~vec_mask(vec_is_digit(vec_load(p))) & VEC_ALL;
+        if (stop) return p + __builtin_ctz(stop);
+        p += LEX_VEC;
     }
-    if (c == '.') { 
-        token.type = PERIODE;  
-        token.lexeme[0] = '.'; 
-        token.lexeme[1] = '\0'; 
-        return token; 
+#endif
+    while (p < end && char_class[*p] == CC_DIGIT) p++;
+    return p;
+}
+
+/* position of the '*' of the first "*)" at or after p, or NULL */
+static inline const unsigned char *find_comment_end(const unsigned char *p, const unsigned char *end) {
+#ifdef LEX_VEC
+    while (end - p > LEX_VEC) {
+        lex_vec star = vec_eq(vec_load(p), vec_set1('*'));
+        lex_vec paren = vec_eq(vec_load(p + 1), vec_set1(')'));
+        uint32_t hit = vec_mask(vec_and(star, paren));
+        if (hit) return p + __builtin_ctz(hit);
+        p += LEX_VEC;
     }
-    if (c == ')') { 
-        token.type = RPAR; 
-        token.lexeme[0] = ')'; 
-        token.lexeme[1] = '\0'; 
-        return token; 
+#endif
+    for (; p + 1 < end; ++p) {
+        if (p[0] == '*' && p[1] == ')') return p;
     }
+    return NULL;
+}
 
-    /* identifiers and keywords */
-    if (isalpha(c)) {
-        pos = 0;
-        token.lexeme[pos++] = (char)c;
-        while (1) {
-            int d = fgetc(file);
-            if (d == EOF) break;
-            if (!isalnum(d)) { ungetc(d, file); break; }
-            if (pos < (int)sizeof(token.lexeme) - 1) token.lexeme[pos++] = (char)d;
-        }
-        token.lexeme[pos] = '\0';
+SpanToken nextSpanToken(Source *src) {
+    const unsigned char *text = (const unsigned char *)src->text;
+    const unsigned char *end = text + src->size;
+    const unsigned char *p = text + src->pos;
+    const unsigned char *start;
+    SpanToken token;
 
-        /* lowercase copy for keyword check */
-        char lower[100];
-        for (int i = 0; token.lexeme[i] && i < (int)sizeof(lower)-1; ++i) lower[i] = (char)tolower((unsigned char)token.lexeme[i]);
-        lower[strlen(token.lexeme)] = '\0';
+    for (;;) {
+        p = skip_space(p, end);
+        if (p == end || *p != '(' || p + 1 == end || p[1] != '*') break;
 
-        TokenType kwType;
-        if (isKeyword(lower, &kwType)) token.type = kwType;
-        else token.type = ID;
-        return token;
+        /* comments are skipped in this loop, not by recursion */
+        const unsigned char *close = find_comment_end(p + 2, end);
+        if (close == NULL) {
+            token.type = ERROR;
+            token.offset = (unsigned)(p - text);
+            token.length = (unsigned)(end - p);
+            src->pos = src->size;
+            return token;
+        }
+        p = close + 2;
     }
 
-    /* numbers */
-    if (isdigit(c)) {
-        pos = 0;
-        token.lexeme[pos++] = (char)c;
-        while (1) {
-            int d = fgetc(file);
-            if (d == EOF) break;
-            if (!isdigit(d)) { ungetc(d, file); break; }
-            if (pos < (int)sizeof(token.lexeme) - 1) token.lexeme[pos++] = (char)d;
-        }
-        token.lexeme[pos] = '\0';
-        token.type = NB;
+    start = p;
+    token.offset = (unsigned)(p - text);
+
+    if (p == end) {
+        token.type = EOF_TOKEN;
+        token.length = 0;
+        src->pos = src->size;
         return token;
     }
 
-    /* unknown char */
-    token.type = ERROR;
-    sprintf(token.lexeme, "Caractère invalide: %c", (char)c);
+    unsigned char c = *p++;
+    token.type = (TokenType)single_type[c];
+
+    switch (char_class[c]) {
+        case CC_LETTER:
+            p = scan_alnum(p, end);
+            token.length = (unsigned)(p - start);
+            if (!keyword_lookup((const char *)start, token.length, &token.type)) token.type = ID;
+            break;
+        case CC_DIGIT:
+            p = scan_digits(p, end);
+            token.type = NB;
+            break;
+        case CC_SINGLE:
+            break;
+        case CC_LT:
+            if (p < end && (*p == '=' || *p == '>')) p++;
+            break;
+        case CC_GT:
+            if (p < end && *p == '=') p++;
+            break;
+        case CC_COLON:
+            if (p < end && *p == '=') { token.type = AFF; p++; }
+            break;
+        case CC_PIPE:
+            if (p < end && *p == '|') { token.type = OPADD; p++; }
+            break;
+        default:
+            token.type = ERROR;
+            break;
+    }
+    token.length = (unsigned)(p - start);
+    src->pos = (size_t)(p - text);
     return token;
 }
 
-int main(void) {
-    FILE *input = fopen("program.txt", "r");
-    FILE *output = fopen("tokens.txt", "w");
+void spanTokenToToken(const Source *src, SpanToken span, Token *token) {
+    const char *text = src->text + span.offset;
+
+    token->type = span.type;
+    token->offset = span.offset;
+    token->length = span.length;
+    token->text = NULL;
+
+    if (span.type == EOF_TOKEN) {
+        strcpy(token->lexeme, "EOF");
+    } else if (span.type == ERROR) {
+        if (span.length >= 2 && text[0] == '(' && text[1] == '*')
+            strcpy(token->lexeme, "Commentaire non fermé");
+        else
+            sprintf(token->lexeme, "Caractère invalide: %c", text[0]);
+    } else {
+        token->text = text;
+    }
+}
+
+/* The compiler links this file with analyseur_synt.c and defines
+   ANALYSEUR_LEX_SANS_MAIN so that only the parser's main() remains. */
+#ifndef ANALYSEUR_LEX_SANS_MAIN
+int main(int argc, char **argv) {
+    const char *source = "program.txt";
+    const char *output_name = NULL;
+    int binary = 0;
+    int mapped = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-b") == 0) binary = 1;
+        else if (strcmp(argv[i], "-m") == 0) mapped = 1;
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output_name = argv[++i];
+        else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            fprintf(stderr, "Usage: %s [-b] [-m] [-o sortie] [source]\n", argv[0]);
+            fprintf(stderr, "  -b  binary token stream (default output tokens.bin)\n");
+            fprintf(stderr, "  -m  zero-copy lexer over the mapped source (\"-\" reads stdin)\n");
+            return 1;
+        }
+        else source = argv[i];
+    }
+    if (output_name == NULL) output_name = binary ? "tokens.bin" : "tokens.txt";
+
+    Source src;
+    FILE *input = NULL;
+    if (mapped ? source_open(&src, source) != 0 : (input = fopen(source, "r")) == NULL) {
+        perror("Erreur ouverture fichier");
+        return 1;
+    }
+    if (!mapped) lexer_start();
+    FILE *output = binary ? NULL : fopen(output_name, "w");
+    TokBinWriter *bin = binary ? tokbin_create(output_name) : NULL;
 
-    if (!input || !output) {
+    if (binary ? !bin : !output) {
         perror("Erreur ouverture fichier");
         return 1;
     }
 
     Token t;
     do {
-        t = getNextToken(input);
-        fprintf(output, "Token: %s (Code: %d)\n",
-                t.lexeme, (int)t.type);
+        if (mapped) spanTokenToToken(&src, nextSpanToken(&src), &t);
+        else t = getNextToken(input);
+        if (binary) {
+            if (tokbin_write(bin, &t) != 0) {
+                perror("Erreur ecriture tokens");
+                return 1;
+            }
+        } else {
+            write_text_token(output, &t);
+        }
     } while (t.type != EOF_TOKEN);
 
-    fclose(input);
-    fclose(output);
+    if (mapped) source_close(&src);
+    else fclose(input);
+    if (binary) {
+        if (tokbin_finish(bin) != 0) {
+            perror("Erreur ecriture tokens");
+            return 1;
+        }
+    } else {
+        fclose(output);
+    }
     return 0;
 }
+#endif
@@ -0,0 +1,99 @@
+#ifndef ANALYSEUR_LEX_H
+#define ANALYSEUR_LEX_H
+
+#include <stdio.h>
+#include <string.h>
+
+typedef enum {
+    PROGRAM = 1,
+    BEGIN,
+    END,
+    VAR,
+    INTEGER,
+    CHAR,
+    IF,
+    THEN,
+    ELSE,
+    WHILE,
+    DO,
+    READ,
+    READLN,
+    WRITE,
+    WRITELN,
+    ID,
+    NB,
+    OPREL,
+    OPADD,
+    OPMUL,
+    PV,
+    DP,
+    V,
+    PERIODE,
+    LPAR,
+    RPAR,
+    AFF,
+    COMM_OUV,
+    COMM_FER,
+    EOF_TOKEN,
+    ERROR
+} TokenType;
+
+typedef struct {
+    TokenType type;
+    char lexeme[100];   /* unless text is set */
+    const char *text;   /* NULL, or the length characters of the token where
+                           they lie in memory (mapped source or token file),
+                           not NUL-terminated; lexeme is then not filled */
+    unsigned offset;    /* position of the token in the source */
+    unsigned length;    /* number of source characters it covers */
+} Token;
+
+/* the characters of a token, token_size() of them ("%.*s") */
+static inline const char *token_chars(const Token *token) {
+    return token->text != NULL ? token->text : token->lexeme;
+}
+
+static inline unsigned token_size(const Token *token) {
+    return token->text != NULL ? token->length : (unsigned)strlen(token->lexeme);
+}
+
+const char *tokenTypeToString(TokenType t);
+
+/* before getNextToken() reads a stream: token offsets count from 0 at the
+   point it is at, which need not be seekable */
+void lexer_start(void);
+/* reads the next token from a source file; an identifier or a number
+   longer than lexeme holds is an ERROR token */
+Token getNextToken(FILE *file);
+
+/*
+ * Zero-copy mode: the whole source is mapped (or read in one call when it
+ * is not a regular file) and tokens are views into that buffer. Token
+ * text is never copied or truncated; spanTokenToToken() makes the Token
+ * of a span, which points into the buffer.
+ */
+typedef struct {
+    TokenType type;
+    unsigned offset;
+    unsigned length;
+} SpanToken;
+
+typedef struct {
+    const char *text;
+    size_t size;
+    size_t pos;
+    int mapped;
+} Source;
+
+/* filename "-" is standard input; returns 0 on success, -1 with errno set */
+int source_open(Source *src, const char *filename);
+/* wraps a caller-owned buffer, e.g. for benchmarks */
+void source_from_buffer(Source *src, const char *text, size_t size);
+void source_close(Source *src);
+
+SpanToken nextSpanToken(Source *src);
+/* copies type, offset and length, and points token->text at the span in
+   src; only EOF and errors get a lexeme, the one getNextToken() gives */
+void spanTokenToToken(const Source *src, SpanToken span, Token *token);
+
+#endif
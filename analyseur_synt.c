@@ -1,586 +1,934 @@
+#include <errno.h>
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-
-
-typedef enum {
-    PROGRAM = 1,
-    BEGIN, 
-    END, 
-    VAR, 
-    INTEGER, 
-    CHAR, 
-    IF, 
-    THEN, 
-    ELSE, 
-    WHILE, 
-    DO,
-    READ, 
-    READLN, 
-    WRITE, 
-    WRITELN, 
-    ID, 
-    NB, 
-    OPREL, 
-    OPADD, 
-    OPMUL,
-    PV,        
-    DP,        
-    V,         
-    PERIOD,    
-    LPAR,      
-    RPAR,      
-    AFF,       
-    COMM_OUV,  
-    COMM_FER,  
-    EOF_TOKEN, 
-    ERROR
-} TokenType;
+#include "analyseur_lex.h"
+#include "analyseur_synt.h"
+#include "aot.h"
+#include "code.h"
+#include "ast.h"
+#include "cfg.h"
+#include "dataflow.h"
+#include "erreur.h"
+#include "ir.h"
+#include "jit.h"
+#include "module.h"
+#include "peephole.h"
+#include "symtab.h"
+#include "tokens_bin.h"
+#include "vm.h"
+
+_Thread_local Token currentToken;
+static _Thread_local int trace;
+
+#define LOOKAHEAD_SIZE 16   /* power of two */
 
 typedef struct {
-    TokenType type;
-    char lexeme[100];
-} Token;
-
-Token currentToken;
-
-
-#define SYMTAB_SIZE 200
-
-typedef struct {
-    char name[100];
-    TokenType type; 
-    int declared;   
-    int address;    
-} Symbol;
-
-static Symbol symtab[SYMTAB_SIZE];
-static int symtab_count = 0;
-static int next_address = 0;
-
-static char last_declared[100][100];
-static int last_declared_count = 0;
-static TokenType current_decl_type = ERROR;
-
-#define CODE_SIZE 1000
-typedef struct {
-    char instruction[100];
-} ligne_code;
-
-static ligne_code code[CODE_SIZE];
-static int code_index = 0;
-static int label_counter = 0;
+    TokenSource source;
+    int open;               /* src, file or bin is open */
+    Source src;
+    FILE *file;
+    TokBinReader bin;
+    TokBinWriter *save;     /* optional copy of the stream in binary form */
+    const SpanToken *spans; /* SOURCE_SPAN_ARRAY */
+    unsigned next_span;     /* tokens taken from spans or hooks */
+    const ParseHooks *hooks;
+    int eof;
+    Token ring[LOOKAHEAD_SIZE];
+    unsigned head;
+    unsigned count;
+} TokenStream;
+
+/* interned id of the identifier in currentToken */
+int current_name(void) {
+    return intern(token_chars(&currentToken), token_size(&currentToken));
+}
 
-/* generer code instruction */
-void generer(const char *instruction) {
-    if (code_index >= CODE_SIZE) {
-        fprintf(stderr, "Code memory overflow\n");
-        exit(1);
+/* names declared so far, by interned id: a use of any other is reported
+   where it is, before a syntax error further on */
+static _Thread_local unsigned char *declared = NULL;
+static _Thread_local int declared_capacity = 0;
+
+static void declare_name(int name) {
+    if (name >= declared_capacity) {
+        int capacity = declared_capacity ? declared_capacity : 64;
+        while (capacity <= name) capacity *= 2;
+        unsigned char *grown = realloc(declared, (size_t)capacity);
+        if (grown == NULL) erreur("Symbol table overflow");
+        memset(grown + declared_capacity, 0, (size_t)(capacity - declared_capacity));
+        declared = grown;
+        declared_capacity = capacity;
     }
-    strcpy(code[code_index].instruction, instruction);
-    code_index++;
+    declared[name] = 1;
 }
 
-
-int nouvelle_etiquette() {
-    return label_counter++;
+/* interned id of the identifier in currentToken, which must be declared;
+   a token that is no identifier is left to match() */
+static int used_name(void) {
+    int name = current_name();
+    if (currentToken.type == ID && (name >= declared_capacity || !declared[name])) {
+        erreur("Error: Undeclared identifier '%.*s'", (int)token_size(&currentToken), token_chars(&currentToken));
+    }
+    return name;
 }
 
-void afficher_code() {
-    printf("\n--- Code pour automate a pile  ---\n");
-    for (int i = 0; i < code_index; i++) {
-        printf("%3d: %s\n", i, code[i].instruction);
+/* value of the NB in currentToken; integers are 32-bit */
+static int32_t number_value(void) {
+    const char *digits = token_chars(&currentToken);
+    unsigned size = token_size(&currentToken);
+    int64_t value = 0;
+    for (unsigned k = 0; k < size; ++k) {
+        value = value * 10 + (digits[k] - '0');
+        if (value > INT32_MAX) {
+            erreur("Error: Integer constant '%.*s' out of range", (int)size, digits);
+        }
     }
+    return (int32_t)value;
 }
 
-void write_symtab_to_file(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file %s for writing\n", filename);
-        return;
-    }
-    
-    for (int i = 0; i < symtab_count; ++i) {
-        if (symtab[i].type == INTEGER)
-            fprintf(file, "%3d: %-12s  type=INTEGER  declared=%d  address=%d\n", 
-                    i, symtab[i].name, symtab[i].declared, symtab[i].address);
-        else if (symtab[i].type == CHAR)
-            fprintf(file, "%3d: %-12s  type=CHAR     declared=%d  address=%d\n", 
-                    i, symtab[i].name, symtab[i].declared, symtab[i].address);
+/* Tokens reach the parser through a small ring buffer. In the default
+   (fused) mode it is refilled straight from the zero-copy lexer over the
+   mapped source, or from getNextToken() with --stdio; with --tokens or
+   --tokens-bin it is refilled from a file written by analyseur_lex, as in
+   the original two-program flow. */
+void ts_fill(TokenStream *ts) {
+    while (ts->count < LOOKAHEAD_SIZE && !ts->eof) {
+        Token *token = &ts->ring[(ts->head + ts->count) & (LOOKAHEAD_SIZE - 1)];
+        switch (ts->source) {
+            case SOURCE_SPANS:       spanTokenToToken(&ts->src, nextSpanToken(&ts->src), token); break;
+            case SOURCE_LEXER:       *token = getNextToken(ts->file); break;
+            case SOURCE_TEXT_TOKENS: *token = read_text_token(ts->file); break;
+            case SOURCE_BIN_TOKENS:  tokbin_read(&ts->bin, token); break;
+            case SOURCE_SPAN_ARRAY:  spanTokenToToken(&ts->src, ts->spans[ts->next_span++], token); break;
+            case SOURCE_HOOKS:       ts->hooks->next(ts->hooks->data, token); ts->next_span++; break;
+        }
+        if (ts->save != NULL && tokbin_write(ts->save, token) != 0) {
+            erreur("Error writing binary tokens");
+        }
+        if (token->type == EOF_TOKEN) ts->eof = 1;
+        ts->count++;
     }
-    fprintf(file, "\n");
-    fclose(file);
 }
 
-void write_code_to_file(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (file == NULL) {
-        fprintf(stderr, "Error opening file %s for writing\n", filename);
-        return;
+void ts_init(TokenStream *ts, TokenSource source) {
+    ts->source = source;
+    ts->open = 0;
+    ts->file = NULL;
+    ts->save = NULL;
+    ts->hooks = NULL;
+    ts->head = 0;
+    ts->count = 0;
+    ts->eof = 0;
+}
+
+/* opens the input of c in a stream initialized for c->kind */
+void ts_open(TokenStream *ts, const Compilation *c) {
+    if (ts->source == SOURCE_BIN_TOKENS) {
+        if (tokbin_open(&ts->bin, c->token_file) != 0)
+            erreur("%s: cannot read binary tokens", c->token_file);
+    } else if (ts->source == SOURCE_SPANS && c->text != NULL) {
+        source_from_buffer(&ts->src, c->text, c->size);
+    } else if (ts->source == SOURCE_SPANS) {
+        if (source_open(&ts->src, c->source) != 0) erreur("%s: %s", c->source, strerror(errno));
+    } else {
+        const char *name = c->token_file ? c->token_file : c->source;
+        ts->file = fopen(name, "r");
+        if (ts->file == NULL) erreur("%s: %s", name, strerror(errno));
+        if (ts->source == SOURCE_LEXER) lexer_start();
     }
+    ts->open = 1;
+    if (c->save_file != NULL && (ts->save = tokbin_create(c->save_file)) == NULL)
+        erreur("%s: cannot write binary tokens", c->save_file);
+}
 
-    for (int i = 0; i < code_index; i++) {
-        fprintf(file, "%3d: %s\n", i, code[i].instruction);
+/* closes what ts_open() opened; returns -1 if the binary copy could not
+   be written */
+int ts_close(TokenStream *ts) {
+    int status = 0;
+    if (ts->save != NULL && tokbin_finish(ts->save) != 0) status = -1;
+    ts->save = NULL;
+    if (ts->open) {
+        if (ts->source == SOURCE_BIN_TOKENS) tokbin_close(&ts->bin);
+        else if (ts->source == SOURCE_SPANS) source_close(&ts->src);
+        else fclose(ts->file);
+        ts->open = 0;
     }
-    fclose(file);
+    return status;
 }
 
-int symtab_get_index(const char *name) {
-    for (int i = 0; i < symtab_count; ++i) {
-        if (strcmp(symtab[i].name, name) == 0) return i;
+/* k-th token ahead of the current one (0 = next token) */
+const Token *ts_peek(TokenStream *ts, unsigned k) {
+    if (k >= LOOKAHEAD_SIZE) {
+        erreur("Lookahead %u exceeds buffer size %d", k, LOOKAHEAD_SIZE);
     }
-    return -1;
+    if (ts->count <= k) ts_fill(ts);
+    if (ts->count <= k) return &ts->ring[(ts->head + ts->count - 1) & (LOOKAHEAD_SIZE - 1)];
+    return &ts->ring[(ts->head + k) & (LOOKAHEAD_SIZE - 1)];
 }
 
-int symtab_add(const char *name) {
-    int idx = symtab_get_index(name);
-    if (idx != -1) return idx;
-    if (symtab_count >= SYMTAB_SIZE) {
-        fprintf(stderr, "Symbol table overflow\n");
-        exit(1);
+Token nextToken(TokenStream *ts) {
+    Token token = *ts_peek(ts, 0);
+    if (token.type != EOF_TOKEN) {
+        ts->head = (ts->head + 1) & (LOOKAHEAD_SIZE - 1);
+        ts->count--;
     }
-    strcpy(symtab[symtab_count].name, name);
-    symtab[symtab_count].type = ERROR;
-    symtab[symtab_count].declared = 0;
-    symtab[symtab_count].address = -1;
-    return symtab_count++;
+
+    if (trace) printf("L'analyseur lit: %.*s (Type: %d)\n", (int)token_size(&token), token_chars(&token), token.type);
+    return token;
 }
 
-void symtab_set_type_by_name(const char *name, TokenType type) {
-    int idx = symtab_get_index(name);
-    if (idx == -1) idx = symtab_add(name);
-    symtab[idx].type = type;
-    symtab[idx].declared = 1;
-    symtab[idx].address = next_address++;
+/* index of currentToken among the tokens taken from ts->spans or
+   ts->hooks (EOF_TOKEN stays in the ring once read) */
+static int ts_position(const TokenStream *ts) {
+    return (int)(ts->next_span - ts->count) - (currentToken.type != EOF_TOKEN);
 }
 
-void symtab_print(void) {
-    printf("\n--- Symbol table (%d entries) ---\n", symtab_count);
-    for (int i = 0; i < symtab_count; ++i) {
-        if(symtab[i].type == INTEGER)
-            printf("%3d: %-12s  type=INTEGER  declared=%d  address=%d\n", 
-                   i, symtab[i].name, symtab[i].declared, symtab[i].address);
-        else if(symtab[i].type == CHAR)
-            printf("%3d: %-12s  type=CHAR     declared=%d  address=%d\n", 
-                   i, symtab[i].name, symtab[i].declared, symtab[i].address);
-    }
-}
-
-Token getNextToken(FILE *file) {
-    Token token;
-    int code;
-    char lexeme[100];
-    
-    if (fscanf(file, "Token: %s (Code: %d)\n", lexeme, &code) != 2) {
-        token.type = EOF_TOKEN;
-        strcpy(token.lexeme, "EOF");
+void match(TokenType expected, TokenStream *ts) {
+    if (currentToken.type == expected) {
+        currentToken = nextToken(ts);
     } else {
-        token.type = (TokenType)code;
-        strcpy(token.lexeme, lexeme);
+        erreur("Error: Expected token type %d but got %d ('%.*s')",
+               expected, currentToken.type, (int)token_size(&currentToken), token_chars(&currentToken));
     }
-    
-    printf("L'analyseur lit: %s (Type: %d)\n", token.lexeme, token.type);
-    return token;
 }
 
-void match(TokenType expected, FILE *file) {
-    if (currentToken.type == expected) {
-        currentToken = getNextToken(file);
-    } else {
-        fprintf(stderr, "Error: Expected token type %d but got %d ('%s')\n", 
-                expected, currentToken.type, currentToken.lexeme);
-        exit(1);
-    }
-}
-
-void P(FILE *file);
-void DCL(FILE *file);
-void D(FILE *file);
-void list_id(FILE *file);
-void L(FILE *file);
-void type(FILE *file);
-void Inst_composée(FILE *file);
-void Inst(FILE *file);
-void list_Inst(FILE *file);
-void L_I(FILE *file);
-void I(FILE *file);
-void express(FILE *file);
-void S(FILE *file);
-void Terme(FILE *file);
-void T(FILE *file);
-void F(FILE *file);
-void Facteur(FILE *file);
-void Exp_simple(FILE *file);
+/* The parser only builds the syntax tree (ast.h): each function returns
+   the node it parsed, and list elements are pushed with ast_list_push().
+   Declarations, name resolution and code generation are later passes.
+   Nothing recurses on the shape of the input: lists are loops, nested
+   statements go on an explicit frame stack in I() and expressions on the
+   operand/operator stacks of Exp_simple(), so C stack use is constant. */
+
+int P(TokenStream *ts);
+void DCL(TokenStream *ts);
+void D(TokenStream *ts);
+void list_id(TokenStream *ts);
+void L(TokenStream *ts);
+int type(TokenStream *ts);
+int Inst_composée(TokenStream *ts);
+int I(TokenStream *ts);
+int express(TokenStream *ts);
+int S(TokenStream *ts, int gauche);
+int Exp_simple(TokenStream *ts);
+
+/* program ID ; DCL: returns the list of the N_DECL nodes, *ndecl of them */
+static int header(TokenStream *ts, int32_t *ndecl) {
+    match(PROGRAM, ts);
+    match(ID, ts);
+    match(PV, ts);
+    if (declared != NULL) memset(declared, 0, (size_t)declared_capacity);
+    int mark = ast_list_mark();
+    DCL(ts);
+    return ast_list_close(mark, ndecl);
+}
 
 // P -> program ID ; DCL Inst_composée .
-void P(FILE *file) {
-    match(PROGRAM, file);
-    match(ID, file);
-    match(PV, file);
-    DCL(file);
-    Inst_composée(file);
-    match(PERIOD, file);
-    generer("Halte");
+int P(TokenStream *ts) {
+    int32_t ndecl;
+    int decls = header(ts, &ndecl);
+    int body = Inst_composée(ts);
+    match(PERIODE, ts);
+    return ast_new(N_PROGRAM, ndecl, decls, body, -1);
 }
 
 // DCL -> VAR D | epsilon
-void DCL(FILE *file) {
+void DCL(TokenStream *ts) {
     if (currentToken.type == VAR) {
-        match(VAR, file);
-        D(file);
+        match(VAR, ts);
+        D(ts);
     }
 }
 
 // D -> list_id : type ; D | epsilon
-void D(FILE *file) {
-    if (currentToken.type == ID) {
-        list_id(file);
-        match(DP, file);  
-        type(file);
-        match(PV, file); 
-        for (int i = 0; i < last_declared_count; ++i) {
-            symtab_set_type_by_name(last_declared[i], current_decl_type);
-        }
-        last_declared_count = 0;
-        current_decl_type = ERROR;
-        D(file); 
+void D(TokenStream *ts) {
+    while (currentToken.type == ID) {
+        int mark = ast_list_mark();
+        list_id(ts);
+        int32_t count;
+        int names = ast_list_close(mark, &count);
+        match(DP, ts);  
+        int t = type(ts);
+        match(PV, ts); 
+        for (int k = 0; k < count; ++k) declare_name(ast_lists[names + k]);
+        int decl = ast_new(N_DECL, count, names, -1, -1);
+        ast_nodes[decl].op = (uint8_t)t;
+        ast_list_push(decl);
     }
 }
 
 // list_id -> ID L
-void list_id(FILE *file) {
+void list_id(TokenStream *ts) {
     if (currentToken.type == ID) {
-        char saved[100];
-        strcpy(saved, currentToken.lexeme);
-        symtab_add(saved);
-        if (last_declared_count < 100) {
-            strcpy(last_declared[last_declared_count++], saved);
-        }
-        match(ID, file);
-        L(file);
+        ast_list_push(current_name());
+        match(ID, ts);
+        L(ts);
     } else {
-        fprintf(stderr, "Error in list_id(): Expected ID but got %d ('%s')\n", 
-                currentToken.type, currentToken.lexeme);
-        exit(1);
+        erreur("Error in list_id(): Expected ID but got %d ('%.*s')",
+               currentToken.type, (int)token_size(&currentToken), token_chars(&currentToken));
     }
 }
 
 // L -> , ID L | epsilon
-void L(FILE *file) {
-    if (currentToken.type == V) { 
-        match(V, file);
+void L(TokenStream *ts) {
+    while (currentToken.type == V) { 
+        match(V, ts);
         if (currentToken.type == ID) {
-            char saved[100];
-            strcpy(saved, currentToken.lexeme);
-            symtab_add(saved);
-            if (last_declared_count < 100) {
-                strcpy(last_declared[last_declared_count++], saved);
-            }
-            match(ID, file);
-            L(file);
+            ast_list_push(current_name());
+            match(ID, ts);
         } else {
-            fprintf(stderr, "Error in L(): Expected ID after ',' but got %d ('%s')\n", 
-                    currentToken.type, currentToken.lexeme);
-            exit(1);
+            erreur("Error in L(): Expected ID after ',' but got %d ('%.*s')",
+                   currentToken.type, (int)token_size(&currentToken), token_chars(&currentToken));
         }
     }
 }
 
 // type -> integer | char
-void type(FILE *file) {
+int type(TokenStream *ts) {
     if (currentToken.type == INTEGER) {
-        current_decl_type = INTEGER;
-        match(INTEGER, file);
+        match(INTEGER, ts);
+        return INTEGER;
     } else if (currentToken.type == CHAR) {
-        current_decl_type = CHAR;
-        match(CHAR, file);
+        match(CHAR, ts);
+        return CHAR;
     } else {
-        fprintf(stderr, "Error: Expected type (integer or char)\n");
-        exit(1);
+        erreur("Error: Expected type (integer or char)");
     }
 }
 
 // Inst_composée -> begin Inst end
-void Inst_composée(FILE *file) {
-    match(BEGIN, file);
-    Inst(file);
-    match(END, file);
+int Inst_composée(TokenStream *ts) {
+    if (currentToken.type != BEGIN) match(BEGIN, ts);   /* reports the error */
+    return I(ts);
 }
 
-// Inst -> list_Inst | epsilon
-void Inst(FILE *file) {
-    if (currentToken.type == ID || currentToken.type == IF || currentToken.type == WHILE ||
-        currentToken.type == READ || currentToken.type == WRITE || currentToken.type == READLN ||
-        currentToken.type == WRITELN || currentToken.type == BEGIN) {
-        list_Inst(file);
-    }
+static int starts_statement(TokenType t) {
+    return t == ID || t == IF || t == WHILE || t == READ || t == WRITE ||
+           t == READLN || t == WRITELN || t == BEGIN;
 }
 
-// list_Inst -> I L_I
-void list_Inst(FILE *file) {
-    I(file);
-    L_I(file);
-}
+/* statements waiting for an inner statement to be parsed */
+typedef enum {
+    FRAME_BLOCK,        /* begin ... ; <here> */
+    FRAME_THEN,         /* if cond then <here> */
+    FRAME_ELSE,         /* if cond then I else <here> */
+    FRAME_WHILE         /* while cond do <here> */
+} FrameKind;
 
-// L_I -> ; I L_I | epsilon
-void L_I(FILE *file) {
-    while (currentToken.type == PV) {
-        match(PV, file);
-        if (currentToken.type == ID || currentToken.type == IF || currentToken.type == WHILE ||
-            currentToken.type == READ || currentToken.type == WRITE || currentToken.type == READLN ||
-            currentToken.type == WRITELN || currentToken.type == BEGIN) {
-            I(file);
-        } else {
-            break;
+typedef struct {
+    FrameKind kind;
+    int cond;           /* FRAME_BLOCK: list mark */
+    int then;
+    int start;          /* first token, for ts->hooks */
+} Frame;
+
+static _Thread_local Frame *frames = NULL;
+static _Thread_local int frame_count = 0;
+static _Thread_local int frame_capacity = 0;
+
+static void push_frame(FrameKind kind, int cond, int start) {
+    if (frame_count == frame_capacity) {
+        frame_capacity = frame_capacity ? frame_capacity * 2 : 64;
+        frames = realloc(frames, (size_t)frame_capacity * sizeof(Frame));
+        if (frames == NULL) {
+            erreur("Parser stack overflow");
         }
     }
+    frames[frame_count].kind = kind;
+    frames[frame_count].cond = cond;
+    frames[frame_count].then = -1;
+    frames[frame_count].start = start;
+    frame_count++;
 }
 
 // I -> ID := Exp_simple | if express then I else I | 
 //      while express do I | read(ID) | write(ID) | 
 //      readln(ID) | writeln(ID) | Inst_composée
-void I(FILE *file) {
-    char buffer[200];
-    int idx;
-    
-    switch (currentToken.type) {
-        case ID:
-            idx = symtab_get_index(currentToken.lexeme);
-            if (idx == -1 || symtab[idx].declared == 0) {
-                fprintf(stderr, "Error: Undeclared identifier '%s'\n", currentToken.lexeme);
-                exit(1);
-            }
-            sprintf(buffer, "Valeurg %d", symtab[idx].address);
-            generer(buffer);
-            match(ID, file);
-            match(AFF, file);
-            Exp_simple(file);
-            generer(":=");
-            break;
-        
-        case IF: {
-            int etiq_else = nouvelle_etiquette();
-            int etiq_fin = nouvelle_etiquette();
+// Inst_composée -> begin Inst end
+// Inst -> list_Inst | epsilon
+// list_Inst -> I L_I
+// L_I -> ; I L_I | epsilon
+int I(TokenStream *ts) {
+    int base = frame_count;
+    int result, name, cond;
+
+    for (;;) {
+        /* start of a statement */
+        int start = ts->hooks != NULL ? ts_position(ts) : -1;
+        switch (currentToken.type) {
+            case ID:
+                name = used_name();
+                match(ID, ts);
+                match(AFF, ts);
+                result = ast_new(N_ASSIGN, name, Exp_simple(ts), -1, -1);
+                break;
+            
+            case IF:
+                match(IF, ts);
+                cond = express(ts);
+                match(THEN, ts);
+                push_frame(FRAME_THEN, cond, start);
+                continue;
             
-            match(IF, file);
-            express(file);
-            sprintf(buffer, "Aller-si-faux Etiq_%d", etiq_else);
-            generer(buffer);
-            match(THEN, file);
-            I(file);
-            sprintf(buffer, "Aller à Etiq_%d", etiq_fin);
-            generer(buffer);
-            sprintf(buffer, "Etiq Etiq_%d", etiq_else);
-            generer(buffer);
-            if (currentToken.type == ELSE) {
-                match(ELSE, file);
-                I(file);
+            case WHILE:
+                match(WHILE, ts);
+                cond = express(ts);
+                match(DO, ts);
+                push_frame(FRAME_WHILE, cond, start);
+                continue;
+            
+            case READ:
+            case READLN:
+            case WRITE:
+            case WRITELN: {
+                NodeKind kind = (currentToken.type == READ || currentToken.type == READLN) ? N_READ : N_WRITE;
+                match(currentToken.type, ts);
+                match(LPAR, ts);
+                name = used_name();
+                match(ID, ts);
+                match(RPAR, ts);
+                result = ast_new(kind, name, -1, -1, -1);
+                break;
             }
-            sprintf(buffer, "Etiq Etiq_%d", etiq_fin);
-            generer(buffer);
-            break;
-        }
-        
-        case WHILE: {
-            int etiq_debut = nouvelle_etiquette();
-            int etiq_fin = nouvelle_etiquette();
             
-            sprintf(buffer, "Etiq Etiq_%d", etiq_debut);
-            generer(buffer);
-            match(WHILE, file);
-            express(file);
-            sprintf(buffer, "Aller-si-faux Etiq_%d", etiq_fin);
-            generer(buffer);
-            match(DO, file);
-            I(file);
-            sprintf(buffer, "Aller à Etiq_%d", etiq_debut);
-            generer(buffer);
-            sprintf(buffer, "Etiq Etiq_%d", etiq_fin);
-            generer(buffer);
-            break;
+            case BEGIN:
+                match(BEGIN, ts);
+                if (starts_statement(currentToken.type)) {
+                    push_frame(FRAME_BLOCK, ast_list_mark(), start);
+                    continue;
+                }
+                match(END, ts);
+                result = ast_new(N_BLOCK, 0, ast_list_count, -1, -1);
+                break;
+            
+            default:
+                erreur("Error in I(): Unexpected token %d ('%.*s')",
+                       currentToken.type, (int)token_size(&currentToken), token_chars(&currentToken));
         }
-        
-        case READ:
-        case READLN:
-            match(currentToken.type, file);
-            match(LPAR, file);
-            idx = symtab_get_index(currentToken.lexeme);
-            if (idx == -1 || symtab[idx].declared == 0) {
-                fprintf(stderr, "Error: Undeclared identifier '%s'\n", currentToken.lexeme);
-                exit(1);
-            }
-            sprintf(buffer, "Valeurg %d", symtab[idx].address);
-            generer(buffer);
-            generer("Lire");
-            generer(":=");
-            match(ID, file);
-            match(RPAR, file);
-            break;
-        
-        case WRITE:
-        case WRITELN:
-            match(currentToken.type, file);
-            match(LPAR, file);
-            idx = symtab_get_index(currentToken.lexeme);
-            if (idx == -1 || symtab[idx].declared == 0) {
-                fprintf(stderr, "Error: Undeclared identifier '%s'\n", currentToken.lexeme);
-                exit(1);
+
+        /* result is complete: hand it to the statements waiting for it,
+           until one of them needs another inner statement */
+        if (ts->hooks != NULL) ts->hooks->parsed(ts->hooks->data, start, ts_position(ts), result);
+        while (frame_count > base) {
+            Frame *f = &frames[frame_count - 1];
+            if (f->kind == FRAME_BLOCK) {
+                ast_list_push(result);
+                if (currentToken.type == PV) {
+                    match(PV, ts);
+                    if (starts_statement(currentToken.type)) break;
+                }
+                match(END, ts);
+                int32_t count;
+                int list = ast_list_close(f->cond, &count);
+                result = ast_new(N_BLOCK, count, list, -1, -1);
+            } else if (f->kind == FRAME_THEN && currentToken.type == ELSE) {
+                match(ELSE, ts);
+                f->kind = FRAME_ELSE;
+                f->then = result;
+                break;
+            } else if (f->kind == FRAME_THEN) {
+                result = ast_new(N_IF, 0, f->cond, result, -1);
+            } else if (f->kind == FRAME_ELSE) {
+                result = ast_new(N_IF, 0, f->cond, f->then, result);
+            } else {
+                result = ast_new(N_WHILE, 0, f->cond, result, -1);
             }
-            sprintf(buffer, "Valeurd %d", symtab[idx].address);
-            generer(buffer);
-            generer("Ecrire");
-            match(ID, file);
-            match(RPAR, file);
-            break;
-        
-        case BEGIN:
-            Inst_composée(file);
-            break;
-        
-        default:
-            fprintf(stderr, "Error in I(): Unexpected token %d ('%s')\n", 
-                    currentToken.type, currentToken.lexeme);
-            exit(1);
+            frame_count--;
+            if (ts->hooks != NULL) ts->hooks->parsed(ts->hooks->data, f->start, ts_position(ts), result);
+        }
+        if (frame_count == base) return result;
     }
 }
 
 // express -> Exp_simple S
-void express(FILE *file) {
-    Exp_simple(file);
-    S(file);
+int express(TokenStream *ts) {
+    return S(ts, Exp_simple(ts));
 }
 
 // S -> OPREL Exp_simple | epsilon
-void S(FILE *file) {
+int S(TokenStream *ts, int gauche) {
     if (currentToken.type == OPREL) {
-        char op[100];
-        strcpy(op, currentToken.lexeme);
-        match(OPREL, file);
-        Exp_simple(file);
+        const char *chars = token_chars(&currentToken);
+        char op = chars[0];
+        char op2 = token_size(&currentToken) > 1 ? chars[1] : '\0';
+        Opcode cmp = OP_COMPARER_EGAL;
+        match(OPREL, ts);
         
-        if (strcmp(op, ">") == 0) {
-            generer("Comparer-si-sup");
-        } else if (strcmp(op, "<") == 0) {
-            generer("Comparer-si-inf");
-        } else if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
-            generer("Comparer-si-égal");
-        } else if (strcmp(op, ">=") == 0) {
-            generer("Comparer-si-inf");
-            generer("Empiler 0");
-            generer("Comparer-si-égal");
-        } else if (strcmp(op, "<=") == 0) {
-            generer("Comparer-si-sup");
-            generer("Empiler 0");
-            generer("Comparer-si-égal");
-        } else if (strcmp(op, "<>") == 0 || strcmp(op, "!=") == 0) {
-            generer("Comparer-si-égal");
-            generer("Empiler 0");
-            generer("Comparer-si-égal");
+        if (op == '>' && op2 == '\0') {
+            cmp = OP_COMPARER_SUP;
+        } else if (op == '<' && op2 == '\0') {
+            cmp = OP_COMPARER_INF;
+        } else if (op == '=') {
+            cmp = OP_COMPARER_EGAL;
+        } else if (op == '>' && op2 == '=') {
+            cmp = OP_COMPARER_SUP_EGAL;
+        } else if (op == '<' && op2 == '=') {
+            cmp = OP_COMPARER_INF_EGAL;
+        } else if ((op == '<' && op2 == '>') || op == '!') {
+            cmp = OP_COMPARER_DIFF;
         }
+        int e = ast_new(N_COMPARE, 0, gauche, Exp_simple(ts), -1);
+        ast_nodes[e].op = (uint8_t)cmp;
+        return e;
     }
+    return gauche;
 }
 
-// Exp_simple -> Terme T
-void Exp_simple(FILE *file) {
-    Terme(file);
-    T(file);
+/* operator stack of Exp_simple(): node kinds, or '(' for an open parenthesis */
+#define OPEN_PAREN (-1)
+
+static _Thread_local int *operators = NULL;
+static _Thread_local int operator_count = 0;
+static _Thread_local int operator_capacity = 0;
+static _Thread_local int *operands = NULL;
+static _Thread_local int operand_count = 0;
+static _Thread_local int operand_capacity = 0;
+
+static int *push_int(int *stack, int *count, int *capacity, int value) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        stack = realloc(stack, (size_t)*capacity * sizeof(int));
+        if (stack == NULL) {
+            erreur("Parser stack overflow");
+        }
+    }
+    stack[(*count)++] = value;
+    return stack;
 }
 
-// T -> OPADD Terme T | epsilon
-void T(FILE *file) {
-    if (currentToken.type == OPADD) {
-        char op[100];
-        strcpy(op, currentToken.lexeme);
-        match(OPADD, file);
-        Terme(file);
-        
-        if (strcmp(op, "+") == 0) {
-            generer("+");
-        } else if (strcmp(op, "-") == 0) {
-            generer("-");
-        }
-        
-        T(file);
+static int precedence(int op) {
+    return (op == N_MUL || op == N_DIV || op == N_MOD) ? 2 : 1;
+}
+
+/* node kind of the OPADD or OPMUL in currentToken; the lexer also reads
+   '||', which has no operation in the stack code */
+static int operator_kind(void) {
+    switch (token_chars(&currentToken)[0]) {
+        case '+': return N_ADD;
+        case '-': return N_SUB;
+        case '*': return N_MUL;
+        case '/': return N_DIV;
+        case '%': return N_MOD;
     }
+    erreur("Error: Operator '%.*s' is not supported", (int)token_size(&currentToken), token_chars(&currentToken));
 }
 
-// Terme -> Facteur F
-void Terme(FILE *file) {
-    Facteur(file);
-    F(file);
+/* pops one operator and its two operands, pushes the new node */
+static void reduce(void) {
+    int op = operators[--operator_count];
+    int droite = operands[--operand_count];
+    int gauche = operands[--operand_count];
+    operands[operand_count++] = ast_new((NodeKind)op, 0, gauche, droite, -1);
 }
 
+// Exp_simple -> Terme T
+// T -> OPADD Terme T | epsilon
+// Terme -> Facteur F
 // F -> OPMUL Facteur F | epsilon
-void F(FILE *file) {
-    if (currentToken.type == OPMUL) {
-        char op[100];
-        strcpy(op, currentToken.lexeme);
-        match(OPMUL, file);
-        Facteur(file);
-        
-        if (strcmp(op, "*") == 0) {
-            generer("*");
-        } else if (strcmp(op, "/") == 0) {
-            generer("/");
+// Facteur -> ID | NB | (Exp_simple)
+//
+// Parsed by operator precedence: operands and pending operators are kept
+// on two explicit stacks, and an operator is reduced as soon as one of
+// lower or equal precedence follows it, which gives the left-associative
+// trees the grammar describes.
+int Exp_simple(TokenStream *ts) {
+    int operand_base = operand_count;
+    int operator_base = operator_count;
+    int open = 0;       /* parentheses opened by this expression */
+
+    for (;;) {
+        /* operand, after any number of '(' */
+        while (currentToken.type == LPAR) {
+            match(LPAR, ts);
+            operators = push_int(operators, &operator_count, &operator_capacity, OPEN_PAREN);
+            open++;
         }
-        
-        F(file);
+        int e;
+        if (currentToken.type == ID) {
+            e = ast_new(N_VAR, used_name(), -1, -1, -1);
+            match(ID, ts);
+        } else if (currentToken.type == NB) {
+            e = ast_new(N_CONST, number_value(), -1, -1, -1);
+            match(NB, ts);
+        } else {
+            erreur("Error in Facteur(): Unexpected token %d ('%.*s')",
+                   currentToken.type, (int)token_size(&currentToken), token_chars(&currentToken));
+        }
+        operands = push_int(operands, &operand_count, &operand_capacity, e);
+
+        /* closing parentheses, then an operator or the end */
+        while (open > 0 && currentToken.type == RPAR) {
+            match(RPAR, ts);
+            while (operators[operator_count - 1] != OPEN_PAREN) reduce();
+            operator_count--;
+            open--;
+        }
+        if (currentToken.type != OPADD && currentToken.type != OPMUL) {
+            if (open > 0) match(RPAR, ts);      /* reports the missing ')' */
+            break;
+        }
+        int op = operator_kind();
+        match(currentToken.type, ts);
+        while (operator_count > operator_base && operators[operator_count - 1] != OPEN_PAREN &&
+               precedence(operators[operator_count - 1]) >= precedence(op)) {
+            reduce();
+        }
+        operators = push_int(operators, &operator_count, &operator_capacity, op);
     }
+
+    while (operator_count > operator_base) reduce();
+    operand_count = operand_base;
+    return operands[operand_base];
 }
 
-// Facteur -> ID | NB | (Exp_simple)
-void Facteur(FILE *file) {
-    char buffer[200];
-    
-    switch (currentToken.type) {
-        case ID: {
-            int idx = symtab_get_index(currentToken.lexeme);
-            if (idx == -1 || symtab[idx].declared == 0) {
-                fprintf(stderr, "Error: Undeclared identifier '%s'\n", currentToken.lexeme);
-                exit(1);
-            }
-            sprintf(buffer, "Valeurd %d", symtab[idx].address);
-            generer(buffer);
-            match(ID, file);
-            break;
+void compilation_init(Compilation *c, const char *source) {
+    memset(c, 0, sizeof(*c));
+    c->source = source;
+    c->kind = SOURCE_SPANS;
+    c->optimise = 1;
+    c->passes = DF_TOUTES;
+    c->rules = PH_TOUTES;
+}
+
+/* everything after P(), from the tree of root to the output files */
+static void compiler_passes(Compilation *c, int root) {
+    sema(root);
+    if (c->optimise) {
+        optimiser(root);
+        dataflow(root, c->passes);
+        licm(root);
+    }
+    generer_programme(root, c->optimise);
+    ast_free();
+
+    for (int i = 0; i < code_index; i++) c->before += code[i].op != OP_ETIQ;
+    if ((c->optimise || c->dot_file != NULL) && cfg_build(code, code_index) == 0) {
+        if (c->optimise) {
+            cfg_simplify();
+            cfg_layout();
+            cfg_emit();
         }
-        
-        case NB:
-            sprintf(buffer, "Empiler %s", currentToken.lexeme);
-            generer(buffer);
-            match(NB, file);
-            break;
-        
-        case LPAR:
-            match(LPAR, file);
-            Exp_simple(file);
-            match(RPAR, file);
-            break;
-        
-        default:
-            fprintf(stderr, "Error in Facteur(): Unexpected token %d ('%s')\n", 
-                    currentToken.type, currentToken.lexeme);
-            exit(1);
+        if (c->dot_file != NULL && cfg_write_dot(c->dot_file) != 0)
+            erreur("%s: %s", c->dot_file, strerror(errno));
+        cfg_free();
+    }
+    peephole(code, &code_index, c->rules);
+    resoudre_etiquettes();
+    c->count = code_index;
+    if (c->stats) {
+        if (c->optimise) {
+            dataflow_print_stats(stderr);
+            fprintf(stderr, "licm invariants %d\n", licm_count);
+            cfg_print_stats(stderr);
+        }
+        peephole_print_stats(stderr);
+        fprintf(stderr, "instructions %d -> %d\n", c->before, code_index);
+    }
+
+    if (c->trace) {
+        symtab_print();
+        afficher_code();
+    }
+
+    if (c->symtab_file != NULL) write_symtab_to_file(c->symtab_file);
+    if (c->code_file != NULL) write_code_to_file(c->code_file);
+    if (c->labels_file != NULL) write_labels_to_file(c->labels_file);
+}
+
+int compiler(Compilation *c) {
+    /* static so that it is still valid when erreur() jumps back here */
+    static _Thread_local TokenStream ts;
+    ErreurCible cible = { .message = c->erreur, .size = sizeof(c->erreur) };
+
+    c->erreur[0] = '\0';
+    c->before = c->count = 0;
+    trace = c->trace;
+    code_reset();
+    intern_reset();
+    symtab_reset();
+    frame_count = operator_count = operand_count = 0;
+    ts_init(&ts, c->kind);
+
+    erreur_cible = &cible;
+    if (setjmp(cible.retour) != 0) {
+        ts_close(&ts);
+        ast_free();
+        cfg_free();
+        return -1;
+    }
+    ts_open(&ts, c);
+
+    currentToken = nextToken(&ts);
+    compiler_passes(c, P(&ts));
+
+    if (ts_close(&ts) != 0) erreur("Error writing %s", c->save_file);
+    erreur_cible = NULL;
+    return 0;
+}
+
+int compiler_ast(Compilation *c, int root) {
+    ErreurCible cible = { .message = c->erreur, .size = sizeof(c->erreur) };
+
+    c->erreur[0] = '\0';
+    c->before = c->count = 0;
+    trace = c->trace;
+    code_reset();
+    symtab_reset();
+
+    erreur_cible = &cible;
+    if (setjmp(cible.retour) != 0) {
+        ast_free();
+        cfg_free();
+        return -1;
     }
+    compiler_passes(c, root);
+    erreur_cible = NULL;
+    return 0;
 }
 
-int main() {
-    FILE *tokenFile = fopen("tokens.txt", "r");
-    if (tokenFile == NULL) {
-        perror("Error opening tokens.txt file");
+/* a parse into the thread's tree from a stream initialized by the caller */
+static void parser_start(TokenStream *ts) {
+    ts->next_span = 0;
+    trace = 0;
+    frame_count = operator_count = operand_count = 0;
+    ast_free();
+    currentToken = nextToken(ts);
+}
+
+int parser_tokens(const char *text, size_t size, const SpanToken *tokens) {
+    TokenStream ts;
+
+    ts_init(&ts, SOURCE_SPAN_ARRAY);
+    source_from_buffer(&ts.src, text, size);
+    ts.spans = tokens;
+    parser_start(&ts);
+    return P(&ts);
+}
+
+int parser_hooks(const ParseHooks *hooks) {
+    TokenStream ts;
+
+    ts_init(&ts, SOURCE_HOOKS);
+    ts.hooks = hooks;
+    parser_start(&ts);
+    return P(&ts);
+}
+
+int parser_header(const ParseHooks *hooks, int32_t *ndecl) {
+    TokenStream ts;
+
+    ts_init(&ts, SOURCE_HOOKS);
+    ts.hooks = hooks;
+    parser_start(&ts);
+    int decls = header(&ts, ndecl);
+    if (currentToken.type != BEGIN) match(BEGIN, &ts);   /* reports the error, as Inst_composée() */
+    return decls;
+}
+
+/* the statements of a block from one of them on, as I() parses them in
+   its FRAME_BLOCK frame */
+int parser_statements(const ParseHooks *hooks, const int32_t *names, int nnames, int32_t *count) {
+    TokenStream ts;
+
+    ts_init(&ts, SOURCE_HOOKS);
+    ts.hooks = hooks;
+    parser_start(&ts);
+    if (declared != NULL) memset(declared, 0, (size_t)declared_capacity);
+    for (int k = 0; k < nnames; ++k) declare_name(names[k]);
+    int mark = ast_list_mark();
+    while (starts_statement(currentToken.type)) {
+        ast_list_push(I(&ts));
+        if (currentToken.type != PV) break;
+        match(PV, &ts);
+        if (!starts_statement(currentToken.type)) break;
+        if (hooks->boundary(hooks->data, ts_position(&ts))) return ast_list_close(mark, count);
+    }
+    if (currentToken.type != END) match(END, &ts);   /* reports the error */
+    return ast_list_close(mark, count);
+}
+
+/* The batch driver (lot.c) links this file with ANALYSEUR_SYNT_SANS_MAIN
+   defined: it keeps compiler() and drops the command line and the
+   backends below. */
+#ifndef ANALYSEUR_SYNT_SANS_MAIN
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-q] [--stdio | --tokens [tokens.txt] | --tokens-bin [tokens.bin]]\n"
+                    "       [--save-tokens-bin fichier] [-O0 | [--dataflow passes] [--peephole regles]]\n"
+                    "       [--stats] [--dump-cfg [cfg.dot]] [--asm [programme.s]] [--module [programme.mod]]\n"
+                    "       [--run | --jit | --run-ir] [source]\n", prog);
+    fprintf(stderr, "  source             Pascal source compiled in-process (default: program.txt, - = stdin)\n");
+    fprintf(stderr, "  --stdio            lex through getNextToken(FILE *) instead of the mapped source\n");
+    fprintf(stderr, "  --tokens           read text tokens written by analyseur_lex instead of lexing\n");
+    fprintf(stderr, "  --tokens-bin       read (memory-map) binary tokens written by analyseur_lex -b\n");
+    fprintf(stderr, "  --save-tokens-bin  also write the token stream in binary form\n");
+    fprintf(stderr, "  -O0                no constant folding, no dataflow or loop optimization, no\n"
+                    "                     control-flow graph pass and no peephole optimization\n");
+    fprintf(stderr, "  --dataflow passes  comma-separated dataflow passes (default: toutes):\n");
+    fprintf(stderr, "                    ");
+    for (int p = 0; p < DF_COUNT; ++p) fprintf(stderr, " %s", dataflow_pass_name((DataflowPass)p));
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  --peephole regles  comma-separated peephole rules (default: toutes):\n");
+    fprintf(stderr, "                    ");
+    for (int r = 0; r < PH_COUNT; ++r) fprintf(stderr, " %s", peephole_rule_name((PeepholeRule)r));
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  --stats            print how often each optimization fired on stderr\n");
+    fprintf(stderr, "  --dump-cfg         write the control-flow graph in Graphviz form to the\n"
+                    "                     .dot file named next (default: cfg.dot)\n");
+    fprintf(stderr, "  --asm              also write x86-64 assembler for a standalone executable to\n"
+                    "                     the .s file named next (default: programme.s)\n");
+    fprintf(stderr, "  --module           also write the code as a compiled module, run in place by\n"
+                    "                     automate, to the .mod file named next (default: programme.mod)\n");
+    fprintf(stderr, "  --run              execute the compiled code (stdin/stdout) once written\n");
+    fprintf(stderr, "  --jit              same as --run, translated to machine code first\n");
+    fprintf(stderr, "  --run-ir           same as --run, on the register machine (see ir.h)\n");
+    fprintf(stderr, "  -q                 no token trace and no listing on stdout\n");
+}
+
+enum { RUN_VM = 1, RUN_JIT, RUN_IR };
+
+/* runs the code buffer on the stack automaton, through the JIT where this
+   machine has one, or on the register machine; returns the exit status */
+int run_code(int mode) {
+    VmProgram prog;
+    Vm vm;
+    JitCode native;
+    IrProgram ir;
+    int jit = mode == RUN_JIT;
+
+    if (vm_load(&prog, code, code_index) != 0) return 1;
+    if (vm_init(&vm, &prog, stdin, stdout) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        vm_free_program(&prog);
+        return 1;
+    }
+    if (jit && jit_compile(&native, &prog) != 0) {
+        fprintf(stderr, "JIT not available, interpreting\n");
+        jit = 0;
+    }
+    if (mode == RUN_IR && ir_load(&ir, &prog) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        vm_free(&vm);
+        vm_free_program(&prog);
+        return 1;
+    }
+    VmStatus status = jit ? jit_run(&native, &vm) : mode == RUN_IR ? ir_run(&ir, &vm) : vm_run(&vm);
+    if (status != VM_OK)
+        fprintf(stderr, "Erreur d'execution a l'instruction %d : %s\n", vm.pc, vm_status_message(status));
+    if (jit) jit_free(&native);
+    if (mode == RUN_IR) ir_free(&ir);
+    vm_free(&vm);
+    vm_free_program(&prog);
+    return status == VM_OK ? 0 : 2;
+}
+
+/* writes the code buffer as x86-64 assembler; returns the exit status */
+int write_asm(const char *filename) {
+    VmProgram prog;
+
+    if (vm_load(&prog, code, code_index) != 0) return 1;
+    int status = aot_write_file(filename, &prog);
+    vm_free_program(&prog);
+    return status == 0 ? 0 : 1;
+}
+
+/* writes the code buffer as a compiled module, with the names of the
+   variables; returns the exit status */
+int write_module(const char *filename) {
+    VmProgram prog;
+
+    if (vm_load(&prog, code, code_index) != 0) return 1;
+    const char **names = calloc((size_t)next_address + 1, sizeof(char *));
+    if (names == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        vm_free_program(&prog);
         return 1;
     }
-    
-    currentToken = getNextToken(tokenFile);
-    P(tokenFile);
-    
-    symtab_print();
-    afficher_code();
+    for (int i = 0; i < symtab_count; ++i) {
+        if (symtab[i].address >= 0) names[symtab[i].address] = intern_name(symtab[i].name);
+    }
+    int status = module_write_file(filename, &prog, names, next_address);
+    free(names);
+    vm_free_program(&prog);
+    return status == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    Compilation c;
+    const char *asm_file = NULL;
+    const char *module_file = NULL;
+    int run = 0;
+
+    compilation_init(&c, "program.txt");
+    c.trace = 1;
+    c.code_file = "pile_code.txt";
+    c.symtab_file = "symbol_table.txt";
+    c.labels_file = "etiquettes.txt";
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-q") == 0) {
+            c.trace = 0;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            run = RUN_VM;
+        } else if (strcmp(argv[i], "--jit") == 0) {
+            run = RUN_JIT;
+        } else if (strcmp(argv[i], "--run-ir") == 0) {
+            run = RUN_IR;
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            c.optimise = 0;
+            c.rules = 0;
+        } else if (strcmp(argv[i], "--dataflow") == 0 && i + 1 < argc) {
+            if (dataflow_parse_passes(argv[++i], &c.passes) != 0) {
+                fprintf(stderr, "Unknown dataflow pass in '%s'\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--peephole") == 0 && i + 1 < argc) {
+            if (peephole_parse_rules(argv[++i], &c.rules) != 0) {
+                fprintf(stderr, "Unknown peephole rule in '%s'\n", argv[i]);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            c.stats = 1;
+        } else if (strcmp(argv[i], "--dump-cfg") == 0) {
+            /* only a .dot name is taken, never the source that may follow */
+            size_t len = i + 1 < argc ? strlen(argv[i + 1]) : 0;
+            c.dot_file = (len > 4 && strcmp(argv[i + 1] + len - 4, ".dot") == 0) ? argv[++i] : "cfg.dot";
+        } else if (strcmp(argv[i], "--asm") == 0) {
+            size_t len = i + 1 < argc ? strlen(argv[i + 1]) : 0;
+            asm_file = (len > 2 && strcmp(argv[i + 1] + len - 2, ".s") == 0) ? argv[++i] : "programme.s";
+        } else if (strcmp(argv[i], "--module") == 0) {
+            size_t len = i + 1 < argc ? strlen(argv[i + 1]) : 0;
+            module_file = (len > 4 && strcmp(argv[i + 1] + len - 4, ".mod") == 0) ? argv[++i] : "programme.mod";
+        } else if (strcmp(argv[i], "--stdio") == 0) {
+            c.kind = SOURCE_LEXER;
+        } else if (strcmp(argv[i], "--tokens") == 0) {
+            c.kind = SOURCE_TEXT_TOKENS;
+            c.token_file = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "tokens.txt";
+        } else if (strcmp(argv[i], "--tokens-bin") == 0) {
+            c.kind = SOURCE_BIN_TOKENS;
+            c.token_file = (i + 1 < argc && argv[i + 1][0] != '-') ? argv[++i] : "tokens.bin";
+        } else if (strcmp(argv[i], "--save-tokens-bin") == 0 && i + 1 < argc) {
+            c.save_file = argv[++i];
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            c.source = argv[i];
+        }
+    }
 
-    write_symtab_to_file("symbol_table.txt");
-    write_code_to_file("pile_code.txt");
-    
-    fclose(tokenFile);
+    if (compiler(&c) != 0) {
+        fprintf(stderr, "%s\n", c.erreur);
+        return 1;
+    }
+    if (asm_file != NULL && write_asm(asm_file) != 0) return 1;
+    if (module_file != NULL && write_module(module_file) != 0) return 1;
 
+    if (run) {
+        fflush(stdout);
+        return run_code(run);
+    }
     return 0;
-}
\ No newline at end of file
+}
+#endif
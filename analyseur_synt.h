@@ -0,0 +1,105 @@
+#ifndef ANALYSEUR_SYNT_H
+#define ANALYSEUR_SYNT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "analyseur_lex.h"
+
+/*
+ * The whole compiler as one call. Every module keeps its state (tokens,
+ * syntax tree, symbol table, code buffer, pass scratch) in thread-local
+ * variables, so each thread is a compilation context of its own: threads
+ * compile in parallel and one thread compiles any number of programs in
+ * turn. Errors do not exit: compiler() returns -1 with the message that
+ * analyseur_synt prints.
+ */
+
+typedef enum {
+    SOURCE_SPANS,           /* zero-copy lexer over the mapped source */
+    SOURCE_LEXER,           /* getNextToken(FILE *) */
+    SOURCE_TEXT_TOKENS,     /* tokens.txt written by analyseur_lex */
+    SOURCE_BIN_TOKENS,      /* tokens.bin written by analyseur_lex -b */
+    SOURCE_SPAN_ARRAY,      /* spans lexed already, for parser_tokens() */
+    SOURCE_HOOKS            /* ParseHooks.next(), for parser_hooks() and the like */
+} TokenSource;
+
+typedef struct {
+    /* input */
+    const char *source;         /* Pascal source, "-" = stdin */
+    const char *text;           /* or the source itself, when not NULL */
+    size_t size;
+    TokenSource kind;
+    const char *token_file;     /* read instead of source with the token kinds */
+    const char *save_file;      /* binary copy of the token stream, or NULL */
+
+    /* options */
+    int optimise;               /* 0 for -O0 */
+    unsigned passes;            /* dataflow passes (dataflow.h) */
+    unsigned rules;             /* peephole rules (peephole.h) */
+    int trace;                  /* token trace and listings on stdout */
+    int stats;                  /* optimization counts on stderr */
+
+    /* outputs, not written when NULL */
+    const char *code_file;      /* pile_code.txt */
+    const char *symtab_file;    /* symbol_table.txt */
+    const char *labels_file;    /* etiquettes.txt */
+    const char *dot_file;       /* control-flow graph */
+
+    /* results */
+    int before;                 /* instructions generated, before optimization */
+    int count;                  /* instructions in the code buffer */
+    char erreur[256];           /* message when compiler() fails */
+} Compilation;
+
+/* source with every optimization, no trace and no output file */
+void compilation_init(Compilation *c, const char *source);
+
+/* compiles c->source into the code buffer of the calling thread (code.h)
+   and writes the outputs; returns 0, or -1 with c->erreur set */
+int compiler(Compilation *c);
+
+/* the same from a syntax tree already in ast_nodes (root), for instance a
+   copy of an incremental parse (incremental.h); the interned names of the
+   tree stay valid */
+int compiler_ast(Compilation *c, int root);
+
+/* parses tokens, the nextSpanToken() spans of text up to EOF_TOKEN, into
+   the syntax tree of the calling thread (ast.h) and returns its root.
+   Interned names are kept from one call to the next. Errors go through
+   erreur(): the caller sets erreur_cible. */
+int parser_tokens(const char *text, size_t size, const SpanToken *tokens);
+
+/* Token source and callbacks of the parses below, which reparse parts of
+   a text for incremental.h. next() gives the tokens in order, as
+   spanTokenToToken() makes them, up to EOF_TOKEN; the text they point to
+   must stay until the parse returns. parsed() is called for
+   every statement parsed, inner ones first, with the indexes (in the
+   order next() gave them) of its first token and of the token after it.
+   boundary() is called by parser_statements() at the first token of each
+   statement after the first one, and stops the parse there when it
+   returns nonzero. */
+typedef struct {
+    void (*next)(void *data, Token *token);
+    void (*parsed)(void *data, int start, int end, int root);
+    int (*boundary)(void *data, int start);
+    void *data;
+} ParseHooks;
+
+/* token the parser is at */
+extern _Thread_local Token currentToken;
+
+/* the whole program, as parser_tokens() */
+int parser_hooks(const ParseHooks *hooks);
+
+/* only "program ID ; declarations", and checks that begin follows;
+   returns the list of the N_DECL nodes (ast.h), *ndecl of them */
+int parser_header(const ParseHooks *hooks, int32_t *ndecl);
+
+/* the statements of a block from one of them on, where names are
+   declared: up to the end of the block, whose end token is left as
+   currentToken unread, or up to where boundary() stops. Returns their
+   list, *count of them. */
+int parser_statements(const ParseHooks *hooks, const int32_t *names, int nnames, int32_t *count);
+
+#endif
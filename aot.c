@@ -0,0 +1,604 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aot.h"
+#include "erreur.h"
+
+/* ---------- operands ---------- */
+
+static const char *const var_regs[AOT_VAR_REGS] = {"%ebx", "%ebp", "%r12d", "%r13d", "%r14d", "%r15d"};
+static const char *const var_regs64[AOT_VAR_REGS] = {"%rbx", "%rbp", "%r12", "%r13", "%r14", "%r15"};
+/* homes of the first operand stack slots, the others being in pile */
+static const char *const slot_regs[] = {"%esi", "%edi", "%r8d", "%r9d", "%r10d", "%r11d"};
+#define NSLOT_REGS ((int)(sizeof(slot_regs) / sizeof(slot_regs[0])))
+
+typedef enum { OPND_IMM, OPND_REG, OPND_MEM } OpndKind;
+
+typedef struct {
+    OpndKind kind;
+    char text[40];
+} Opnd;
+
+static Opnd opnd(OpndKind kind, const char *fmt, ...) {
+    Opnd o;
+    va_list ap;
+    o.kind = kind;
+    va_start(ap, fmt);
+    vsnprintf(o.text, sizeof(o.text), fmt, ap);
+    va_end(ap);
+    return o;
+}
+
+static Opnd reg(const char *name) {
+    return opnd(OPND_REG, "%s", name);
+}
+
+/* ---------- state of the translation ---------- */
+
+static FILE *out;                   /* NULL while only looking for computed stores */
+static const VmProgram *prog;
+static int *var_reg;                /* register of each address, or -1 */
+static int computed_store;          /* some := goes through a computed address */
+
+/* An operand stack slot holds a constant or a register variable the
+   translator has not copied yet, or a value in its home. */
+typedef enum { SLOT_CONST, SLOT_VAR, SLOT_HOME } SlotKind;
+
+typedef struct {
+    SlotKind kind;
+    int32_t value;                  /* constant, or address of the variable */
+} Slot;
+
+static Slot *slots;
+
+typedef struct {
+    int pc;
+    VmStatus status;
+} Fail;
+
+static Fail *fails;
+static int nfails;
+static int fails_capacity;
+
+static void ins(const char *fmt, ...) {
+    va_list ap;
+    if (out == NULL) return;
+    fputc('\t', out);
+    va_start(ap, fmt);
+    vfprintf(out, fmt, ap);
+    va_end(ap);
+    fputc('\n', out);
+}
+
+/* jump (cc NULL) or jcc to code stopping the run with status at pc */
+static void fail(const char *cc, int pc, VmStatus status) {
+    if (nfails == fails_capacity) {
+        fails_capacity = fails_capacity ? fails_capacity * 2 : 64;
+        fails = realloc(fails, (size_t)fails_capacity * sizeof(Fail));
+        if (fails == NULL) {
+            erreur("Code memory overflow");
+        }
+    }
+    fails[nfails] = (Fail){pc, status};
+    ins("j%s .Lf%d", cc ? cc : "mp", nfails++);
+}
+
+static Opnd var_opnd(int32_t address) {
+    if (var_reg[address] >= 0) return reg(var_regs[var_reg[address]]);
+    return opnd(OPND_MEM, "memoire+%ld(%%rip)", 4L * address);
+}
+
+static Opnd home(int k) {
+    if (k < NSLOT_REGS) return reg(slot_regs[k]);
+    return opnd(OPND_MEM, "pile+%ld(%%rip)", 4L * k);
+}
+
+static Opnd slot_opnd(int k) {
+    if (slots[k].kind == SLOT_CONST) return opnd(OPND_IMM, "$%ld", (long)slots[k].value);
+    if (slots[k].kind == SLOT_VAR) return var_opnd(slots[k].value);
+    return home(k);
+}
+
+static void mov(Opnd src, Opnd dst) {
+    if (strcmp(src.text, dst.text) == 0) return;
+    if (src.kind == OPND_MEM && dst.kind == OPND_MEM) {
+        ins("movl %s, %%ecx", src.text);
+        src = reg("%ecx");
+    }
+    ins("movl %s, %s", src.text, dst.text);
+}
+
+static void materialize(int k) {
+    if (slots[k].kind == SLOT_HOME) return;
+    mov(slot_opnd(k), home(k));
+    slots[k].kind = SLOT_HOME;
+}
+
+static void materialize_all(int height) {
+    for (int k = 0; k < height; ++k) materialize(k);
+}
+
+/* copies slots 0..height-1 still reading the variable at address before it changes */
+static void before_write(int32_t address, int height) {
+    for (int k = 0; k < height; ++k) {
+        if (slots[k].kind == SLOT_VAR && slots[k].value == address) materialize(k);
+    }
+}
+
+/* slot k in the register its result is computed in: its home, or %eax */
+static Opnd load_result(int k) {
+    Opnd r = home(k).kind == OPND_REG ? home(k) : reg("%eax");
+    mov(slot_opnd(k), r);
+    return r;
+}
+
+static void set_slot(int k, Opnd r) {
+    slots[k].kind = SLOT_HOME;
+    mov(r, home(k));
+}
+
+static void set_const(int k, int32_t value) {
+    slots[k].kind = SLOT_CONST;
+    slots[k].value = value;
+}
+
+/* the runtime calls clobber the slot registers: slots 0..live-1 go to pile */
+static void save_live(int live, int store) {
+    for (int k = 0; k < live && k < NSLOT_REGS; ++k) {
+        if (slots[k].kind != SLOT_HOME) continue;
+        Opnd spill = opnd(OPND_MEM, "pile+%ld(%%rip)", 4L * k);
+        if (store) mov(home(k), spill);
+        else mov(spill, home(k));
+    }
+}
+
+/* Comparer-si-xx and Aller-si-pas-xx: condition under which the comparison holds */
+static int condition(int op) {
+    switch (op) {
+        case OP_COMPARER_SUP: case OP_ALLER_SI_PAS_SUP: return 0;
+        case OP_COMPARER_INF: case OP_ALLER_SI_PAS_INF: return 1;
+        case OP_COMPARER_EGAL: case OP_ALLER_SI_PAS_EGAL: return 2;
+        case OP_COMPARER_SUP_EGAL: case OP_ALLER_SI_PAS_SUP_EGAL: return 3;
+        case OP_COMPARER_INF_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: return 4;
+        default: return 5;
+    }
+}
+
+static const char *const cc_names[] = {"g", "l", "e", "ge", "le", "ne"};
+static const char *const cc_opposite[] = {"le", "ge", "ne", "l", "g", "e"};
+
+static int holds(int cc, int32_t a, int32_t b) {
+    switch (cc) {
+        case 0: return a > b;
+        case 1: return a < b;
+        case 2: return a == b;
+        case 3: return a >= b;
+        case 4: return a <= b;
+        default: return a != b;
+    }
+}
+
+/* cmpl slot b, slot a; not both constants */
+static void compare(int a, int b) {
+    Opnd x = slot_opnd(a), y = slot_opnd(b);
+    if (x.kind == OPND_IMM) {
+        mov(x, reg("%eax"));
+        x = reg("%eax");
+    }
+    if (x.kind == OPND_MEM && y.kind == OPND_MEM) {
+        mov(y, reg("%ecx"));
+        y = reg("%ecx");
+    }
+    ins("cmpl %s, %s", y.text, x.text);
+}
+
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+
+/* translates instruction i, the operand stack being h high */
+static void translate(int i, int h) {
+    const Instr *in = &prog->code[i];
+    int a = h - 2, b = h - 1;
+
+    switch (in->op) {
+        case OP_VALEURG:
+        case OP_EMPILER:
+            set_const(h, in->arg);
+            break;
+
+        case OP_VALEURD:
+            if (var_reg[in->arg] >= 0) {
+                slots[h].kind = SLOT_VAR;
+                slots[h].value = in->arg;
+            } else {
+                Opnd r = home(h).kind == OPND_REG ? home(h) : reg("%eax");
+                mov(var_opnd(in->arg), r);
+                set_slot(h, r);
+            }
+            break;
+
+        case OP_AFFECTER:
+            if (slots[a].kind == SLOT_CONST) {
+                int32_t address = slots[a].value;
+                if ((uint32_t)address >= (uint32_t)prog->nvars) {
+                    fail(NULL, i, VM_ERR_ADDRESS);
+                } else {
+                    before_write(address, a);
+                    mov(slot_opnd(b), var_opnd(address));
+                }
+            } else {
+                Opnd x = slot_opnd(a), v = slot_opnd(b);
+                computed_store = 1;
+                ins("cmpl $%d, %s", prog->nvars, x.text);
+                fail("ae", i, VM_ERR_ADDRESS);
+                mov(x, reg("%eax"));
+                ins("leaq memoire(%%rip), %%rdx");
+                if (v.kind == OPND_MEM) {
+                    mov(v, reg("%ecx"));
+                    v = reg("%ecx");
+                }
+                ins("movl %s, (%%rdx,%%rax,4)", v.text);
+            }
+            break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL: {
+            if (slots[a].kind == SLOT_CONST && slots[b].kind == SLOT_CONST) {
+                uint32_t x = (uint32_t)slots[a].value, y = (uint32_t)slots[b].value;
+                set_const(a, WRAP(in->op == OP_ADD ? x + y : in->op == OP_SUB ? x - y : x * y));
+                break;
+            }
+            Opnd r = load_result(a), src = slot_opnd(b);
+            if (in->op == OP_MUL && src.kind == OPND_IMM) ins("imull %s, %s, %s", src.text, r.text, r.text);
+            else ins("%s %s, %s", in->op == OP_ADD ? "addl" : in->op == OP_SUB ? "subl" : "imull", src.text, r.text);
+            set_slot(a, r);
+            break;
+        }
+
+        case OP_DIV:
+        case OP_MOD: {
+            /* idivl leaves the quotient in %eax, the remainder in %edx */
+            int mod = in->op == OP_MOD;
+            const char *result = mod ? "%edx" : "%eax";
+            if (slots[b].kind == SLOT_CONST) {
+                int32_t y = slots[b].value;
+                if (y == 0) {
+                    fail(NULL, i, VM_ERR_DIV_ZERO);
+                    set_const(a, 0);    /* never reached */
+                } else if (slots[a].kind == SLOT_CONST) {
+                    int32_t x = slots[a].value;
+                    if (mod) set_const(a, y == -1 ? 0 : x % y);
+                    else set_const(a, y == -1 ? WRAP(0u - (uint32_t)x) : x / y);
+                } else if (y == -1 && mod) {
+                    set_const(a, 0);
+                } else if (y == -1) {
+                    Opnd r = load_result(a);
+                    ins("negl %s", r.text);
+                    set_slot(a, r);
+                } else {
+                    mov(slot_opnd(a), reg("%eax"));
+                    ins("cltd");
+                    ins("movl $%ld, %%ecx", (long)y);
+                    ins("idivl %%ecx");
+                    set_slot(a, reg(result));
+                }
+            } else {
+                /* INT32_MIN / -1 would fault: -1 negates, and leaves no
+                   remainder */
+                Opnd d = slot_opnd(b);
+                ins("cmpl $0, %s", d.text);
+                fail("e", i, VM_ERR_DIV_ZERO);
+                mov(slot_opnd(a), reg("%eax"));
+                ins("cmpl $-1, %s", d.text);
+                ins("jne 1f");
+                if (mod) ins("xorl %%edx, %%edx");
+                else ins("negl %%eax");
+                ins("jmp 2f");
+                if (out != NULL) fprintf(out, "1:\n");
+                ins("cltd");
+                ins("idivl %s", d.text);
+                if (out != NULL) fprintf(out, "2:\n");
+                set_slot(a, reg(result));
+            }
+            break;
+        }
+
+        case OP_DECALER_GAUCHE:
+            if (slots[b].kind == SLOT_CONST) {
+                set_const(b, WRAP((uint32_t)slots[b].value << in->arg));
+            } else {
+                Opnd r = load_result(b);
+                ins("shll $%d, %s", in->arg, r.text);
+                set_slot(b, r);
+            }
+            break;
+
+        case OP_DECALER_DROITE:
+            if (slots[b].kind == SLOT_CONST) {
+                int32_t x = slots[b].value;
+                set_const(b, WRAP((uint32_t)x + ((uint32_t)(x >> 31) & ((1u << in->arg) - 1))) >> in->arg);
+            } else {
+                /* bias negative values by 2^k - 1, as the interpreter does */
+                Opnd r = load_result(b);
+                ins("movl %s, %%ecx", r.text);
+                ins("sarl $31, %%ecx");
+                ins("andl $%u, %%ecx", (1u << in->arg) - 1);
+                ins("addl %%ecx, %s", r.text);
+                ins("sarl $%d, %s", in->arg, r.text);
+                set_slot(b, r);
+            }
+            break;
+
+        case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+        case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF: {
+            int cc = condition(in->op);
+            if (slots[a].kind == SLOT_CONST && slots[b].kind == SLOT_CONST) {
+                set_const(a, holds(cc, slots[a].value, slots[b].value));
+                break;
+            }
+            compare(a, b);
+            ins("set%s %%cl", cc_names[cc]);
+            ins("movzbl %%cl, %%ecx");
+            set_slot(a, reg("%ecx"));
+            break;
+        }
+
+        case OP_ALLER:
+            materialize_all(h);
+            ins("jmp .L%d", in->arg);
+            break;
+
+        case OP_ALLER_SI_FAUX:
+            materialize_all(h - 1);
+            if (slots[b].kind == SLOT_CONST) {
+                if (slots[b].value == 0) ins("jmp .L%d", in->arg);
+            } else {
+                ins("cmpl $0, %s", slot_opnd(b).text);
+                ins("je .L%d", in->arg);
+            }
+            break;
+
+        case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+        case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF: {
+            int cc = condition(in->op);
+            materialize_all(h - 2);
+            if (slots[a].kind == SLOT_CONST && slots[b].kind == SLOT_CONST) {
+                if (!holds(cc, slots[a].value, slots[b].value)) ins("jmp .L%d", in->arg);
+                break;
+            }
+            compare(a, b);
+            ins("j%s .L%d", cc_opposite[cc], in->arg);
+            break;
+        }
+
+        case OP_INCR:
+            before_write(in->arg, h);
+            ins("addl $%d, %s", in->arg2, var_opnd(in->arg).text);
+            break;
+
+        case OP_LIRE:
+            save_live(h, 1);
+            ins("call lire");
+            save_live(h, 0);
+            ins("cmpl $1, %%edx");
+            fail("ne", i, VM_ERR_INPUT);
+            set_slot(h, reg("%eax"));
+            break;
+
+        case OP_ECRIRE: {
+            Opnd v = slot_opnd(b);
+            save_live(h - 1, 1);
+            mov(v, reg("%edi"));
+            ins("call ecrire");
+            save_live(h - 1, 0);
+            break;
+        }
+
+        case OP_HALTE:
+            ins("jmp .Lfin");
+            break;
+    }
+}
+
+/* ---------- register allocation ---------- */
+
+/* Weighs every use of a variable by 8^(loops around it), the loops
+   being the ranges of backward jumps, and gives the registers to the
+   heaviest. */
+static void allocate_registers(void) {
+    int count = prog->count;
+    int *depth = calloc((size_t)count + 2, sizeof(int));
+    uint64_t *weight = calloc((size_t)prog->nvars + 1, sizeof(uint64_t));
+    if (depth == NULL || weight == NULL) {
+        erreur("Code memory overflow");
+    }
+    for (int i = 0; i < count; ++i) {
+        const Instr *in = &prog->code[i];
+        if (opcode_is_jump(in->op) && in->arg <= i && prog->height[i] >= 0) {
+            depth[in->arg]++;
+            depth[i + 1]--;
+        }
+    }
+    for (int i = 0, d = 0; i < count; ++i) {
+        const Instr *in = &prog->code[i];
+        d += depth[i];
+        if (prog->height[i] < 0) continue;
+        if (in->op == OP_VALEURG || in->op == OP_VALEURD || in->op == OP_INCR) {
+            uint64_t w = (uint64_t)1 << (d < 10 ? 3 * d : 30);
+            if ((uint32_t)in->arg < (uint32_t)prog->nvars) weight[in->arg] += w;
+        }
+    }
+    for (int a = 0; a < prog->nvars; ++a) var_reg[a] = -1;
+    for (int r = 0; r < AOT_VAR_REGS; ++r) {
+        int best = -1;
+        for (int a = 0; a < prog->nvars; ++a) {
+            if (var_reg[a] < 0 && weight[a] > 0 && (best < 0 || weight[a] > weight[best])) best = a;
+        }
+        if (best < 0) break;
+        var_reg[best] = r;
+    }
+    free(depth);
+    free(weight);
+}
+
+/* ---------- output ---------- */
+
+static void emit_string(const char *label, const char *s) {
+    fprintf(out, "%s:\n\t.string \"", label);
+    for (const unsigned char *p = (const unsigned char *)s; *p; ++p) {
+        if (*p == '"' || *p == '\\') fprintf(out, "\\%c", *p);
+        else if (*p == '\n') fprintf(out, "\\n");
+        else if (*p < 0x20 || *p >= 0x7F) fprintf(out, "\\%03o", *p);
+        else fputc(*p, out);
+    }
+    fprintf(out, "\"\n");
+}
+
+static void translate_all(const char *target) {
+    int h = 0, open = 1;
+    nfails = 0;
+    for (int i = 0; i <= prog->count; ++i) {
+        int height = prog->height[i];
+        if (open && target[i]) materialize_all(h);
+        if (target[i] && out != NULL) fprintf(out, ".L%d:\n", i);
+        if (height < 0) {       /* unreachable */
+            open = 0;
+            continue;
+        }
+        if (!open || target[i]) {
+            for (int k = 0; k < height; ++k) slots[k].kind = SLOT_HOME;
+        }
+        translate(i, height);
+        switch (prog->code[i].op) {     /* height after */
+            case OP_VALEURG: case OP_VALEURD: case OP_EMPILER: case OP_LIRE:
+                h = height + 1; break;
+            case OP_AFFECTER:
+            case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+            case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF:
+                h = height - 2; break;
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+            case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF:
+            case OP_ALLER_SI_FAUX: case OP_ECRIRE:
+                h = height - 1; break;
+            default:
+                h = height; break;
+        }
+        open = prog->code[i].op != OP_ALLER && prog->code[i].op != OP_HALTE;
+    }
+}
+
+int aot_write(FILE *file, const VmProgram *program) {
+    int count = program->count;
+    char *target = calloc((size_t)count + 1, 1);
+    prog = program;
+    var_reg = malloc(((size_t)program->nvars + 1) * sizeof(int));
+    slots = malloc(((size_t)program->max_stack + 1) * sizeof(Slot));
+    if (target == NULL || var_reg == NULL || slots == NULL) {
+        erreur("Code memory overflow");
+    }
+    for (int i = 0; i < count; ++i) {
+        if (opcode_is_jump(program->code[i].op)) target[program->code[i].arg] = 1;
+    }
+
+    /* a := through a computed address may reach any variable: then all
+       of them stay in memory */
+    allocate_registers();
+    out = NULL;
+    computed_store = 0;
+    translate_all(target);
+    if (computed_store) {
+        for (int a = 0; a < program->nvars; ++a) var_reg[a] = -1;
+    }
+
+    out = file;
+    fprintf(out, "# x86-64, produit par analyseur_synt --asm : gcc -o programme programme.s\n");
+    for (int a = 0; a < program->nvars; ++a) {
+        if (var_reg[a] >= 0) fprintf(out, "# adresse %d dans %s\n", a, var_regs[var_reg[a]]);
+    }
+    fprintf(out, "\t.text\n\t.globl main\n\t.type main, @function\nmain:\n");
+    for (int r = 0; r < AOT_VAR_REGS; ++r) ins("pushq %s", var_regs64[r]);
+    ins("subq $8, %%rsp");
+    for (int a = 0; a < program->nvars; ++a) {
+        if (var_reg[a] >= 0) ins("xorl %s, %s", var_regs[var_reg[a]], var_regs[var_reg[a]]);
+    }
+    translate_all(target);
+    fprintf(out, ".Lfin:\n");
+    ins("xorl %%eax, %%eax");
+    ins("addq $8, %%rsp");
+    for (int r = AOT_VAR_REGS - 1; r >= 0; --r) ins("popq %s", var_regs64[r]);
+    ins("ret");
+
+    /* error exits: pc in %edi, message in %rsi */
+    for (int f = 0; f < nfails; ++f) {
+        fprintf(out, ".Lf%d:\n", f);
+        ins("movl $%d, %%edi", fails[f].pc);
+        ins("leaq .Lm%d(%%rip), %%rsi", (int)fails[f].status);
+        ins("jmp erreur");
+    }
+    fprintf(out, "\t.size main, .-main\n");
+
+    /* runtime: lire returns the value in %eax and scanf's count in %edx */
+    fprintf(out, "lire:\n");
+    ins("subq $24, %%rsp");
+    ins("leaq 12(%%rsp), %%rsi");
+    ins("leaq .Lformat_lire(%%rip), %%rdi");
+    ins("xorl %%eax, %%eax");
+    ins("call scanf@PLT");
+    ins("movl %%eax, %%edx");
+    ins("movl 12(%%rsp), %%eax");
+    ins("addq $24, %%rsp");
+    ins("ret");
+    fprintf(out, "ecrire:\n");
+    ins("movl %%edi, %%esi");
+    ins("leaq .Lformat_ecrire(%%rip), %%rdi");
+    ins("xorl %%eax, %%eax");
+    ins("jmp printf@PLT");
+    fprintf(out, "erreur:\n");
+    ins("movq %%rsi, %%rcx");
+    ins("movl %%edi, %%edx");
+    ins("movq stderr@GOTPCREL(%%rip), %%rax");
+    ins("movq (%%rax), %%rdi");
+    ins("leaq .Lformat_erreur(%%rip), %%rsi");
+    ins("xorl %%eax, %%eax");
+    ins("call fprintf@PLT");
+    ins("movl $2, %%edi");
+    ins("call exit@PLT");
+
+    fprintf(out, "\t.section .rodata\n");
+    emit_string(".Lformat_lire", "%d");
+    emit_string(".Lformat_ecrire", "%d\n");
+    emit_string(".Lformat_erreur", "Erreur d'execution a l'instruction %d : %s\n");
+    for (int s = VM_ERR_DIV_ZERO; s <= VM_ERR_INPUT; ++s) {
+        char label[16];
+        snprintf(label, sizeof(label), ".Lm%d", s);
+        emit_string(label, vm_status_message((VmStatus)s));
+    }
+    fprintf(out, "\t.bss\n\t.align 4\n");
+    fprintf(out, "memoire:\n\t.zero %ld\n", 4L * (program->nvars + 1));
+    fprintf(out, "pile:\n\t.zero %ld\n", 4L * (program->max_stack + 1));
+    fprintf(out, "\t.section .note.GNU-stack,\"\",@progbits\n");
+
+    free(target);
+    free(var_reg);
+    free(slots);
+    free(fails);
+    fails = NULL;
+    fails_capacity = 0;
+    return ferror(out) ? -1 : 0;
+}
+
+int aot_write_file(const char *filename, const VmProgram *program) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        perror(filename);
+        return -1;
+    }
+    int status = aot_write(file, program);
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "Error writing %s\n", filename);
+    return status;
+}
@@ -0,0 +1,28 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <stdio.h>
+
+#include "vm.h"
+
+/*
+ * Ahead-of-time backend: writes a loaded program as x86-64 GNU assembler
+ * source (AT&T syntax, ELF, System V) for a standalone executable,
+ *
+ *     gcc -o programme programme.s
+ *
+ * The variables most used inside loops live in callee-saved registers,
+ * the others in a .bss array; operand stack slots have fixed homes as in
+ * the JIT (see jit.h). A small runtime in the same file reads and writes
+ * integers through scanf and printf. Run errors print the interpreter's
+ * message and exit with status 2, as analyseur_synt --run does.
+ */
+
+/* registers available to variables */
+#define AOT_VAR_REGS 6
+
+int aot_write(FILE *out, const VmProgram *prog);
+/* aot_write() into the file filename */
+int aot_write_file(const char *filename, const VmProgram *prog);
+
+#endif
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "erreur.h"
+
+_Thread_local AstNode *ast_nodes = NULL;
+_Thread_local int ast_count = 0;
+_Thread_local int32_t *ast_lists = NULL;
+_Thread_local int ast_list_count = 0;
+
+static _Thread_local int ast_capacity = 0;
+static _Thread_local int ast_list_capacity = 0;
+
+static _Thread_local int32_t *pending = NULL;     /* items of the lists still open */
+static _Thread_local int pending_count = 0;
+static _Thread_local int pending_capacity = 0;
+
+static void *grow(void *ptr, int *capacity, size_t elem, int needed) {
+    int n = *capacity ? *capacity : 1024;
+    while (n < needed) n *= 2;
+    void *grown = realloc(ptr, (size_t)n * elem);
+    if (grown == NULL) {
+        erreur("Syntax tree memory overflow");
+    }
+    *capacity = n;
+    return grown;
+}
+
+int ast_new(NodeKind kind, int32_t value, int a, int b, int c) {
+    if (ast_count == ast_capacity) ast_nodes = grow(ast_nodes, &ast_capacity, sizeof(AstNode), ast_count + 1);
+    AstNode *n = &ast_nodes[ast_count];
+    n->kind = (uint8_t)kind;
+    n->op = 0;
+    n->may_trap = 0;
+    n->unused = 0;
+    n->value = value;
+    n->a = a;
+    n->b = b;
+    n->c = c;
+    return ast_count++;
+}
+
+int ast_list_mark(void) {
+    return pending_count;
+}
+
+void ast_list_push(int32_t item) {
+    if (pending_count == pending_capacity) pending = grow(pending, &pending_capacity, sizeof(int32_t), pending_count + 1);
+    pending[pending_count++] = item;
+}
+
+int ast_list_close(int mark, int32_t *length) {
+    int n = pending_count - mark;
+    if (ast_list_count + n > ast_list_capacity)
+        ast_lists = grow(ast_lists, &ast_list_capacity, sizeof(int32_t), ast_list_count + n);
+    int offset = ast_list_count;
+    for (int i = 0; i < n; ++i) ast_lists[offset + i] = pending[mark + i];
+    ast_list_count += n;
+    pending_count = mark;
+    *length = n;
+    return offset;
+}
+
+void ast_free(void) {
+    free(ast_nodes);
+    free(ast_lists);
+    free(pending);
+    ast_nodes = NULL;
+    ast_lists = NULL;
+    pending = NULL;
+    ast_count = ast_capacity = 0;
+    ast_list_count = ast_list_capacity = 0;
+    pending_count = pending_capacity = 0;
+}
+
+void ast_tree_free(AstTree *tree) {
+    free(tree->nodes);
+    free(tree->lists);
+    tree->nodes = NULL;
+    tree->lists = NULL;
+    tree->count = tree->list_count = 0;
+}
+
+int ast_copy(const AstTree *tree, int first, int root, int list_first, int list_end) {
+    int n = root - first + 1, nl = list_end - list_first;
+    int dn = ast_count - first, dl = ast_list_count - list_first;
+    if (ast_count + n > ast_capacity) ast_nodes = grow(ast_nodes, &ast_capacity, sizeof(AstNode), ast_count + n);
+    if (ast_list_count + nl > ast_list_capacity)
+        ast_lists = grow(ast_lists, &ast_list_capacity, sizeof(int32_t), ast_list_count + nl);
+    memcpy(ast_nodes + ast_count, tree->nodes + first, (size_t)n * sizeof(AstNode));
+    memcpy(ast_lists + ast_list_count, tree->lists + list_first, (size_t)nl * sizeof(int32_t));
+
+    /* nothing to relocate when the copy lands where the original was */
+    if (dn != 0 || dl != 0) {
+        for (AstNode *p = ast_nodes + ast_count, *end = p + n; p < end; ++p) {
+            switch (p->kind) {
+                case N_PROGRAM:
+                case N_BLOCK:
+                    /* lists of nodes */
+                    p->a += dl;
+                    for (int k = 0; k < p->value; ++k) ast_lists[p->a + k] += dn;
+                    if (p->kind == N_PROGRAM) p->b += dn;
+                    break;
+                case N_DECL:
+                    p->a += dl;
+                    break;
+                case N_IF:
+                case N_WHILE:
+                    p->a += dn;
+                    p->b += dn;
+                    if (p->c >= 0) p->c += dn;
+                    break;
+                case N_ADD: case N_SUB: case N_MUL: case N_DIV: case N_MOD: case N_COMPARE:
+                    p->b += dn;
+                    /* fall through */
+                case N_ASSIGN:
+                case N_SHL: case N_SHR:
+                    p->a += dn;
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+    ast_count += n;
+    ast_list_count += nl;
+    return root + dn;
+}
+
+int ast_children(int i, int out[3]) {
+    const AstNode *n = &ast_nodes[i];
+    int k = 0;
+    switch (n->kind) {
+        case N_ASSIGN:
+            out[k++] = n->a;
+            break;
+        case N_IF:
+        case N_WHILE:
+            out[k++] = n->a;
+            out[k++] = n->b;
+            if (n->c >= 0) out[k++] = n->c;
+            break;
+        case N_ADD: case N_SUB: case N_MUL: case N_DIV: case N_MOD: case N_COMPARE:
+            out[k++] = n->a;
+            out[k++] = n->b;
+            break;
+        case N_SHL: case N_SHR:
+            out[k++] = n->a;
+            break;
+        default:
+            break;
+    }
+    return k;
+}
+
+int *ast_subtree_starts(void) {
+    int capacity = 0, kids[3];
+    int *first = grow(NULL, &capacity, sizeof(int), ast_count);
+    for (int i = 0; i < ast_count; ++i) {
+        first[i] = i;
+        const AstNode *n = &ast_nodes[i];
+        if (n->kind == N_BLOCK) {
+            for (int k = 0; k < n->value; ++k) {
+                if (first[ast_lists[n->a + k]] < first[i]) first[i] = first[ast_lists[n->a + k]];
+            }
+        }
+        for (int k = ast_children(i, kids); k-- > 0; ) {
+            if (first[kids[k]] < first[i]) first[i] = first[kids[k]];
+        }
+    }
+    return first;
+}
+
+void ast_index_build(AstIndex *index, int32_t naddresses, int32_t (*key)(int node)) {
+    int capacity = 0;
+    index->naddresses = naddresses;
+    index->start = grow(NULL, &capacity, sizeof(int), naddresses + 2);
+    for (int32_t a = 0; a < naddresses + 2; ++a) index->start[a] = 0;
+    int n = 0;
+    for (int i = 0; i < ast_count; ++i) {
+        int32_t a = key(i);
+        if (a >= 0 && a < naddresses) {
+            index->start[a + 2]++;
+            n++;
+        }
+    }
+    for (int32_t a = 0; a < naddresses; ++a) index->start[a + 2] += index->start[a + 1];
+    capacity = 0;
+    index->pos = grow(NULL, &capacity, sizeof(int), n);
+    for (int i = 0; i < ast_count; ++i) {
+        int32_t a = key(i);
+        if (a >= 0 && a < naddresses) index->pos[index->start[a + 1]++] = i;
+    }
+}
+
+int ast_index_any(const AstIndex *index, int32_t a, int first, int last) {
+    if (a < 0 || a >= index->naddresses) return 1;
+    int lo = index->start[a], hi = index->start[a + 1];
+    while (lo < hi) {   /* first node at or after first */
+        int m = (lo + hi) / 2;
+        if (index->pos[m] < first) lo = m + 1;
+        else hi = m;
+    }
+    return lo < index->start[a + 1] && index->pos[lo] <= last;
+}
+
+void ast_index_free(AstIndex *index) {
+    free(index->start);
+    free(index->pos);
+    index->start = index->pos = NULL;
+    index->naddresses = 0;
+}
@@ -0,0 +1,123 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stdint.h>
+
+/*
+ * Syntax tree built by P(). Nodes are 20-byte records in one array that
+ * only grows (a bump arena, released in one shot by ast_free()); children
+ * are indexes into it, and statement or name lists are runs of indexes in
+ * a second array. The parser creates every node after its children, so
+ * the array is in post-order and the root is the last node: passes that
+ * only need children before parents are a single linear scan.
+ *
+ * Passes, in order:
+ *   sema()              declarations into the symbol table, names -> addresses
+ *   optimiser()         constant folding and algebraic simplification
+ *   dataflow()          constant and copy propagation, dead stores
+ *                       (dataflow.h)
+ *   licm()              loop-invariant expressions into temporaries before
+ *                       their loop
+ *   generer_programme() stack code through generer()
+ */
+typedef enum {
+    /* statements */
+    N_PROGRAM,      /* a..a+value in lists: N_DECL nodes; b: body */
+    N_DECL,         /* a..a+value in lists: name ids; op: INTEGER or CHAR */
+    N_BLOCK,        /* a..a+value in lists: statements */
+    N_ASSIGN,       /* value: variable; a: expression */
+    N_IF,           /* a: condition; b: then; c: else or -1 */
+    N_WHILE,        /* a: condition; b: body; c: preheader N_BLOCK or -1 */
+    N_READ,         /* value: variable */
+    N_WRITE,        /* value: variable */
+    /* expressions */
+    N_CONST,        /* value */
+    N_VAR,          /* value: variable */
+    N_ADD,          /* a + b */
+    N_SUB,
+    N_MUL,
+    N_DIV,          /* truncates toward zero */
+    N_MOD,          /* remainder of N_DIV, with the sign of a */
+    N_SHL,          /* a * 2^value */
+    N_SHR,          /* a / 2^value, truncated toward zero */
+    N_COMPARE       /* a op b; op: OP_COMPARER_* */
+} NodeKind;
+
+/* a variable is an interned name id until sema() makes it an address */
+
+typedef struct {
+    uint8_t kind;
+    uint8_t op;
+    uint8_t may_trap;   /* expression holds a division that can fail */
+    uint8_t unused;
+    int32_t value;
+    int32_t a, b, c;
+} AstNode;
+
+extern _Thread_local AstNode *ast_nodes;
+extern _Thread_local int ast_count;
+extern _Thread_local int32_t *ast_lists;
+extern _Thread_local int ast_list_count;
+
+int ast_new(NodeKind kind, int32_t value, int a, int b, int c);
+
+/* Lists are collected on a stack while their elements are parsed (nested
+   lists just stack above the outer one), then moved into ast_lists. */
+int ast_list_mark(void);
+void ast_list_push(int32_t item);
+/* moves the items pushed since mark into ast_lists; returns their offset
+   and stores their number in *length */
+int ast_list_close(int mark, int32_t *length);
+
+void ast_free(void);
+
+/* A tree kept out of ast_nodes and ast_lists while the thread builds
+   others (incremental.h). */
+typedef struct {
+    AstNode *nodes;
+    int count;
+    int32_t *lists;
+    int list_count;
+} AstTree;
+
+void ast_tree_free(AstTree *tree);
+/* appends a copy of the subtree of tree made of nodes first..root and
+   lists list_first .. list_end - 1, with its children and list offsets
+   relocated; returns the copy of root */
+int ast_copy(const AstTree *tree, int first, int root, int list_first, int list_end);
+
+/* structural children of node i, lists excepted; returns their number */
+int ast_children(int i, int out[3]);
+/* first node of every subtree, so that subtree i is the range
+   first[i] .. i (malloc'd, ast_count entries) */
+int *ast_subtree_starts(void);
+
+/* The nodes a key function selects, grouped by the address it gives
+   them, each group in increasing order: "is x assigned in this loop" is
+   then a binary search over the loop's range. */
+typedef struct {
+    int *start;         /* nodes of address a: pos[start[a] .. start[a + 1]) */
+    int *pos;
+    int32_t naddresses;
+} AstIndex;
+
+/* key(i) is the address node i goes under, or -1 to leave it out */
+void ast_index_build(AstIndex *index, int32_t naddresses, int32_t (*key)(int node));
+/* is one of the nodes of address a in first..last? (1 for an address
+   the index does not cover) */
+int ast_index_any(const AstIndex *index, int32_t a, int first, int last);
+void ast_index_free(AstIndex *index);
+
+void sema(int root);
+void optimiser(int root);
+/* simplifies node i in place, its operands being simplified already */
+void simplifier(int i);
+/* expressions moved out of loops, summed over every licm() call of the
+   thread */
+extern _Thread_local int licm_count;
+void licm(int root);
+/* rotate: test a while loop once on entry and then at the bottom of
+   each iteration, instead of at the top with a jump back */
+void generer_programme(int root, int rotate);
+
+#endif
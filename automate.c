@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ir.h"
+#include "jit.h"
+#include "module.h"
+#include "vm.h"
+
+/* Runs a pile_code.txt listing, or a compiled module (a .mod file written
+   by analyseur_synt --module, see module.h), on the stack automaton.
+   Usage: automate [-s] [-d] [-j | -r | -i] [pile_code.txt | programme.mod]
+   -j translates the code to machine code first (see jit.h), -r to the
+   register form run on the register machine (see ir.h).
+   Lire reads integers from stdin, Ecrire prints one integer per line. */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int is_module(const char *filename) {
+    size_t len = strlen(filename);
+    return len > 4 && strcmp(filename + len - 4, ".mod") == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *filename = "pile_code.txt";
+    int stats = 0;
+    int debug = 0;
+    int jit = 0;
+    int reg = 0;        /* 1: run the register form, 2: list it */
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-s") == 0) {
+            stats = 1;
+        } else if (strcmp(argv[i], "-d") == 0) {
+            debug = 1;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            jit = 1;
+        } else if (strcmp(argv[i], "-r") == 0) {
+            reg = 1;
+        } else if (strcmp(argv[i], "-i") == 0) {
+            reg = 2;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "Usage: %s [-s] [-d] [-j | -r | -i] [pile_code.txt | programme.mod]\n", argv[0]);
+            fprintf(stderr, "  -s  print instruction count, speed and start-up time on stderr (time only\n"
+                            "      with -j)\n");
+            fprintf(stderr, "  -d  print the final value of each named variable of a module on stderr\n");
+            fprintf(stderr, "  -j  run through the x86-64 JIT instead of the interpreter\n");
+            fprintf(stderr, "  -r  run the register form on the register machine\n");
+            fprintf(stderr, "  -i  print the register form instead of running\n");
+            return 1;
+        } else {
+            filename = argv[i];
+        }
+    }
+
+    /* a module runs where it is mapped; the JIT and the register machine
+       need the stack heights of a program loaded */
+    VmProgram loaded;
+    Module module;
+    const VmProgram *prog = &loaded;
+    Vm vm;
+    int en_place = is_module(filename);
+    double t_start = now();
+    if (en_place) {
+        if (module_open(&module, filename) != 0) return 1;
+        prog = &module.prog;
+        if (jit || reg) {
+            if (vm_load(&loaded, module.prog.code, module.prog.count) != 0) return 1;
+            prog = &loaded;
+        }
+    } else if (vm_load_file(&loaded, filename) != 0) {
+        return 1;
+    }
+    if (vm_init(&vm, prog, stdin, stdout) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double t_ready = now();
+
+    IrProgram ir;
+    if (reg && ir_load(&ir, prog) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    if (reg == 2) {
+        ir_print(stdout, &ir);
+        if (stats) ir_print_stats(stderr);
+        ir_free(&ir);
+        vm_free(&vm);
+        if (prog == &loaded) vm_free_program(&loaded);
+        if (en_place) module_close(&module);
+        return 0;
+    }
+
+    JitCode native;
+    if (jit && jit_compile(&native, prog) != 0) {
+        fprintf(stderr, "JIT not available, interpreting\n");
+        jit = 0;
+    }
+
+    double t0 = now();
+    VmStatus status = jit ? jit_run(&native, &vm) : reg ? ir_run(&ir, &vm) : vm_run(&vm);
+    double t1 = now();
+
+    if (status != VM_OK)
+        fprintf(stderr, "Erreur d'execution a l'instruction %d : %s\n", vm.pc, vm_status_message(status));
+    if (stats && jit)
+        fprintf(stderr, "code natif en %.3f s\n", t1 - t0);
+    else if (stats)
+        fprintf(stderr, "%llu instructions en %.3f s (%.1f M instructions/s), demarrage en %.3f ms\n",
+                (unsigned long long)vm.executed, t1 - t0, vm.executed / (t1 - t0) / 1e6,
+                (t_ready - t_start) * 1e3);
+
+    if (debug && en_place) {
+        for (int a = 0; a < prog->nvars; ++a) {
+            const char *name = module_name(&module, a);
+            if (name != NULL) fprintf(stderr, "%s = %d\n", name, vm.memory[a]);
+        }
+    }
+
+    if (jit) jit_free(&native);
+    if (reg) ir_free(&ir);
+    vm_free(&vm);
+    if (prog == &loaded) vm_free_program(&loaded);
+    if (en_place) module_close(&module);
+    return status == VM_OK ? 0 : 2;
+}
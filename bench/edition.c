@@ -0,0 +1,223 @@
+/* Replays an edit sequence on a source through a Document
+   (incremental.h), and after each edit relexes and reparses the whole new
+   text for comparison: times both and checks that the trees, or the
+   error messages, are the same. At the end, if the final text parses,
+   the document compiles to the code compiler() makes of that text.
+   Build: gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -DANALYSEUR_SYNT_SANS_MAIN bench/edition.c incremental.c
+              analyseur_synt.c analyseur_lex.c code.c symtab.c tokens_bin.c peephole.c ast.c sema.c
+              optimiser.c codegen.c cfg.c licm.c dataflow.c erreur.c -o edition
+   Usage: edition [-v] fichier.pas editions.txt
+   One edit per line of editions.txt: ligne colonne supprimes "texte",
+   the line and column (from 1) in the text as the previous edits left
+   it, the number of bytes removed there and the text inserted, with \n
+   for a newline, \" and \\ for a quote and a backslash. Other lines are
+   comments. */
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../analyseur_lex.h"
+#include "../analyseur_synt.h"
+#include "../ast.h"
+#include "../code.h"
+#include "../erreur.h"
+#include "../incremental.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static char *read_file(const char *filename, size_t *size) {
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    *size = (size_t)ftell(file);
+    rewind(file);
+    char *text = malloc(*size + 1);
+    if (text == NULL || fread(text, 1, *size, file) != *size) {
+        fprintf(stderr, "%s: cannot read\n", filename);
+        exit(1);
+    }
+    text[*size] = '\0';
+    fclose(file);
+    return text;
+}
+
+/* lexes and parses text from scratch into ast_nodes; returns 0, or -1
+   with message set */
+static int full_parse(const char *text, size_t size, char *message, size_t message_size) {
+    static SpanToken *tokens = NULL;
+    static size_t capacity = 0;
+    size_t n = 0;
+    Source src;
+
+    source_from_buffer(&src, text, size);
+    do {
+        if (n == capacity) {
+            capacity = capacity ? capacity * 2 : 1 << 16;
+            tokens = realloc(tokens, capacity * sizeof(SpanToken));
+            if (tokens == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+        }
+        tokens[n] = nextSpanToken(&src);
+    } while (tokens[n++].type != EOF_TOKEN);
+
+    ErreurCible cible = { .message = message, .size = message_size };
+    message[0] = '\0';
+    erreur_cible = &cible;
+    if (setjmp(cible.retour) != 0) {
+        ast_free();
+        return -1;
+    }
+    parser_tokens(text, size, tokens);
+    erreur_cible = NULL;
+    return 0;
+}
+
+static int compare_times(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int same_tree(const AstTree *tree) {
+    return tree != NULL && tree->count == ast_count && tree->list_count == ast_list_count &&
+           memcmp(tree->nodes, ast_nodes, (size_t)ast_count * sizeof(AstNode)) == 0 &&
+           memcmp(tree->lists, ast_lists, (size_t)ast_list_count * sizeof(int32_t)) == 0;
+}
+
+/* stack code of the last compilation, as pile_code.txt */
+static char *listing(size_t *size) {
+    char *text = NULL;
+    FILE *file = open_memstream(&text, size);
+    write_code(file);
+    fclose(file);
+    return text;
+}
+
+int main(int argc, char **argv) {
+    int verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+    if (argc - verbose != 3) {
+        fprintf(stderr, "Usage: %s [-v] fichier.pas editions.txt\n", argv[0]);
+        return 1;
+    }
+    size_t size;
+    char *source = read_file(argv[1 + verbose], &size);
+    FILE *editions = fopen(argv[2 + verbose], "r");
+    if (editions == NULL) {
+        perror(argv[2 + verbose]);
+        return 1;
+    }
+
+    double t0 = now();
+    Document *doc = document_open(source, size);
+    double t_open = now() - t0;
+    if (doc == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    char line[4096], inserted[4096], message[256];
+    int edits = 0, failed = 0, mismatches = 0;
+    long relexed = 0, parsed = 0;
+    int full = 0;
+    double t_incremental = 0, t_full = 0;
+    double *times = NULL;
+    while (fgets(line, sizeof(line), editions) != NULL) {
+        long ligne, colonne;
+        size_t removed, length = 0;
+        int skip = 0;
+        if (sscanf(line, "%ld %ld %zu \"%n", &ligne, &colonne, &removed, &skip) != 3 || skip == 0) continue;
+        for (const char *p = line + skip; *p != '\0' && *p != '"'; ++p) {
+            char c = *p;
+            if (c == '\\' && p[1] == 'n') c = '\n', ++p;
+            else if (c == '\\' && p[1] != '\0') c = *++p;
+            inserted[length++] = c;
+        }
+
+        size_t text_size, offset = 0;
+        const char *text = document_text(doc, &text_size);
+        for (long l = 1; l < ligne && offset < text_size; ++offset) {
+            if (text[offset] == '\n') ++l;
+        }
+        offset += (size_t)colonne - 1;
+
+        t0 = now();
+        int status = document_edit(doc, offset, removed, inserted, length);
+        double t1 = now();
+        text = document_text(doc, &text_size);
+        int expected = full_parse(text, text_size, message, sizeof(message));
+        double t2 = now();
+        t_incremental += t1 - t0;
+        if ((edits & (edits - 1)) == 0) times = realloc(times, (size_t)(edits ? 2 * edits : 1) * sizeof(double));
+        if (times == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        times[edits] = t1 - t0;
+        t_full += t2 - t1;
+
+        const DocumentStats *stats = document_stats(doc);
+        relexed += stats->relexed;
+        full += stats->full;
+        parsed += stats->parsed;
+        edits++;
+        failed += status != 0;
+        int same = status == expected &&
+                   (status == 0 ? same_tree(document_tree(doc)) : strcmp(document_erreur(doc), message) == 0);
+        if (!same) {
+            mismatches++;
+            fprintf(stderr, "edit %d (line %ld): incremental %s, full parse %s\n", edits, ligne,
+                    status == 0 ? "ok" : document_erreur(doc), expected == 0 ? "ok" : message);
+        }
+        if (verbose)
+            printf("%4d %5s  %6d tokens relexed  %6d statements parsed%s  %8.1f us  full %8.1f us\n",
+                   edits, status == 0 ? "ok" : "error", stats->relexed, stats->parsed, stats->full ? " (all)" : "",
+                   (t1 - t0) * 1e6, (t2 - t1) * 1e6);
+        ast_free();
+    }
+    fclose(editions);
+
+    /* when the final text parses, its tree is the document's; before
+       compiler(), which resets the names interned in that tree */
+    int same_code = 1;
+    if (document_erreur(doc)[0] == '\0') {
+        Compilation c;
+        size_t a_size, b_size, text_size;
+        compilation_init(&c, NULL);
+        int a_status = document_compile(doc, &c);
+        char *a = listing(&a_size);
+        c.text = document_text(doc, &text_size);
+        c.size = text_size;
+        int b_status = compiler(&c);
+        char *b = listing(&b_size);
+        same_code = a_status == b_status && a_size == b_size && memcmp(a, b, a_size) == 0;
+        if (!same_code) fprintf(stderr, "the document and the final text do not compile to the same code\n");
+        free(a);
+        free(b);
+    }
+
+    printf("%zu bytes, %d edits (%d that do not parse), open %.1f ms\n", size, edits, failed, t_open * 1e3);
+    if (edits > 0) {
+        printf("incremental        : %8.1f us per edit (%.1f tokens relexed, %.1f statements parsed, %d whole parses)\n",
+               t_incremental / edits * 1e6, (double)relexed / edits, (double)parsed / edits, full);
+        qsort(times, (size_t)edits, sizeof(double), compare_times);
+        printf("                     %8.1f us median, %.1f us at most\n", times[edits / 2] * 1e6,
+               times[edits - 1] * 1e6);
+        printf("relex + full parse : %8.1f us per edit\n", t_full / edits * 1e6);
+        printf("gain               : %8.1fx\n", t_full / t_incremental);
+    }
+    printf("%s\n", mismatches == 0 && same_code ? "same trees and code as full parses" : "DIFFERENCES");
+    free(times);
+    free(source);
+    document_close(doc);
+    return mismatches == 0 && same_code ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Incremental relexing and reparsing (incremental.h) against relexing and
+# reparsing the whole text, replaying the edits of bench/editions.txt on
+# the 50000-statement program of gen_programme.sh (which they were
+# recorded on), then on one four times as large, where an edit should
+# cost the same: typing statements in, fixing a typo, deleting and
+# pasting lines, commenting code out and back, adding a variable. Checks
+# the trees against full parses at every edit. -v: one line per edit.
+# Usage: bench/edition.sh [-v]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -DANALYSEUR_SYNT_SANS_MAIN -o "$work/edition" "$root/bench/edition.c" "$root/incremental.c" \
+    "$root/analyseur_synt.c" "$root/analyseur_lex.c" "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/peephole.c" \
+    "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/erreur.c"
+
+for n in 50000 200000; do
+    echo "== $n instructions"
+    sh "$root/bench/gen_programme.sh" $n > "$work/grand.pas"
+    "$work/edition" "$@" "$work/grand.pas" "$root/bench/editions.txt"
+done
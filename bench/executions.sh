@@ -0,0 +1,71 @@
+#!/bin/sh
+# One compiled program over many input files (executions.c) with one
+# thread against one per processor, from the listing and from the
+# module: checks that the outputs and the summaries (times aside) are the
+# same, then gives the wall time of each run. One input never ends and
+# must be stopped by the fuel limit, another one is not a number.
+# Usage: bench/executions.sh [nombre d'entrees] [nombres par entree]
+set -e
+n=${1:-2000}
+k=${2:-20}
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -pthread -o "$work/executions" "$root/executions.c" "$root/pool.c" "$root/entrees.c" "$root/vm.c" "$root/module.c" "$root/code.c" "$root/erreur.c"
+
+cd "$work"
+cat > collatz.pas <<'PAS'
+program collatz;
+var k, n, pas : integer;
+begin
+    readln(k);
+    while k > 0 do
+    begin
+        readln(n);
+        pas := 0;
+        while n <> 1 do
+        begin
+            if n - n / 2 * 2 = 0 then n := n / 2 else n := 3 * n + 1;
+            pas := pas + 1
+        end;
+        writeln(pas);
+        k := k - 1
+    end
+end.
+PAS
+./analyseur_synt -q --module collatz.mod collatz.pas
+mkdir entrees
+awk -v n="$n" -v k="$k" 'BEGIN {
+    for (i = 0; i < n; i++) {
+        f = sprintf("entrees/e%05d.txt", i)
+        if (i == 1) { print "1\n0" > f }                 # 0 never reaches 1
+        else if (i == 2) { print "1\nzero" > f }
+        else {
+            print k > f
+            for (v = 0; v < k; v++) print (i * 7919 + v * 104729) % 100000 + 2 > f
+        }
+        close(f)
+    }
+}'
+threads=$(getconf _NPROCESSORS_ONLN)
+echo "$n entrees de $k nombres, $threads processeurs"
+
+./executions -j 1 -f 10000000 -o un pile_code.txt entrees > un.txt || true
+./executions -j "$threads" -f 10000000 -o tous collatz.mod entrees > tous.txt || true
+for f in un/*.sortie; do
+    cmp -s "$f" "tous/$(basename "$f")" || { echo "$f: sorties differentes" >&2; exit 1; }
+done
+if [ "$(sed -n '/^$/q; s/, [0-9.]* ms$//p' un.txt)" != "$(sed -n '/^$/q; s/, [0-9.]* ms$//p' tous.txt)" ]; then
+    echo "les resumes different" >&2
+    exit 1
+fi
+grep -v '^entrees/' tous.txt | sed -n '2,3p'
+grep 'e0000[12]' tous.txt
+printf '1 thread, listing  '
+grep '^1 threads' un.txt
+printf '%-18s ' "$threads threads, module"
+grep "^$threads threads" tous.txt
+grep '^  thread' tous.txt
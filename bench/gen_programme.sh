@@ -0,0 +1,23 @@
+#!/bin/sh
+# Generates a large Pascal program for the benchmarks.
+# Usage: gen_programme.sh <nombre d'instructions> > grand.txt
+n=${1:-100000}
+awk -v n="$n" 'BEGIN {
+    print "program grand;"
+    print "var"
+    print "    a, b, c, d, i, n : integer;"
+    print "    e : char;"
+    print "begin"
+    print "    a := 1; b := 2; c := 3; d := 4; i := 0; n := 10;"
+    for (k = 0; k < n; k++) {
+        r = k % 6
+        if (r == 0)      print "    a := a + b * (c - 1);"
+        else if (r == 1) print "    (* commentaire numero " k " *) b := b - a / 3 + 7;"
+        else if (r == 2) print "    if a < b then c := c + 1 else d := d - 1;"
+        else if (r == 3) print "    while i < n do i := i + 1;"
+        else if (r == 4) print "    if c >= d then writeln(c);"
+        else             print "    d := (a + b) * (c + d) - 42;"
+    }
+    print "    writeln(a)"
+    print "end."
+}'
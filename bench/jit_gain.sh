@@ -0,0 +1,28 @@
+#!/bin/sh
+# Interpreter against x86-64 JIT on the loop programs of bench/programmes:
+# checks that both print the same thing and gives the run time of each.
+# Usage: bench/jit_gain.sh [programme.pas ...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -o "$work/automate" "$root/automate.c" "$root/code.c" "$root/vm.c" "$root/module.c" "$root/jit.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+
+[ $# -gt 0 ] || set -- "$root"/bench/programmes/*.pas
+cd "$work"
+for p in "$@"; do
+    ./analyseur_synt -q "$p"
+    ./automate -s pile_code.txt >interprete.out 2>interprete.err
+    ./automate -s -j pile_code.txt >jit.out 2>jit.err
+    if ! cmp -s interprete.out jit.out; then
+        echo "$(basename "$p" .pas): les sorties different" >&2
+        exit 1
+    fi
+    ti=$(sed -n 's/.* en \([0-9.]*\) s.*/\1/p' interprete.err)
+    tj=$(sed -n 's/code natif en \([0-9.]*\) s/\1/p' jit.err)
+    awk -v n="$(basename "$p" .pas)" -v ti="$ti" -v tj="$tj" \
+        'BEGIN { printf "%-14s interprete %.3f s   jit %.3f s   x%.1f\n", n, ti, tj, (tj > 0 ? ti / tj : 0) }'
+done
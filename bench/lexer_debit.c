@@ -0,0 +1,72 @@
+/* Lexer throughput in MB/s: getNextToken(FILE *) against the zero-copy
+   lexer over the mapped source.
+   Build: gcc -O2 -DANALYSEUR_LEX_SANS_MAIN bench/lexer_debit.c analyseur_lex.c -o lexer_debit
+   Usage: lexer_debit fichier.pas [repetitions] */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../analyseur_lex.h"
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s fichier.pas [repetitions]\n", argv[0]);
+        return 1;
+    }
+    int reps = argc > 2 ? atoi(argv[2]) : 5;
+    double best_file = 1e30, best_span = 1e30;
+    long tokens_file = 0, tokens_span = 0;
+    size_t size = 0;
+
+    for (int r = 0; r < reps; ++r) {
+        FILE *f = fopen(argv[1], "r");
+        if (f == NULL) {
+            perror(argv[1]);
+            return 1;
+        }
+        lexer_start();
+        double t0 = now();
+        Token t;
+        tokens_file = 0;
+        do {
+            t = getNextToken(f);
+            tokens_file++;
+        } while (t.type != EOF_TOKEN);
+        double t1 = now();
+        fclose(f);
+        if (t1 - t0 < best_file) best_file = t1 - t0;
+
+        Source src;
+        if (source_open(&src, argv[1]) != 0) {
+            perror(argv[1]);
+            return 1;
+        }
+        size = src.size;
+        t0 = now();
+        SpanToken s;
+        tokens_span = 0;
+        do {
+            s = nextSpanToken(&src);
+            tokens_span++;
+        } while (s.type != EOF_TOKEN);
+        t1 = now();
+        source_close(&src);
+        if (t1 - t0 < best_span) best_span = t1 - t0;
+    }
+
+    if (tokens_file != tokens_span) {
+        fprintf(stderr, "token counts differ: %ld vs %ld\n", tokens_file, tokens_span);
+        return 1;
+    }
+    double mb = size / 1e6;
+    printf("%.1f MB, %ld tokens, best of %d\n", mb, tokens_span, reps);
+    printf("getNextToken(FILE *) : %8.1f MB/s  %6.1f Mtokens/s\n", mb / best_file, tokens_file / best_file / 1e6);
+    printf("nextSpanToken(mmap)  : %8.1f MB/s  %6.1f Mtokens/s\n", mb / best_span, tokens_span / best_span / 1e6);
+    return 0;
+}
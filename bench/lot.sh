@@ -0,0 +1,37 @@
+#!/bin/sh
+# Batch compilation (lot.c) with one thread against one per processor on
+# a corpus of generated programs and bench/programmes: checks that the
+# listings are the same, then gives the wall time of each run.
+# Usage: bench/lot.sh [nombre de programmes] [instructions par programme]
+set -e
+n=${1:-2000}
+size=${2:-2000}
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -pthread -DANALYSEUR_LEX_SANS_MAIN -DANALYSEUR_SYNT_SANS_MAIN -o "$work/lot" "$root/lot.c" "$root/pool.c" "$root/entrees.c" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/erreur.c"
+
+cd "$work"
+mkdir corpus
+cp "$root"/bench/programmes/*.pas corpus/
+sh "$root/bench/gen_programme.sh" "$size" > modele.pas
+i=0
+while [ $i -lt "$n" ]; do
+    cp modele.pas "corpus/p$i.pas"
+    i=$((i + 1))
+done
+threads=$(getconf _NPROCESSORS_ONLN)
+echo "corpus: $(ls corpus | wc -l) fichiers, $threads processeurs"
+
+./lot -j 1 -o un corpus > un.txt
+./lot -j "$threads" -o tous corpus > tous.txt
+for f in un/*.txt; do
+    [ "$(basename "$f")" = resume.txt ] || cmp -s "$f" "tous/$(basename "$f")" || { echo "$f: listings differents" >&2; exit 1; }
+done
+printf '1 thread    '
+grep '^1 threads' un.txt
+printf '%-11s ' "$threads threads"
+grep "^$threads threads" tous.txt
+grep '^  thread' tous.txt
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Start-up of the stack automaton on a program of about a million
+# instructions: the pile_code.txt listing (parsed, verified and threaded
+# at load) against the compiled module of analyseur_synt --module (mapped,
+# verified and run in place). Checks that both print the same thing.
+# Usage: bench/module.sh [nombre d'instructions Pascal] [repetitions]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+n=${1:-130000}
+r=${2:-10}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -o "$work/automate" "$root/automate.c" "$root/code.c" "$root/vm.c" "$root/module.c" "$root/jit.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+
+cd "$work"
+sh "$root/bench/gen_programme.sh" "$n" > programme.pas
+./analyseur_synt -q --stats --module programme.mod programme.pas 2>&1 | sed -n 's/^instructions .* -> /instructions : /p'
+printf 'pile_code.txt : %d octets, programme.mod : %d octets\n' "$(wc -c < pile_code.txt)" "$(wc -c < programme.mod)"
+
+now() { date +%s.%N; }
+
+for f in pile_code.txt programme.mod; do
+    ./automate -s "$f" </dev/null >"$f.out" 2>"$f.err"
+    t0=$(now)
+    i=0
+    while [ $i -lt "$r" ]; do ./automate "$f" </dev/null >/dev/null; i=$((i + 1)); done
+    t1=$(now)
+    awk -v f="$f" -v a="$t0" -v b="$t1" -v r="$r" -v d="$(sed -n 's/.*demarrage en \([0-9.]*\) ms/\1/p' "$f.err")" \
+        'BEGIN { printf "%-14s demarrage %9.3f ms   processus complet %8.1f ms\n", f, d, (b - a) / r * 1e3 }'
+done
+if ! cmp -s pile_code.txt.out programme.mod.out; then
+    echo "les sorties different" >&2
+    exit 1
+fi
@@ -0,0 +1,92 @@
+/* Keyword lookups per second: the former lowercase copy + strcmp scan
+   against the generated perfect hash, on keyword-heavy and
+   identifier-heavy word lists.
+   Build: gcc -O2 -I. bench/mots_cles.c -o mots_cles */
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mots_cles.h"
+
+#define WORDS 4096
+#define ROUNDS 2000
+
+static const char *keywords[] = {
+    "program", "begin", "end", "var", "integer", "char", "if", "then", "else",
+    "while", "do", "read", "readln", "write", "writeln"
+};
+static const TokenType keywordTypes[] = {
+    PROGRAM, BEGIN, END, VAR, INTEGER, CHAR, IF, THEN, ELSE,
+    WHILE, DO, READ, READLN, WRITE, WRITELN
+};
+
+/* the lookup analyseur_lex.c used before mots_cles.h */
+static int strcmp_lookup(const char *word, TokenType *type) {
+    char lower[100];
+    for (int i = 0; word[i] && i < (int)sizeof(lower)-1; ++i) lower[i] = (char)tolower((unsigned char)word[i]);
+    lower[strlen(word)] = '\0';
+    for (int i = 0; i < 15; ++i) {
+        if (strcmp(lower, keywords[i]) == 0) {
+            *type = keywordTypes[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static const char *identifiers[] = {
+    "x", "y", "compteur", "i", "total", "Somme", "tmp1", "resultat", "n", "valeurMax",
+    "index2", "a", "b", "reste", "quotient", "ligne", "Colonne", "k", "debut", "fin"
+};
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void run(const char *name, char words[][16], unsigned *lengths) {
+    volatile unsigned sink = 0;
+    TokenType type;
+
+    double t0 = now();
+    for (int r = 0; r < ROUNDS; ++r)
+        for (int i = 0; i < WORDS; ++i)
+            if (strcmp_lookup(words[i], &type)) sink += type;
+    double t1 = now();
+    for (int r = 0; r < ROUNDS; ++r)
+        for (int i = 0; i < WORDS; ++i)
+            if (keyword_lookup(words[i], lengths[i], &type)) sink += type;
+    double t2 = now();
+
+    double n = (double)WORDS * ROUNDS / 1e6;
+    printf("%-18s strcmp %7.1f M/s   hash %7.1f M/s   x%.1f\n",
+           name, n / (t1 - t0), n / (t2 - t1), (t1 - t0) / (t2 - t1));
+}
+
+int main(void) {
+    static char words[WORDS][16];
+    static unsigned lengths[WORDS];
+    int i;
+
+    srand(42);
+    /* keyword-heavy: 80% keywords in random case */
+    for (i = 0; i < WORDS; ++i) {
+        const char *w = rand() % 5 ? keywords[rand() % 15] : identifiers[rand() % 20];
+        for (lengths[i] = 0; w[lengths[i]]; ++lengths[i])
+            words[i][lengths[i]] = rand() % 4 ? w[lengths[i]] : (char)toupper((unsigned char)w[lengths[i]]);
+        words[i][lengths[i]] = '\0';
+    }
+    run("keyword-heavy", words, lengths);
+
+    /* identifier-heavy: 10% keywords */
+    for (i = 0; i < WORDS; ++i) {
+        const char *w = rand() % 10 ? identifiers[rand() % 20] : keywords[rand() % 15];
+        strcpy(words[i], w);
+        lengths[i] = (unsigned)strlen(w);
+    }
+    run("identifier-heavy", words, lengths);
+    return 0;
+}
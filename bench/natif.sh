@@ -0,0 +1,35 @@
+#!/bin/sh
+# Native executables from analyseur_synt --asm against the stack automaton
+# on bench/programmes: the outputs must be identical; gives the run time
+# of the interpreter, the JIT and the executable.
+# Usage: bench/natif.sh [programme.pas ...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -o "$work/automate" "$root/automate.c" "$root/code.c" "$root/vm.c" "$root/module.c" "$root/jit.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+
+now() { date +%s.%N; }
+
+[ $# -gt 0 ] || set -- "$root"/bench/programmes/*.pas
+cd "$work"
+for p in "$@"; do
+    ./analyseur_synt -q --asm programme.s "$p"
+    gcc -o programme programme.s
+    ./automate -s pile_code.txt </dev/null >interprete.out 2>interprete.err || true
+    ./automate -s -j pile_code.txt </dev/null >/dev/null 2>jit.err || true
+    t0=$(now)
+    ./programme </dev/null >natif.out 2>natif.err || true
+    t1=$(now)
+    if ! cmp -s interprete.out natif.out || [ "$(grep -v instructions interprete.err)" != "$(cat natif.err)" ]; then
+        echo "$(basename "$p" .pas): les sorties different" >&2
+        exit 1
+    fi
+    ti=$(sed -n 's/.* en \([0-9.]*\) s.*/\1/p' interprete.err)
+    tj=$(sed -n 's/code natif en \([0-9.]*\) s/\1/p' jit.err)
+    awk -v n="$(basename "$p" .pas)" -v ti="$ti" -v tj="$tj" -v t0="$t0" -v t1="$t1" \
+        'BEGIN { printf "%-14s interprete %.3f s   jit %.3f s   natif %.3f s\n", n, ti, tj, t1 - t0 }'
+done
@@ -0,0 +1,33 @@
+#!/bin/sh
+# Wall time of the two-program flow (analyseur_lex, then analyseur_synt
+# reading tokens.txt) against the fused in-process compiler.
+# Usage: bench/pipeline.sh [nombre d'instructions]
+set -e
+n=${1:-200000}
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -o "$work/analyseur_lex" "$root/analyseur_lex.c" "$root/tokens_bin.c"
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+
+cd "$work"
+sh "$root/bench/gen_programme.sh" "$n" > program.txt
+echo "source: $(wc -c < program.txt) octets, $n instructions"
+
+now() { date +%s.%N; }
+
+t0=$(now)
+./analyseur_lex
+./analyseur_synt -q --tokens tokens.txt
+t1=$(now)
+cp pile_code.txt pile_code_deux.txt
+./analyseur_synt -q program.txt
+t2=$(now)
+
+cmp -s pile_code.txt pile_code_deux.txt || { echo "code genere different" >&2; exit 1; }
+awk -v a="$t0" -v b="$t1" -v c="$t2" 'BEGIN {
+    printf "deux programmes : %.3f s\n", b - a
+    printf "fusionne        : %.3f s\n", c - b
+    printf "gain            : %.1f %%\n", 100 * (1 - (c - b) / (b - a))
+}'
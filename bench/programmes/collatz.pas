@@ -0,0 +1,20 @@
+program collatz;
+var
+    n, x, pas, max : integer;
+begin
+    max := 0;
+    n := 1;
+    while n < 100000 do
+    begin
+        x := n;
+        pas := 0;
+        while x <> 1 do
+        begin
+            if x - x / 2 * 2 = 0 then x := x / 2 else x := 3 * x + 1;
+            pas := pas + 1
+        end;
+        if pas > max then max := pas;
+        n := n + 1
+    end;
+    writeln(max)
+end.
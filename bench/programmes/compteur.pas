@@ -0,0 +1,10 @@
+program compteur;
+var
+    x, y : integer;
+begin
+    x := 0;
+    y := 50000000;
+    while x < y do
+        x := x + 1;
+    writeln(x)
+end.
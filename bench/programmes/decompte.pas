@@ -0,0 +1,14 @@
+program decompte;
+var
+    x, y, n : integer;
+begin
+    n := 0;
+    x := 20000000;
+    while x >= 1 do
+    begin
+        y := x;
+        if y <= 10000000 then n := n + 1;
+        x := x - 1
+    end;
+    writeln(n)
+end.
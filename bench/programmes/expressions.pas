@@ -0,0 +1,15 @@
+program expressions;
+var
+    i, n, s, t : integer;
+begin
+    n := 10000000;
+    i := 0;
+    s := 0;
+    while i < n do
+    begin
+        t := i * 8 + 2 * 3 - 6 + 0;
+        s := s + t / 4 - i * 1;
+        i := i + 1
+    end;
+    writeln(s)
+end.
@@ -0,0 +1,19 @@
+program imbrique;
+var
+    i, j, n, t : integer;
+begin
+    n := 3000;
+    t := 0;
+    i := 0;
+    while i < n do
+    begin
+        j := 0;
+        while j < n do
+        begin
+            if j > i then t := t + 1 else t := t - 1;
+            j := j + 1
+        end;
+        i := i + 1
+    end;
+    writeln(t)
+end.
@@ -0,0 +1,17 @@
+program pgcd;
+var
+    a, b, k, total : integer;
+begin
+    total := 0;
+    k := 1;
+    while k <= 30000 do
+    begin
+        a := k * 7 + 13;
+        b := k + 29;
+        while a <> b do
+            if a > b then a := a - b else b := b - a;
+        total := total + a;
+        k := k + 1
+    end;
+    writeln(total)
+end.
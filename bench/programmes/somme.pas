@@ -0,0 +1,14 @@
+program somme;
+var
+    i, n, s : integer;
+begin
+    n := 20000000;
+    i := 0;
+    s := 0;
+    while i < n do
+    begin
+        s := s + i * 3;
+        i := i + 1
+    end;
+    writeln(s)
+end.
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Stack automaton against the register machine (ir.h) on the loop programs
+# of bench/programmes: checks that both print the same thing, then gives
+# instructions executed and run time of each.
+# Usage: bench/registres.sh [programme.pas ...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -o "$work/automate" "$root/automate.c" "$root/code.c" "$root/vm.c" "$root/module.c" "$root/jit.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+
+[ $# -gt 0 ] || set -- "$root"/bench/programmes/*.pas
+cd "$work"
+for p in "$@"; do
+    ./analyseur_synt -q "$p"
+    ./automate -s pile_code.txt >pile.out 2>pile.err
+    ./automate -s -r pile_code.txt >registres.out 2>registres.err
+    if ! cmp -s pile.out registres.out; then
+        echo "$(basename "$p" .pas): les sorties different" >&2
+        exit 1
+    fi
+    printf '%-14s pile      ' "$(basename "$p" .pas)"
+    cat pile.err
+    printf '%-14s registres ' ""
+    cat registres.err
+done
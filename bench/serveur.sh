@@ -0,0 +1,54 @@
+#!/bin/sh
+# Compile server against a process per compilation on a small program:
+# analyseur_lex then analyseur_synt (the two-program flow), analyseur_synt
+# alone, and client talking to serveur, first compiling then from the
+# cache. Checks that the listings are the same.
+# Usage: bench/serveur.sh [programme.pas] [repetitions]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+source=${1:-$root/program.txt}
+n=${2:-200}
+work=$(mktemp -d)
+trap '[ -S "$work/s.sock" ] && "$work/client" -s "$work/s.sock" --arret; rm -rf "$work"' EXIT
+
+gcc -O2 -o "$work/analyseur_lex" "$root/analyseur_lex.c" "$root/tokens_bin.c"
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -pthread -DANALYSEUR_LEX_SANS_MAIN -DANALYSEUR_SYNT_SANS_MAIN -o "$work/serveur" "$root/serveur.c" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/erreur.c"
+gcc -O2 -o "$work/client" "$root/client.c"
+
+cd "$work"
+cp "$source" program.txt
+./serveur -s s.sock &
+while [ ! -S s.sock ]; do sleep 0.05; done
+
+now() { date +%s.%N; }
+
+t0=$(now)
+i=0
+while [ $i -lt "$n" ]; do ./analyseur_lex > /dev/null; ./analyseur_synt -q --tokens tokens.txt; i=$((i + 1)); done
+t1=$(now)
+i=0
+while [ $i -lt "$n" ]; do ./analyseur_synt -q program.txt; i=$((i + 1)); done
+t2=$(now)
+mkdir attendu
+cp pile_code.txt symbol_table.txt etiquettes.txt attendu/
+rm pile_code.txt symbol_table.txt etiquettes.txt
+./client -s s.sock program.txt
+t3=$(now)
+i=0
+while [ $i -lt "$n" ]; do ./client -s s.sock program.txt; i=$((i + 1)); done
+t4=$(now)
+for f in pile_code.txt symbol_table.txt etiquettes.txt; do
+    cmp -s "$f" "attendu/$f" || { echo "$f different" >&2; exit 1; }
+done
+
+awk -v n="$n" -v a="$t0" -v b="$t1" -v c="$t2" -v d="$t3" -v e="$t4" 'BEGIN {
+    printf "analyseur_lex + analyseur_synt : %8.1f us par compilation\n", (b - a) / n * 1e6
+    printf "analyseur_synt                 : %8.1f us\n", (c - b) / n * 1e6
+    printf "client, premiere compilation   : %8.1f us\n", (d - c) * 1e6
+    printf "client, depuis le cache        : %8.1f us\n", (e - d) / n * 1e6
+}'
+printf 'aller-retour sans processus     : '
+./client -s s.sock -n 10000 program.txt 2>&1 | sed 's/.*, //'
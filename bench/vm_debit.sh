@@ -0,0 +1,23 @@
+#!/bin/sh
+# Instructions per second of the stack automaton on the loop programs of
+# bench/programmes, with computed-goto dispatch and with the switch loop.
+# Usage: bench/vm_debit.sh [programme.pas ...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+gcc -O2 -DANALYSEUR_LEX_SANS_MAIN -o "$work/analyseur_synt" "$root/analyseur_synt.c" "$root/analyseur_lex.c" \
+    "$root/code.c" "$root/symtab.c" "$root/tokens_bin.c" "$root/vm.c" "$root/peephole.c" "$root/ast.c" "$root/sema.c" "$root/optimiser.c" "$root/codegen.c" "$root/cfg.c" "$root/licm.c" "$root/dataflow.c" "$root/jit.c" "$root/aot.c" "$root/module.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -o "$work/automate" "$root/automate.c" "$root/code.c" "$root/vm.c" "$root/module.c" "$root/jit.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+gcc -O2 -DVM_SWITCH -o "$work/automate_switch" "$root/automate.c" "$root/code.c" "$root/vm.c" "$root/module.c" "$root/jit.c" "$root/ir.c" "$root/ir_vm.c" "$root/erreur.c"
+
+[ $# -gt 0 ] || set -- "$root"/bench/programmes/*.pas
+cd "$work"
+for p in "$@"; do
+    ./analyseur_synt -q "$p"
+    printf '%-14s goto   ' "$(basename "$p" .pas)"
+    ./automate -s pile_code.txt 2>&1 >/dev/null
+    printf '%-14s switch ' ""
+    ./automate_switch -s pile_code.txt 2>&1 >/dev/null
+done
@@ -0,0 +1,508 @@
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cfg.h"
+#include "erreur.h"
+
+_Thread_local int cfg_counts[CFG_COUNT];
+
+static const char *const stat_names[CFG_COUNT] = {
+    [CFG_BRANCHE_CONSTANTE] = "branche-constante",
+    [CFG_BLOC_INATTEIGNABLE] = "bloc-inatteignable",
+    [CFG_BLOC_VIDE] = "bloc-vide"
+};
+
+typedef struct {
+    int start, end;     /* body: instrs[start..end), without labels or final jump */
+    int branch;         /* conditional jump ending the block, or -1 */
+    int next;           /* successor by fall-through or Aller, -1 after Halte */
+    int taken;          /* target of the conditional jump, or -1 */
+    int label;          /* first label of the block, -1 if it had none */
+    int live;
+} Block;
+
+#define FOLLOWING (-2)  /* cfg_build(): next is the block after this one */
+
+static _Thread_local Instr *instrs = NULL;    /* copy of the code the blocks refer to */
+static _Thread_local Block *blocks = NULL;
+static _Thread_local int block_count = 0;
+static _Thread_local int entry = 0;
+static _Thread_local int *layout = NULL;      /* live blocks in emission order */
+static _Thread_local int layout_count = 0;
+static _Thread_local int *work = NULL;        /* scratch, one int per block */
+static _Thread_local int blocks_built = 0, blocks_emitted = 0, jumps_built = 0, jumps_emitted = 0;
+
+static void *allocate(int n, size_t size) {
+    void *p = calloc(n > 0 ? (size_t)n : 1, size);
+    if (p == NULL) {
+        erreur("Code memory overflow");
+    }
+    return p;
+}
+
+void cfg_free(void) {
+    free(instrs);
+    free(blocks);
+    free(layout);
+    free(work);
+    instrs = NULL;
+    blocks = NULL;
+    layout = NULL;
+    work = NULL;
+    block_count = layout_count = 0;
+}
+
+static int new_block(int start) {
+    Block *b = &blocks[block_count];
+    b->start = b->end = start;
+    b->branch = -1;
+    b->next = FOLLOWING;
+    b->taken = -1;
+    b->label = -1;
+    b->live = 1;
+    return block_count++;
+}
+
+/* layout = live blocks in their original order */
+static void default_layout(void) {
+    layout_count = 0;
+    for (int b = 0; b < block_count; ++b) {
+        if (blocks[b].live) layout[layout_count++] = b;
+    }
+}
+
+int cfg_build(const Instr *code, int count) {
+    int max_label = -1;
+    cfg_free();
+    /* blocks takes count + 1 entries */
+    if (count <= 0 || count == INT_MAX) return -1;
+    for (int i = 0; i < count; ++i) {
+        if (code[i].op != OP_ETIQ && !opcode_is_jump(code[i].op)) continue;
+        if (code[i].arg < 0) return -1;
+        if (code[i].arg > max_label) max_label = code[i].arg;
+    }
+
+    size_t bytes = (size_t)count * sizeof(Instr);
+    instrs = allocate(count, sizeof(Instr));
+    memcpy(instrs, code, bytes);
+    blocks = allocate(count + 1, sizeof(Block));
+    int *label_block = allocate(max_label + 1, sizeof(int));
+    for (int l = 0; l <= max_label; ++l) label_block[l] = -1;
+
+    /* a block starts at a run of labels, or after a jump or Halte; jump
+       targets are label numbers until every block exists */
+    int cur = -1;
+    jumps_built = 0;
+    for (int i = 0; i < count; ++i) {
+        Instr in = code[i];
+        if (in.op == OP_ETIQ) {
+            if (cur < 0 || blocks[cur].end > blocks[cur].start) cur = new_block(i + 1);
+            if (label_block[in.arg] != -1) {
+                free(label_block);
+                cfg_free();
+                return -1;
+            }
+            label_block[in.arg] = cur;
+            if (blocks[cur].label < 0) blocks[cur].label = in.arg;
+            blocks[cur].start = blocks[cur].end = i + 1;
+            continue;
+        }
+        if (cur < 0) cur = new_block(i);
+        if (opcode_is_jump(in.op)) {
+            jumps_built++;
+            if (in.op == OP_ALLER) blocks[cur].next = in.arg;
+            else {
+                blocks[cur].branch = in.op;
+                blocks[cur].taken = in.arg;
+            }
+            cur = -1;
+            continue;
+        }
+        blocks[cur].end = i + 1;
+        if (in.op == OP_HALTE) {
+            blocks[cur].next = -1;
+            cur = -1;
+        }
+    }
+
+    int status = 0;
+    for (int b = 0; b < block_count; ++b) {
+        Block *k = &blocks[b];
+        if (k->next == FOLLOWING) k->next = b + 1 < block_count ? b + 1 : -1;
+        else if (k->next >= 0 && (k->next = label_block[k->next]) < 0) status = -1;
+        if (k->taken >= 0 && (k->taken = label_block[k->taken]) < 0) status = -1;
+    }
+    free(label_block);
+    if (status != 0) {
+        cfg_free();
+        return -1;
+    }
+
+    layout = allocate(block_count, sizeof(int));
+    work = allocate(block_count + 1, sizeof(int));
+    entry = 0;
+    blocks_built = block_count;
+    default_layout();
+    return 0;
+}
+
+/* ---------- simplification ---------- */
+
+/* does the conditional jump op, on a and b, fall through? */
+static int condition_holds(int op, int32_t a, int32_t b) {
+    switch (op) {
+        case OP_ALLER_SI_PAS_SUP:       return a > b;
+        case OP_ALLER_SI_PAS_INF:       return a < b;
+        case OP_ALLER_SI_PAS_EGAL:      return a == b;
+        case OP_ALLER_SI_PAS_SUP_EGAL:  return a >= b;
+        case OP_ALLER_SI_PAS_INF_EGAL:  return a <= b;
+        default:                        return a != b;
+    }
+}
+
+/* a conditional jump whose operands are pushed by Empiler right before
+   it always goes the same way: drop the pushes and keep that edge */
+static void fold_constant_branches(void) {
+    for (int b = 0; b < block_count; ++b) {
+        Block *k = &blocks[b];
+        const Instr *body = instrs + k->start;
+        int n = k->end - k->start, holds;
+        if (k->branch < 0) continue;
+        if (k->branch == OP_ALLER_SI_FAUX) {
+            if (n < 1 || body[n - 1].op != OP_EMPILER) continue;
+            holds = body[n - 1].arg != 0;
+            k->end -= 1;
+        } else {
+            if (n < 2 || body[n - 2].op != OP_EMPILER || body[n - 1].op != OP_EMPILER) continue;
+            holds = condition_holds(k->branch, body[n - 2].arg, body[n - 1].arg);
+            k->end -= 2;
+        }
+        if (!holds) k->next = k->taken;
+        k->branch = -1;
+        k->taken = -1;
+        cfg_counts[CFG_BRANCHE_CONSTANTE]++;
+    }
+}
+
+static int is_empty(int b) {
+    const Block *k = &blocks[b];
+    return k->start == k->end && k->branch < 0 && k->next >= 0;
+}
+
+#define UNSEEN  (-2)
+#define ON_PATH (-3)
+
+/* first non-empty block reached from b; work[] memoizes it. Empty
+   blocks that loop on themselves (an empty infinite loop) stay. */
+static int forward(int b) {
+    int *path = layout;     /* free until cfg_layout() */
+    int cur = b, result, n = 0;
+    for (;;) {
+        if (work[cur] >= 0) {
+            result = work[cur];
+            break;
+        }
+        if (work[cur] == ON_PATH) {
+            result = -1;
+            break;
+        }
+        if (!is_empty(cur)) {
+            result = work[cur] = cur;
+            break;
+        }
+        work[cur] = ON_PATH;
+        path[n++] = cur;
+        cur = blocks[cur].next;
+    }
+    for (int k = 0; k < n; ++k) work[path[k]] = result == -1 ? path[k] : result;
+    return work[b];
+}
+
+void cfg_simplify(void) {
+    fold_constant_branches();
+
+    for (int b = 0; b < block_count; ++b) work[b] = UNSEEN;
+    for (int b = 0; b < block_count; ++b) {
+        Block *k = &blocks[b];
+        if (k->next >= 0) k->next = forward(k->next);
+        if (k->taken >= 0) k->taken = forward(k->taken);
+    }
+    entry = forward(entry);
+
+    /* whatever the entry does not reach goes, including the empty blocks
+       every edge now skips */
+    for (int b = 0; b < block_count; ++b) blocks[b].live = 0;
+    int *stack = work, top = 0;
+    blocks[entry].live = 1;
+    stack[top++] = entry;
+    while (top > 0) {
+        const Block *k = &blocks[stack[--top]];
+        int succ[2] = {k->next, k->taken};
+        for (int s = 0; s < 2; ++s) {
+            if (succ[s] >= 0 && !blocks[succ[s]].live) {
+                blocks[succ[s]].live = 1;
+                stack[top++] = succ[s];
+            }
+        }
+    }
+    for (int b = 0; b < block_count; ++b) {
+        if (blocks[b].live) continue;
+        if (blocks[b].start == blocks[b].end && blocks[b].branch < 0) cfg_counts[CFG_BLOC_VIDE]++;
+        else cfg_counts[CFG_BLOC_INATTEIGNABLE]++;
+    }
+    default_layout();
+    if (layout[0] != entry) {
+        /* the entry was an empty block: its first successor leads now */
+        memmove(layout + 1, layout, (size_t)layout_count * sizeof(int));
+        layout[0] = entry;
+        for (int k = 1; k <= layout_count; ++k) {
+            if (layout[k] == entry) {
+                memmove(layout + k, layout + k + 1, (size_t)(layout_count - k) * sizeof(int));
+                break;
+            }
+        }
+    }
+}
+
+/* ---------- layout ---------- */
+
+/* the same jump with the condition reversed, or -1 (Aller-si-faux has
+   no counterpart) */
+static int inverse_branch(int op) {
+    switch (op) {
+        case OP_ALLER_SI_PAS_SUP:       return OP_ALLER_SI_PAS_INF_EGAL;
+        case OP_ALLER_SI_PAS_INF:       return OP_ALLER_SI_PAS_SUP_EGAL;
+        case OP_ALLER_SI_PAS_EGAL:      return OP_ALLER_SI_PAS_DIFF;
+        case OP_ALLER_SI_PAS_SUP_EGAL:  return OP_ALLER_SI_PAS_INF;
+        case OP_ALLER_SI_PAS_INF_EGAL:  return OP_ALLER_SI_PAS_SUP;
+        case OP_ALLER_SI_PAS_DIFF:      return OP_ALLER_SI_PAS_EGAL;
+        default:                        return -1;
+    }
+}
+
+typedef struct {
+    int64_t weight;
+    int from, to;
+} Edge;
+
+static int compare_edges(const void *x, const void *y) {
+    const Edge *a = x, *b = y;
+    if (a->weight != b->weight) return a->weight > b->weight ? -1 : 1;
+    if (a->from != b->from) return a->from - b->from;
+    return a->to - b->to;
+}
+
+static int find(int *parent, int b) {
+    while (parent[b] != b) {
+        parent[b] = parent[parent[b]];
+        b = parent[b];
+    }
+    return b;
+}
+
+/*
+ * Static estimate of how often each edge runs, then greedy chaining
+ * (Pettis and Hansen): edges are taken heaviest first, and one joins two
+ * chains when it leaves the tail of one and enters the head of the
+ * other, so that it becomes a fall-through. The code comes from
+ * structured statements and blocks are in source order, so an edge to a
+ * block that is not after its source is a loop's back edge and the loop
+ * spans the blocks between the two. A block nested in d loops is
+ * estimated to run 8^d times; a conditional jump goes to the loop header
+ * or stays in the loop 9 times out of 10, and is even otherwise. Back
+ * edges never become fall-throughs: the loop test is already at the
+ * bottom (generer_programme() rotates loops), and pulling the header
+ * after it would only add a jump into the loop.
+ */
+void cfg_layout(void) {
+    int *depth = work;
+    for (int b = 0; b <= block_count; ++b) depth[b] = 0;
+    for (int b = 0; b < block_count; ++b) {
+        const Block *k = &blocks[b];
+        if (!k->live) continue;
+        if (k->next >= 0 && k->next <= b) depth[k->next]++, depth[b + 1]--;
+        if (k->taken >= 0 && k->taken <= b) depth[k->taken]++, depth[b + 1]--;
+    }
+    for (int b = 1; b < block_count; ++b) depth[b] += depth[b - 1];
+
+    Edge *edges = allocate(2 * block_count, sizeof(Edge));
+    int nedges = 0;
+    for (int b = 0; b < block_count; ++b) {
+        const Block *k = &blocks[b];
+        if (!k->live || k->next < 0) continue;
+        int64_t freq = (int64_t)1 << (3 * (depth[b] < 10 ? depth[b] : 10));
+        int p_next = 100, p_taken = 0;
+        if (k->branch >= 0) {
+            p_next = 50;
+            if (k->taken <= b || depth[k->next] < depth[b]) p_next = 10;
+            else if (k->next <= b || depth[k->taken] < depth[b]) p_next = 90;
+            p_taken = 100 - p_next;
+        }
+        if (k->next > b) edges[nedges++] = (Edge){freq * p_next, b, k->next};
+        /* only a reversible jump can fall through to its target */
+        if (k->branch >= 0 && k->taken > b && inverse_branch(k->branch) >= 0)
+            edges[nedges++] = (Edge){freq * p_taken, b, k->taken};
+    }
+    qsort(edges, (size_t)nedges, sizeof(Edge), compare_edges);
+
+    int *parent = allocate(block_count, sizeof(int));
+    int *chain_next = allocate(block_count, sizeof(int));
+    int *has_pred = allocate(block_count, sizeof(int));
+    for (int b = 0; b < block_count; ++b) {
+        parent[b] = b;
+        chain_next[b] = -1;
+    }
+    for (int e = 0; e < nedges; ++e) {
+        int from = edges[e].from, to = edges[e].to;
+        if (chain_next[from] >= 0 || has_pred[to] || to == entry) continue;
+        int a = find(parent, from), c = find(parent, to);
+        if (a == c) continue;
+        parent[c] = a;
+        chain_next[from] = to;
+        has_pred[to] = 1;
+    }
+
+    /* the entry's chain, then the others in source order */
+    layout_count = 0;
+    for (int b = entry; b >= 0; b = chain_next[b]) layout[layout_count++] = b;
+    for (int h = 0; h < block_count; ++h) {
+        if (!blocks[h].live || has_pred[h] || h == entry) continue;
+        for (int b = h; b >= 0; b = chain_next[b]) layout[layout_count++] = b;
+    }
+
+    free(edges);
+    free(parent);
+    free(chain_next);
+    free(has_pred);
+}
+
+/* ---------- output ---------- */
+
+/* how block layout[i] ends: an optional conditional jump (cond, to
+   cond_to) then an optional Aller (to aller_to) */
+typedef struct {
+    int cond, cond_to, aller_to;
+} Exit;
+
+static Exit block_exit(int i) {
+    const Block *k = &blocks[layout[i]];
+    int follow = i + 1 < layout_count ? layout[i + 1] : -1;
+    Exit x = {-1, -1, -1};
+    if (k->branch >= 0) {
+        if (k->taken == follow && k->next != follow && inverse_branch(k->branch) >= 0) {
+            x.cond = inverse_branch(k->branch);
+            x.cond_to = k->next;
+            return x;
+        }
+        x.cond = k->branch;
+        x.cond_to = k->taken;
+    }
+    if (k->next >= 0 && k->next != follow) x.aller_to = k->next;
+    return x;
+}
+
+static int ends_in_halte(const Block *k) {
+    return k->end > k->start && instrs[k->end - 1].op == OP_HALTE;
+}
+
+void cfg_emit(void) {
+    int *label = work;
+    for (int b = 0; b < block_count; ++b) label[b] = -1;
+    for (int i = 0; i < layout_count; ++i) {
+        Exit x = block_exit(i);
+        int targets[2] = {x.cond_to, x.aller_to};
+        for (int t = 0; t < 2; ++t) {
+            int b = targets[t];
+            if (b < 0 || label[b] >= 0) continue;
+            label[b] = blocks[b].label >= 0 ? blocks[b].label : nouvelle_etiquette();
+        }
+    }
+
+    code_index = 0;
+    blocks_emitted = layout_count;
+    jumps_emitted = 0;
+    for (int i = 0; i < layout_count; ++i) {
+        const Block *k = &blocks[layout[i]];
+        if (label[layout[i]] >= 0) generer(OP_ETIQ, label[layout[i]]);
+        for (int j = k->start; j < k->end; ++j) {
+            generer((Opcode)instrs[j].op, instrs[j].arg);
+            code[code_index - 1].arg2 = instrs[j].arg2;
+        }
+        Exit x = block_exit(i);
+        if (x.cond >= 0) {
+            generer((Opcode)x.cond, label[x.cond_to]);
+            jumps_emitted++;
+        }
+        if (x.aller_to >= 0) {
+            generer(OP_ALLER, label[x.aller_to]);
+            jumps_emitted++;
+        }
+        /* the end of the code halted; elsewhere it must say so */
+        if (k->next < 0 && !ends_in_halte(k) && i + 1 < layout_count) generer(OP_HALTE, 0);
+    }
+}
+
+/* ---------- Graphviz ---------- */
+
+static void dot_escape(FILE *file, const char *text) {
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') fputc('\\', file);
+        fputc(*text, file);
+    }
+}
+
+int cfg_write_dot(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) return -1;
+    int *position = work;
+    for (int b = 0; b < block_count; ++b) position[b] = -1;
+    for (int i = 0; i < layout_count; ++i) position[layout[i]] = i;
+
+    /* B<n> in layout order; solid edges are taken when the condition
+       holds or unconditionally, dashed ones when it fails */
+    fprintf(file, "digraph cfg {\n");
+    fprintf(file, "    node [shape=box, fontname=\"monospace\"];\n");
+    for (int i = 0; i < layout_count; ++i) {
+        const Block *k = &blocks[layout[i]];
+        char text[64];
+        fprintf(file, "    B%d [label=\"B%d", i, i);
+        if (k->label >= 0) fprintf(file, "  (Etiq_%d)", k->label);
+        fprintf(file, "\\l");
+        for (int j = k->start; j < k->end; ++j) {
+            format_instr(text, sizeof text, instrs[j]);
+            dot_escape(file, text);
+            fprintf(file, "\\l");
+        }
+        if (k->branch >= 0) {
+            dot_escape(file, opcode_mnemonic((Opcode)k->branch));
+            fprintf(file, " B%d\\l", position[k->taken]);
+        }
+        fprintf(file, "\"];\n");
+    }
+    for (int i = 0; i < layout_count; ++i) {
+        const Block *k = &blocks[layout[i]];
+        if (k->next >= 0) {
+            fprintf(file, "    B%d -> B%d%s;\n", i, position[k->next],
+                    k->branch >= 0 ? " [label=\"vrai\"]" : "");
+        }
+        if (k->taken >= 0)
+            fprintf(file, "    B%d -> B%d [label=\"faux\", style=dashed];\n", i, position[k->taken]);
+    }
+    fprintf(file, "}\n");
+
+    if (fclose(file) != 0) {
+        perror(filename);
+        return -1;
+    }
+    return 0;
+}
+
+void cfg_print_stats(FILE *file) {
+    for (int s = 0; s < CFG_COUNT; ++s) {
+        fprintf(file, "cfg %-25s %d\n", stat_names[s], cfg_counts[s]);
+    }
+    fprintf(file, "cfg blocs %d -> %d, sauts %d -> %d\n", blocks_built, blocks_emitted, jumps_built, jumps_emitted);
+}
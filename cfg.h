@@ -0,0 +1,46 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdio.h>
+
+#include "code.h"
+
+/*
+ * Control-flow graph of the generated code, built from the code buffer
+ * before the peephole pass, while labels are still Etiq markers. A basic
+ * block is a run of instructions entered only at its first one (the
+ * labels in front of it) and left only at its last one: a jump, Halte,
+ * or a fall-through into the next block.
+ *
+ *   cfg_build()     splits the buffer into blocks
+ *   cfg_simplify()  folds branches on constants, forwards empty blocks to
+ *                   their successor and drops the unreachable ones
+ *   cfg_layout()    orders the blocks so that the likely successor of
+ *                   each one follows it and needs no jump
+ *   cfg_emit()      writes the blocks back into the code buffer
+ */
+typedef enum {
+    CFG_BRANCHE_CONSTANTE,  /* conditional jump on a constant, now unconditional */
+    CFG_BLOC_INATTEIGNABLE, /* block no path from the entry reaches */
+    CFG_BLOC_VIDE,          /* block with no instruction, jumped over */
+    CFG_COUNT
+} CfgStat;
+
+extern _Thread_local int cfg_counts[CFG_COUNT];
+
+/* builds the graph of code[0..count), a copy of which is kept; returns
+   -1 (and builds nothing) on an empty buffer, or on a jump to an
+   undefined or a duplicate label, left for backpatch() to report */
+int cfg_build(const Instr *code, int count);
+void cfg_simplify(void);
+void cfg_layout(void);
+/* replaces the code buffer (code, code_index) with the blocks in layout
+   order; labels are kept where a jump still needs them */
+void cfg_emit(void);
+/* Graphviz description of the graph, in layout order; returns -1 with
+   errno set if the file cannot be opened */
+int cfg_write_dot(const char *filename);
+void cfg_print_stats(FILE *file);
+void cfg_free(void);
+
+#endif
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "serveur.h"
+
+/* Compiles through a running serveur, in place of analyseur_lex then
+   analyseur_synt -q: the source goes over the socket and
+   pile_code.txt, symbol_table.txt and etiquettes.txt come back, written
+   in the current directory; compile errors are printed on stderr.
+   Usage: client [-s socket] [-n N] [-O0 | [--dataflow passes] [--peephole regles]]
+                 [--stats | --arret | source]
+   Exit status 1 if the source does not compile or the server cannot be
+   reached. */
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const char *const sorties[] = { "pile_code.txt", "symbol_table.txt", "etiquettes.txt" };
+
+/* the whole of filename ("-" = stdin) in a malloc'ed buffer */
+static char *read_source(const char *filename, size_t *size) {
+    FILE *file = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "rb");
+    if (file == NULL) {
+        perror(filename);
+        return NULL;
+    }
+    size_t capacity = 1 << 16, n = 0, got;
+    char *text = malloc(capacity);
+    while (text != NULL && (got = fread(text + n, 1, capacity - n, file)) > 0) {
+        n += got;
+        if (n == capacity) {
+            char *grown = realloc(text, capacity *= 2);
+            if (grown == NULL) free(text);
+            text = grown;
+        }
+    }
+    if (file != stdin) fclose(file);
+    if (text == NULL) fprintf(stderr, "Out of memory\n");
+    *size = n;
+    return text;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s socket] [-n N] [-O0 | [--dataflow passes] [--peephole regles]]\n"
+                    "       [--stats | --arret | source]\n", prog);
+    fprintf(stderr, "  source     Pascal source to compile (default: program.txt, - = stdin)\n");
+    fprintf(stderr, "  -s socket  server socket (default: %s)\n", SERVEUR_SOCKET);
+    fprintf(stderr, "  -n N       send the request N times and print the mean round trip\n");
+    fprintf(stderr, "  -O0, --dataflow, --peephole  as for analyseur_synt\n");
+    fprintf(stderr, "  --stats    print the server's request and cache counts\n");
+    fprintf(stderr, "  --arret    stop the server\n");
+}
+
+int main(int argc, char **argv) {
+    const char *chemin = SERVEUR_SOCKET;
+    const char *source = "program.txt";
+    const char *commande = NULL;
+    char options[SERVEUR_LIGNE / 2] = "";
+    long repetitions = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            chemin = argv[++i];
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            repetitions = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            commande = "stats\n";
+        } else if (strcmp(argv[i], "--arret") == 0) {
+            commande = "arret\n";
+        } else if (strcmp(argv[i], "-O0") == 0 ||
+                   ((strcmp(argv[i], "--dataflow") == 0 || strcmp(argv[i], "--peephole") == 0) && i + 1 < argc)) {
+            /* checked by the server */
+            size_t len = strlen(options);
+            snprintf(options + len, sizeof(options) - len, " %s", argv[i]);
+            if (argv[i][1] == '-') {
+                len = strlen(options);
+                snprintf(options + len, sizeof(options) - len, " %s", argv[++i]);
+            }
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            source = argv[i];
+        }
+    }
+    if (repetitions < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, chemin, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror(chemin);
+        return 1;
+    }
+    FILE *out = fdopen(fd, "w");
+    FILE *in = fdopen(dup(fd), "r");
+    if (out == NULL || in == NULL) {
+        perror(chemin);
+        return 1;
+    }
+
+    char line[SERVEUR_LIGNE];
+    if (commande != NULL) {
+        fputs(commande, out);
+        fflush(out);
+        if (strcmp(commande, "stats\n") == 0 && fgets(line, sizeof(line), in) != NULL) fputs(line, stdout);
+        return 0;
+    }
+
+    size_t size;
+    char *text = read_source(source, &size);
+    if (text == NULL) return 1;
+
+    int status = 0, cache = 0, hits = 0;
+    size_t longueur[4];
+    char *reponse = NULL;
+    size_t capacity = 0;
+    double t0 = now();
+    for (long r = 0; r < repetitions; ++r) {
+        fprintf(out, "compiler %zu%s\n", size, options);
+        fwrite(text, 1, size, out);
+        if (fflush(out) != 0 || fgets(line, sizeof(line), in) == NULL ||
+            sscanf(line, "%d %d %zu %zu %zu %zu", &status, &cache,
+                   &longueur[0], &longueur[1], &longueur[2], &longueur[3]) != 6) {
+            fprintf(stderr, "%s: no answer from the server\n", chemin);
+            return 1;
+        }
+        size_t n = longueur[0] + longueur[1] + longueur[2] + longueur[3];
+        if (n > capacity || reponse == NULL) {
+            free(reponse);
+            capacity = n;
+            reponse = malloc(capacity ? capacity : 1);
+            if (reponse == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+        }
+        if (fread(reponse, 1, n, in) != n) {
+            fprintf(stderr, "%s: truncated answer\n", chemin);
+            return 1;
+        }
+        hits += cache;
+    }
+    double t1 = now();
+
+    /* like analyseur_synt, the listings are only written for a program
+       that compiled */
+    size_t offset = 0;
+    for (int t = 0; t < 3; ++t) {
+        if (status == 0) {
+            FILE *file = fopen(sorties[t], "w");
+            if (file == NULL) {
+                fprintf(stderr, "Error opening file %s for writing\n", sorties[t]);
+                return 1;
+            }
+            fwrite(reponse + offset, 1, longueur[t], file);
+            fclose(file);
+        }
+        offset += longueur[t];
+    }
+    fwrite(reponse + offset, 1, longueur[3], stderr);
+    if (repetitions > 1)
+        fprintf(stderr, "%ld requetes, %d depuis le cache, %.1f us par requete\n",
+                repetitions, hits, (t1 - t0) / repetitions * 1e6);
+
+    free(reponse);
+    free(text);
+    fclose(out);
+    fclose(in);
+    return status;
+}
@@ -0,0 +1,274 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "code.h"
+#include "erreur.h"
+
+#define CODE_SIZE 1000
+
+_Thread_local Instr *code = NULL;
+_Thread_local int code_index = 0;
+
+_Thread_local int *label_index = NULL;
+_Thread_local int label_count = 0;
+
+static _Thread_local int code_capacity = 0;
+static _Thread_local int label_counter = 0;
+
+static const char *const mnemonics[OP_COUNT] = {
+    [OP_VALEURG] = "Valeurg",
+    [OP_VALEURD] = "Valeurd",
+    [OP_EMPILER] = "Empiler",
+    [OP_AFFECTER] = ":=",
+    [OP_ADD] = "+",
+    [OP_SUB] = "-",
+    [OP_MUL] = "*",
+    [OP_DIV] = "/",
+    [OP_MOD] = "%",
+    [OP_DECALER_GAUCHE] = "Décaler-gauche",
+    [OP_DECALER_DROITE] = "Décaler-droite",
+    [OP_COMPARER_SUP] = "Comparer-si-sup",
+    [OP_COMPARER_INF] = "Comparer-si-inf",
+    [OP_COMPARER_EGAL] = "Comparer-si-égal",
+    [OP_COMPARER_SUP_EGAL] = "Comparer-si-sup-égal",
+    [OP_COMPARER_INF_EGAL] = "Comparer-si-inf-égal",
+    [OP_COMPARER_DIFF] = "Comparer-si-différent",
+    [OP_ALLER] = "Aller à",
+    [OP_ALLER_SI_FAUX] = "Aller-si-faux",
+    [OP_ALLER_SI_PAS_SUP] = "Aller-si-pas-sup",
+    [OP_ALLER_SI_PAS_INF] = "Aller-si-pas-inf",
+    [OP_ALLER_SI_PAS_EGAL] = "Aller-si-pas-égal",
+    [OP_ALLER_SI_PAS_SUP_EGAL] = "Aller-si-pas-sup-égal",
+    [OP_ALLER_SI_PAS_INF_EGAL] = "Aller-si-pas-inf-égal",
+    [OP_ALLER_SI_PAS_DIFF] = "Aller-si-pas-différent",
+    [OP_ETIQ] = "Etiq",
+    [OP_INCR] = "Incr",
+    [OP_LIRE] = "Lire",
+    [OP_ECRIRE] = "Ecrire",
+    [OP_HALTE] = "Halte"
+};
+
+/* generer code instruction */
+void generer(Opcode op, int32_t arg) {
+    if (code_index >= code_capacity) {
+        int capacity = code_capacity ? code_capacity * 2 : CODE_SIZE;
+        Instr *grown = realloc(code, (size_t)capacity * sizeof(Instr));
+        if (grown == NULL) {
+            erreur("Code memory overflow");
+        }
+        code = grown;
+        code_capacity = capacity;
+    }
+    code[code_index].op = (uint16_t)op;
+    code[code_index].arg2 = 0;
+    code[code_index].arg = arg;
+    code_index++;
+}
+
+void generer_aller_si_faux(int etiquette) {
+    /* a label between the comparison and the jump is still an Etiq
+       marker here, so the comparison is never a jump target */
+    if (code_index > 0 && code[code_index - 1].op >= OP_COMPARER_SUP &&
+        code[code_index - 1].op <= OP_COMPARER_DIFF) {
+        code[code_index - 1].op = OP_ALLER_SI_PAS_SUP + (code[code_index - 1].op - OP_COMPARER_SUP);
+        code[code_index - 1].arg = etiquette;
+        return;
+    }
+    generer(OP_ALLER_SI_FAUX, etiquette);
+}
+
+void generer_aller_si_vrai(int etiquette) {
+    /* jump unless the opposite comparison holds */
+    static const Opcode inverse[] = {
+        OP_ALLER_SI_PAS_INF_EGAL,   /* sup */
+        OP_ALLER_SI_PAS_SUP_EGAL,   /* inf */
+        OP_ALLER_SI_PAS_DIFF,       /* égal */
+        OP_ALLER_SI_PAS_INF,        /* sup-égal */
+        OP_ALLER_SI_PAS_SUP,        /* inf-égal */
+        OP_ALLER_SI_PAS_EGAL        /* différent */
+    };
+    if (code_index > 0 && code[code_index - 1].op >= OP_COMPARER_SUP &&
+        code[code_index - 1].op <= OP_COMPARER_DIFF) {
+        code[code_index - 1].op = inverse[code[code_index - 1].op - OP_COMPARER_SUP];
+        code[code_index - 1].arg = etiquette;
+        return;
+    }
+    /* any other value: jump unless it equals 0 */
+    generer(OP_EMPILER, 0);
+    generer(OP_ALLER_SI_PAS_EGAL, etiquette);
+}
+
+void code_reset(void) {
+    free(label_index);
+    label_index = NULL;
+    label_count = 0;
+    code_index = 0;
+    label_counter = 0;
+}
+
+int nouvelle_etiquette(void) {
+    return label_counter++;
+}
+
+int opcode_is_jump(int32_t op) {
+    return op == OP_ALLER || op == OP_ALLER_SI_FAUX ||
+           (op >= OP_ALLER_SI_PAS_SUP && op <= OP_ALLER_SI_PAS_DIFF);
+}
+
+int *backpatch(Instr *code, int *count, int *nlabels) {
+    int n = *count, max_label = -1;
+
+    for (int i = 0; i < n; ++i) {
+        if (code[i].op != OP_ETIQ && !opcode_is_jump(code[i].op)) continue;
+        if (code[i].arg < 0) {
+            fprintf(stderr, "Error: instruction %d uses negative label %d\n", i, code[i].arg);
+            return NULL;
+        }
+        if (code[i].arg > max_label) max_label = code[i].arg;
+    }
+
+    int *table = malloc((size_t)(max_label + 2) * sizeof(int));
+    if (table == NULL) {
+        fprintf(stderr, "Code memory overflow\n");
+        return NULL;
+    }
+    for (int l = 0; l <= max_label; ++l) table[l] = -1;
+
+    /* drop the markers; a label lands on the next instruction kept */
+    int kept = 0;
+    for (int i = 0; i < n; ++i) {
+        if (code[i].op == OP_ETIQ) {
+            if (table[code[i].arg] != -1) {
+                fprintf(stderr, "Error: label Etiq_%d defined twice\n", code[i].arg);
+                free(table);
+                return NULL;
+            }
+            table[code[i].arg] = kept;
+            continue;
+        }
+        code[kept++] = code[i];
+    }
+
+    for (int i = 0; i < kept; ++i) {
+        if (!opcode_is_jump(code[i].op)) continue;
+        if (table[code[i].arg] == -1) {
+            fprintf(stderr, "Error: jump to undefined label Etiq_%d\n", code[i].arg);
+            free(table);
+            return NULL;
+        }
+        code[i].arg = table[code[i].arg];
+    }
+
+    *count = kept;
+    *nlabels = max_label + 1;
+    return table;
+}
+
+void resoudre_etiquettes(void) {
+    free(label_index);
+    label_index = backpatch(code, &code_index, &label_count);
+    if (label_index == NULL) erreur("Error: code labels cannot be resolved");
+}
+
+const char *opcode_mnemonic(Opcode op) {
+    return (unsigned)op < OP_COUNT ? mnemonics[op] : "?";
+}
+
+void format_instr(char *buffer, size_t size, Instr instr) {
+    if (opcode_is_jump(instr.op)) {
+        snprintf(buffer, size, "%s %d", mnemonics[instr.op], instr.arg);
+        return;
+    }
+    switch (instr.op) {
+        case OP_VALEURG:
+        case OP_VALEURD:
+        case OP_EMPILER:
+        case OP_DECALER_GAUCHE:
+        case OP_DECALER_DROITE:
+            snprintf(buffer, size, "%s %d", mnemonics[instr.op], instr.arg);
+            break;
+        case OP_ETIQ:
+            snprintf(buffer, size, "%s Etiq_%d", mnemonics[instr.op], instr.arg);
+            break;
+        case OP_INCR:
+            snprintf(buffer, size, "%s %d %d", mnemonics[instr.op], instr.arg, instr.arg2);
+            break;
+        default:
+            snprintf(buffer, size, "%s", opcode_mnemonic((Opcode)instr.op));
+            break;
+    }
+}
+
+int parse_instr(const char *text, Instr *instr) {
+    while (*text == ' ' || *text == '\t') text++;
+
+    for (int op = 0; op < OP_COUNT; ++op) {
+        size_t len = strlen(mnemonics[op]);
+        if (strncmp(text, mnemonics[op], len) != 0) continue;
+        const char *rest = text + len;
+        int arg = 0, arg2 = 0, n = 0, symbolic = 0;
+
+        instr->op = (uint16_t)op;
+        instr->arg2 = 0;
+        instr->arg = 0;
+        /* a failed operand may mean a longer mnemonic with the same
+           prefix ("Aller-si-pas-sup" / "Aller-si-pas-sup-égal"): keep
+           looking */
+        if (opcode_is_jump(op)) {
+            /* listings written before backpatching name the label */
+            if (sscanf(rest, " Etiq_%d%n", &arg, &n) == 1) symbolic = 1;
+            else if (sscanf(rest, " %d%n", &arg, &n) != 1) continue;
+        } else if (op == OP_VALEURG || op == OP_VALEURD || op == OP_EMPILER ||
+                   op == OP_DECALER_GAUCHE || op == OP_DECALER_DROITE) {
+            if (sscanf(rest, " %d%n", &arg, &n) != 1) continue;
+        } else if (op == OP_ETIQ) {
+            if (sscanf(rest, " Etiq_%d%n", &arg, &n) != 1) continue;
+            symbolic = 1;
+        } else if (op == OP_INCR) {
+            if (sscanf(rest, " %d %d%n", &arg, &arg2, &n) != 2 || arg2 < INT16_MIN || arg2 > INT16_MAX) continue;
+        }
+        rest += n;
+        while (*rest == ' ' || *rest == '\t' || *rest == '\r' || *rest == '\n') rest++;
+        if (*rest != '\0') continue;   /* "Comparer-si-sup-égal" also starts with "Comparer-si-sup" */
+        instr->arg = arg;
+        instr->arg2 = (int16_t)arg2;
+        return symbolic;
+    }
+    return -1;
+}
+
+void write_code(FILE *file) {
+    char line[64];
+    for (int i = 0; i < code_index; i++) {
+        format_instr(line, sizeof(line), code[i]);
+        fprintf(file, "%3d: %s\n", i, line);
+    }
+}
+
+void afficher_code(void) {
+    printf("\n--- Code pour automate a pile  ---\n");
+    write_code(stdout);
+}
+
+void write_code_to_file(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) erreur("Error opening file %s for writing", filename);
+
+    write_code(file);
+    fclose(file);
+}
+
+void write_labels(FILE *file) {
+    for (int l = 0; l < label_count; l++) {
+        fprintf(file, "Etiq_%d -> %d\n", l, label_index[l]);
+    }
+}
+
+void write_labels_to_file(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) erreur("Error opening file %s for writing", filename);
+
+    write_labels(file);
+    fclose(file);
+}
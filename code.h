@@ -0,0 +1,103 @@
+#ifndef CODE_H
+#define CODE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Instruction set of the stack automaton. The comment gives the
+   mnemonic used in pile_code.txt. */
+typedef enum {
+    OP_VALEURG,         /* Valeurg a          push the address a */
+    OP_VALEURD,         /* Valeurd a          push the value at a */
+    OP_EMPILER,         /* Empiler n          push the constant n */
+    OP_AFFECTER,        /* :=                 pop v, pop a, mem[a] = v */
+    OP_ADD,             /* +                  */
+    OP_SUB,             /* -                  */
+    OP_MUL,             /* *                  */
+    OP_DIV,             /* /                  */
+    OP_MOD,             /* %                  remainder of /, with the sign of the dividend */
+    OP_DECALER_GAUCHE,  /* Décaler-gauche k   replace the top v by v * 2^k */
+    OP_DECALER_DROITE,  /* Décaler-droite k   replace the top v by v / 2^k, truncated toward zero */
+    OP_COMPARER_SUP,    /* Comparer-si-sup    pop b, pop a, push a > b */
+    OP_COMPARER_INF,    /* Comparer-si-inf    */
+    OP_COMPARER_EGAL,   /* Comparer-si-égal   */
+    OP_COMPARER_SUP_EGAL,   /* Comparer-si-sup-égal  */
+    OP_COMPARER_INF_EGAL,   /* Comparer-si-inf-égal  */
+    OP_COMPARER_DIFF,       /* Comparer-si-différent */
+    OP_ALLER,           /* Aller à i          jump to instruction i */
+    OP_ALLER_SI_FAUX,   /* Aller-si-faux i    pop v, jump if v == 0 */
+    /* compare and branch, one per comparison and in the same order:
+       pop b, pop a, jump to i unless the comparison of a and b holds */
+    OP_ALLER_SI_PAS_SUP,        /* Aller-si-pas-sup i        */
+    OP_ALLER_SI_PAS_INF,        /* Aller-si-pas-inf i        */
+    OP_ALLER_SI_PAS_EGAL,       /* Aller-si-pas-égal i       */
+    OP_ALLER_SI_PAS_SUP_EGAL,   /* Aller-si-pas-sup-égal i   */
+    OP_ALLER_SI_PAS_INF_EGAL,   /* Aller-si-pas-inf-égal i   */
+    OP_ALLER_SI_PAS_DIFF,       /* Aller-si-pas-différent i  */
+    OP_ETIQ,            /* Etiq Etiq_n        label marker, removed by backpatch() */
+    OP_INCR,            /* Incr a c           mem[a] += c (from the peephole pass) */
+    OP_LIRE,            /* Lire               push an integer read from input */
+    OP_ECRIRE,          /* Ecrire             pop and print */
+    OP_HALTE,           /* Halte              */
+    OP_COUNT
+} Opcode;
+
+typedef struct {
+    uint16_t op;
+    int16_t arg2;       /* second operand: the constant of Incr */
+    int32_t arg;        /* address, constant, label number or jump target */
+} Instr;
+
+extern _Thread_local Instr *code;
+extern _Thread_local int code_index;
+
+/* after resoudre_etiquettes(): instruction index of each label, -1 for
+   a label that was never placed */
+extern _Thread_local int *label_index;
+extern _Thread_local int label_count;
+
+/* empties the code buffer and restarts label numbering, for the next
+   compilation in the same thread */
+void code_reset(void);
+
+void generer(Opcode op, int32_t arg);
+/* Aller-si-faux to a label, fused with the comparison just generated
+   into a single compare-and-branch when there is one */
+void generer_aller_si_faux(int etiquette);
+/* the opposite jump, taken when the value or comparison just generated
+   holds */
+void generer_aller_si_vrai(int etiquette);
+int nouvelle_etiquette(void);
+
+int opcode_is_jump(int32_t op);
+
+/*
+ * Backpatching: the code generator jumps to label numbers and places Etiq
+ * markers. backpatch() deletes the markers from code[0..*count) and turns
+ * every jump operand into the index of the instruction that followed its
+ * label, so jumps need no lookup and markers cost nothing at run time.
+ * Returns the label -> index table (*nlabels entries, malloc'ed), or NULL
+ * on an undefined or duplicate label.
+ */
+int *backpatch(Instr *code, int *count, int *nlabels);
+/* backpatches the code buffer and keeps the table in label_index */
+void resoudre_etiquettes(void);
+
+const char *opcode_mnemonic(Opcode op);
+/* one pile_code.txt line body, without the "%3d: " index */
+void format_instr(char *buffer, size_t size, Instr instr);
+/* inverse of format_instr(); returns 0 on success, 1 for an Etiq marker
+   or a jump to a symbolic Etiq_n (code that still needs backpatch()),
+   -1 if the text is not an instruction */
+int parse_instr(const char *text, Instr *instr);
+
+void afficher_code(void);
+/* pile_code.txt and etiquettes.txt contents; the write_*_to_file()
+   functions report an unwritable file with erreur() */
+void write_code(FILE *file);
+void write_code_to_file(const char *filename);
+/* the label side table, one "Etiq_n -> index" line per label */
+void write_labels(FILE *file);
+void write_labels_to_file(const char *filename);
+
+#endif
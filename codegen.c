@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "code.h"
+#include "erreur.h"
+
+/* Both walks keep their own stack of (node, step) frames instead of
+   recursing, so deeply nested programs need no C stack. */
+
+typedef struct {
+    int node;
+    int step;           /* how much of the node is already emitted */
+    int etiq1, etiq2;   /* labels of an if or while */
+} GenFrame;
+
+static _Thread_local int rotate_loops;
+
+static _Thread_local GenFrame *gen_stack = NULL;
+static _Thread_local int gen_count = 0;
+static _Thread_local int gen_capacity = 0;
+
+static void push(int node, int step) {
+    if (gen_count == gen_capacity) {
+        gen_capacity = gen_capacity ? gen_capacity * 2 : 256;
+        gen_stack = realloc(gen_stack, (size_t)gen_capacity * sizeof(GenFrame));
+        if (gen_stack == NULL) {
+            erreur("Code generator stack overflow");
+        }
+    }
+    gen_stack[gen_count].node = node;
+    gen_stack[gen_count].step = step;
+    gen_count++;
+}
+
+static void gen_expr(int e) {
+    int base = gen_count;
+    push(e, 0);
+    while (gen_count > base) {
+        GenFrame f = gen_stack[--gen_count];
+        const AstNode *n = &ast_nodes[f.node];
+
+        if (f.step == 0) {
+            switch (n->kind) {
+                case N_CONST: generer(OP_EMPILER, n->value); continue;
+                case N_VAR:   generer(OP_VALEURD, n->value); continue;
+            }
+            /* operator after its operands: a is emitted first */
+            push(f.node, 1);
+            if (n->b >= 0 && n->kind != N_SHL && n->kind != N_SHR) push(n->b, 0);
+            push(n->a, 0);
+            continue;
+        }
+
+        switch (n->kind) {
+            case N_ADD:     generer(OP_ADD, 0); break;
+            case N_SUB:     generer(OP_SUB, 0); break;
+            case N_MUL:     generer(OP_MUL, 0); break;
+            case N_DIV:     generer(OP_DIV, 0); break;
+            case N_MOD:     generer(OP_MOD, 0); break;
+            case N_SHL:     generer(OP_DECALER_GAUCHE, n->value); break;
+            case N_SHR:     generer(OP_DECALER_DROITE, n->value); break;
+            case N_COMPARE: generer((Opcode)n->op, 0); break;
+        }
+    }
+}
+
+static void gen_stmt(int s) {
+    int base = gen_count;
+    push(s, 0);
+    while (gen_count > base) {
+        GenFrame *f = &gen_stack[gen_count - 1];
+        const AstNode *n = &ast_nodes[f->node];
+
+        switch (n->kind) {
+            case N_BLOCK:
+                /* step = statements already started */
+                if (f->step == n->value) {
+                    gen_count--;
+                } else {
+                    int next = ast_lists[n->a + f->step++];
+                    push(next, 0);
+                }
+                break;
+
+            case N_ASSIGN:
+                generer(OP_VALEURG, n->value);
+                gen_expr(n->a);
+                generer(OP_AFFECTER, 0);
+                gen_count--;
+                break;
+
+            case N_IF:
+                if (f->step == 0) {
+                    int etiq_else = f->etiq1 = nouvelle_etiquette();
+                    f->etiq2 = nouvelle_etiquette();     /* fin */
+                    f->step = 1;
+                    gen_expr(n->a);     /* may move the stack, and f */
+                    generer_aller_si_faux(etiq_else);
+                    push(n->b, 0);
+                } else if (f->step == 1) {
+                    generer(OP_ALLER, f->etiq2);
+                    generer(OP_ETIQ, f->etiq1);
+                    f->step = 2;
+                    if (n->c >= 0) push(n->c, 0);
+                } else {
+                    generer(OP_ETIQ, f->etiq2);
+                    gen_count--;
+                }
+                break;
+
+            case N_WHILE:
+                /* step 0: invariants hoisted by licm(), if any */
+                if (f->step == 0) {
+                    f->step = 1;
+                    if (n->c >= 0) push(n->c, 0);
+                } else if (f->step == 1) {
+                    f->etiq1 = nouvelle_etiquette();     /* debut */
+                    int etiq_fin = f->etiq2 = nouvelle_etiquette();
+                    f->step = 2;
+                    if (rotate_loops) {
+                        /* test once on entry, then at the bottom */
+                        int etiq_debut = f->etiq1;
+                        gen_expr(n->a);     /* may move the stack, and f */
+                        generer_aller_si_faux(etiq_fin);
+                        generer(OP_ETIQ, etiq_debut);
+                    } else {
+                        generer(OP_ETIQ, f->etiq1);
+                        gen_expr(n->a);     /* may move the stack, and f */
+                        generer_aller_si_faux(etiq_fin);
+                    }
+                    push(n->b, 0);
+                } else {
+                    int etiq_debut = f->etiq1, etiq_fin = f->etiq2;
+                    if (rotate_loops) {
+                        gen_expr(n->a);
+                        generer_aller_si_vrai(etiq_debut);
+                    } else {
+                        generer(OP_ALLER, etiq_debut);
+                    }
+                    generer(OP_ETIQ, etiq_fin);
+                    gen_count--;
+                }
+                break;
+
+            case N_READ:
+                generer(OP_VALEURG, n->value);
+                generer(OP_LIRE, 0);
+                generer(OP_AFFECTER, 0);
+                gen_count--;
+                break;
+
+            case N_WRITE:
+                generer(OP_VALEURD, n->value);
+                generer(OP_ECRIRE, 0);
+                gen_count--;
+                break;
+
+            default:
+                gen_count--;
+                break;
+        }
+    }
+}
+
+void generer_programme(int root, int rotate) {
+    rotate_loops = rotate;
+    gen_count = 0;
+    gen_stmt(ast_nodes[root].b);
+    generer(OP_HALTE, 0);
+}
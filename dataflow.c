@@ -0,0 +1,527 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast.h"
+#include "dataflow.h"
+#include "erreur.h"
+#include "symtab.h"
+
+/*
+ * Both analyses walk the statements once, forward for reaching
+ * definitions and backward for liveness, keeping one fact per variable
+ * in an array and the facts they overwrite on a trail:
+ *   - an if runs each branch from the facts before it, undoes what the
+ *     branch changed, then merges the variables either branch changed;
+ *   - a while body is walked once. Around its back edge, a fact set
+ *     before the loop only holds for a variable the loop does not assign
+ *     (reaching definitions) or read (liveness), which a binary search in
+ *     the loop's range tells (the tree is in post-order, see licm.c).
+ *     Leaving the loop merges the variables its body changed.
+ * The work is linear in the program, plus, for each if and while, the
+ * number of variables it changes.
+ *
+ * Liveness is slightly pessimistic in loops: a variable the loop reads
+ * anywhere is taken as live at the back edge.
+ */
+
+_Thread_local int dataflow_counts[DF_COUNT];
+
+/* loads (reads of a variable) and stores before and after the passes */
+static _Thread_local int loads_before, loads_after, stores_before, stores_after;
+
+static const char *const pass_names[DF_COUNT] = {
+    [DF_CONSTANTE] = "constante",
+    [DF_COPIE] = "copie",
+    [DF_STOCKAGE_MORT] = "stockage-mort"
+};
+
+const char *dataflow_pass_name(DataflowPass pass) {
+    return (unsigned)pass < DF_COUNT ? pass_names[pass] : "?";
+}
+
+int dataflow_parse_passes(const char *list, unsigned *passes) {
+    *passes = 0;
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        if (len == 6 && strncmp(list, "toutes", 6) == 0) {
+            *passes = DF_TOUTES;
+        } else if (!(len == 6 && strncmp(list, "aucune", 6) == 0)) {
+            int p;
+            for (p = 0; p < DF_COUNT; ++p) {
+                if (strlen(pass_names[p]) == len && strncmp(list, pass_names[p], len) == 0) break;
+            }
+            if (p == DF_COUNT) return -1;
+            *passes |= 1u << p;
+        }
+        list += len;
+        if (*list == ',') list++;
+    }
+    return 0;
+}
+
+/* reaching definitions: the N_ASSIGN or N_READ node, or */
+#define ENTRY (-1)      /* none: the value the program started with */
+#define MANY  (-2)      /* more than one */
+
+static _Thread_local unsigned passes_on;
+static _Thread_local int *lo = NULL;          /* first node of each subtree */
+static _Thread_local AstIndex stores;         /* N_ASSIGN and N_READ, by variable */
+static _Thread_local AstIndex reads;          /* N_VAR and N_WRITE, by variable */
+
+/* per variable: the fact, and for liveness when it was set (see
+   is_live()) */
+static _Thread_local int *fact = NULL;
+static _Thread_local int *stamp = NULL;
+static _Thread_local int now = 0;
+
+typedef struct {
+    int32_t var;
+    int fact;
+    int stamp;
+} Entry;
+
+/* facts overwritten, to undo a branch */
+static _Thread_local Entry *trail = NULL;
+static _Thread_local int trail_count = 0;
+static _Thread_local int trail_capacity = 0;
+
+/* variables a branch or loop body changed, with their facts at its end */
+static _Thread_local Entry *changes = NULL;
+static _Thread_local int changes_count = 0;
+static _Thread_local int changes_capacity = 0;
+
+static _Thread_local int *seen = NULL;        /* per variable, see collect_changes() */
+static _Thread_local int *pending = NULL;
+static _Thread_local int seen_mark = 0;
+
+/* loops around the statement being visited, outermost first, and the
+   time the liveness walk entered each */
+static _Thread_local int *chain = NULL;
+static _Thread_local int *chain_time = NULL;
+static _Thread_local int depth = 0;
+
+static _Thread_local int *source = NULL;      /* per copy x := y: what reached y there */
+static _Thread_local int *reached = NULL;     /* per node, see reach() */
+static _Thread_local int reach_mark = 0;
+static _Thread_local int *todo = NULL;
+
+static void *allocate(int n, size_t size) {
+    void *p = malloc((n > 0 ? (size_t)n : 1) * size);
+    if (p == NULL) {
+        erreur("Syntax tree memory overflow");
+    }
+    return p;
+}
+
+static void push_entry(Entry **array, int *count, int *capacity, Entry e) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 256;
+        *array = realloc(*array, (size_t)*capacity * sizeof(Entry));
+        if (*array == NULL) {
+            erreur("Syntax tree memory overflow");
+        }
+    }
+    (*array)[(*count)++] = e;
+}
+
+static void set_fact(int32_t v, int f) {
+    push_entry(&trail, &trail_count, &trail_capacity, (Entry){v, fact[v], stamp[v]});
+    fact[v] = f;
+    stamp[v] = now;
+}
+
+static void undo(int mark) {
+    while (trail_count > mark) {
+        Entry e = trail[--trail_count];
+        fact[e.var] = e.fact;
+        stamp[e.var] = e.stamp;
+    }
+}
+
+/* pushes each variable the trail changed since mark once on changes,
+   with what value() says of it now */
+static void collect_changes(int mark, int (*value)(int32_t v)) {
+    seen_mark++;
+    for (int t = mark; t < trail_count; ++t) {
+        int32_t v = trail[t].var;
+        if (seen[v] == seen_mark) continue;
+        seen[v] = seen_mark;
+        push_entry(&changes, &changes_count, &changes_capacity, (Entry){v, value(v), 0});
+    }
+}
+
+/* after an if, with the facts back to those before it: changes[base ..
+   mid) are those of the then branch, changes[mid ..) those of the else
+   branch; a variable only one branch changed keeps its fact from
+   before on the other */
+static void merge_branches(int base, int mid, int (*value)(int32_t v), int (*join)(int x, int y)) {
+    int in_then = ++seen_mark;
+    for (int k = base; k < mid; ++k) {
+        seen[changes[k].var] = in_then;
+        pending[changes[k].var] = changes[k].fact;
+    }
+    int done = ++seen_mark;
+    for (int k = mid; k < changes_count; ++k) {
+        int32_t v = changes[k].var;
+        int x = seen[v] == in_then ? pending[v] : value(v);
+        seen[v] = done;
+        set_fact(v, join(x, changes[k].fact));
+    }
+    for (int k = base; k < mid; ++k) {
+        int32_t v = changes[k].var;
+        if (seen[v] != done) set_fact(v, join(changes[k].fact, value(v)));
+    }
+    changes_count = base;
+}
+
+/* marks the nodes of expression e reached[] from e: its range also holds
+   the nodes optimiser() left unreferenced */
+static void reach(int e) {
+    int top = 0, kids[3];
+    reach_mark++;
+    todo[top++] = e;
+    while (top > 0) {
+        int x = todo[--top];
+        reached[x] = reach_mark;
+        for (int k = ast_children(x, kids); k-- > 0; ) todo[top++] = kids[k];
+    }
+}
+
+static int on(DataflowPass pass) {
+    return (passes_on >> pass) & 1;
+}
+
+typedef struct {
+    int node;
+    int step;
+    int mark;       /* trail_count on entry */
+    int base;       /* changes_count on entry */
+} Visit;
+
+static _Thread_local Visit *stack = NULL;
+static _Thread_local int top = 0;
+
+/* ---------- reaching definitions: constants and copies ---------- */
+
+static int raw_fact(int32_t v) {
+    return fact[v];
+}
+
+static int join_definitions(int x, int y) {
+    return x == y ? x : MANY;
+}
+
+/* the only definition of v that reaches the statement being visited */
+static int reaching(int32_t v) {
+    int d = fact[v];
+    if (d == MANY) return MANY;
+    /* the loops around the statement that d is not in, the outermost
+       first: one assigning v brings that assignment round its back edge */
+    int a = 0, b = depth;
+    while (a < b) {
+        int m = (a + b) / 2;
+        if (lo[chain[m]] <= d) a = m + 1;
+        else b = m;
+    }
+    if (a < depth && ast_index_any(&stores, v, lo[chain[a]], chain[a])) return MANY;
+    return d;
+}
+
+/* rewrites the reads of expression e with what reaches them, then
+   simplifies again from the first one rewritten up */
+static void propagate(int e) {
+    int changed = 0;
+    reach(e);
+    for (int x = lo[e]; x <= e; ++x) {
+        if (reached[x] != reach_mark) continue;
+        AstNode *n = &ast_nodes[x];
+        if (n->kind != N_VAR) {
+            if (changed) simplifier(x);
+            continue;
+        }
+        loads_before++;
+        int d = reaching(n->value);
+        if (d < 0 || ast_nodes[d].kind != N_ASSIGN) continue;
+        const AstNode *value = &ast_nodes[ast_nodes[d].a];
+        if (on(DF_COPIE) && value->kind == N_VAR && source[d] != MANY && reaching(value->value) == source[d]) {
+            n->value = value->value;
+            dataflow_counts[DF_COPIE]++;
+            changed = 1;
+            d = source[d];
+            if (d < 0 || ast_nodes[d].kind != N_ASSIGN) continue;
+            value = &ast_nodes[ast_nodes[d].a];
+        }
+        if (on(DF_CONSTANTE) && value->kind == N_CONST) {
+            n->kind = N_CONST;
+            n->value = value->value;
+            dataflow_counts[DF_CONSTANTE]++;
+            changed = 1;
+        }
+    }
+}
+
+static void forward(int body) {
+    top = 0;
+    stack[top++] = (Visit){body, 0, 0, 0};
+    while (top > 0) {
+        Visit *v = &stack[top - 1];
+        int s = v->node;
+        const AstNode *n = &ast_nodes[s];
+        switch (n->kind) {
+            case N_BLOCK:
+                top--;
+                for (int k = n->value; k-- > 0; ) stack[top++] = (Visit){ast_lists[n->a + k], 0, 0, 0};
+                break;
+            case N_ASSIGN:
+                top--;
+                stores_before++;
+                propagate(n->a);
+                if (ast_nodes[n->a].kind == N_VAR) source[s] = reaching(ast_nodes[n->a].value);
+                set_fact(n->value, s);
+                break;
+            case N_READ:
+                top--;
+                stores_before++;
+                set_fact(n->value, s);
+                break;
+            case N_WRITE:
+                top--;
+                loads_before++;
+                break;
+            case N_IF:
+                if (v->step == 0) {
+                    propagate(n->a);
+                    v->mark = trail_count;
+                    v->base = changes_count;
+                    v->step = 1;
+                    stack[top++] = (Visit){n->b, 0, 0, 0};
+                } else if (v->step == 1) {
+                    collect_changes(v->mark, raw_fact);
+                    undo(v->mark);
+                    v->step = 2;
+                    if (n->c >= 0) stack[top++] = (Visit){n->c, 0, 0, 0};
+                } else {
+                    int mid = changes_count;
+                    collect_changes(v->mark, raw_fact);
+                    undo(v->mark);
+                    merge_branches(v->base, mid, raw_fact, join_definitions);
+                    top--;
+                }
+                break;
+            case N_WHILE:
+                if (v->step == 0) {
+                    chain[depth++] = s;
+                    propagate(n->a);
+                    v->mark = trail_count;
+                    v->step = 1;
+                    stack[top++] = (Visit){n->b, 0, 0, 0};
+                } else {
+                    /* the loop exits from its test, where what the body
+                       assigns meets what was there before */
+                    int base = changes_count;
+                    collect_changes(v->mark, raw_fact);
+                    undo(v->mark);
+                    depth--;
+                    for (int k = base; k < changes_count; ++k) set_fact(changes[k].var, MANY);
+                    changes_count = base;
+                    top--;
+                }
+                break;
+            default:
+                top--;
+                break;
+        }
+    }
+}
+
+/* ---------- liveness: dead stores ---------- */
+
+static int join_liveness(int x, int y) {
+    return x | y;
+}
+
+/* may the value v holds at the statement being visited still be read? */
+static int is_live(int32_t v) {
+    /* the loops entered since the fact was set, the outermost first: if
+       it reads v, v is live at its back edge */
+    int a = 0, b = depth;
+    while (a < b) {
+        int m = (a + b) / 2;
+        if (chain_time[m] <= stamp[v]) a = m + 1;
+        else b = m;
+    }
+    if (a < depth && ast_index_any(&reads, v, lo[chain[a]], chain[a])) return 1;
+    return fact[v];
+}
+
+/* the reads of expression e make their variables live */
+static void uses(int e) {
+    reach(e);
+    for (int x = lo[e]; x <= e; ++x) {
+        if (reached[x] == reach_mark && ast_nodes[x].kind == N_VAR) {
+            loads_after++;
+            set_fact(ast_nodes[x].value, 1);
+        }
+    }
+}
+
+static void backward(int body) {
+    top = 0;
+    stack[top++] = (Visit){body, 0, 0, 0};
+    while (top > 0) {
+        Visit *v = &stack[top - 1];
+        int s = v->node;
+        AstNode *n = &ast_nodes[s];
+        switch (n->kind) {
+            case N_BLOCK:
+                top--;
+                for (int k = 0; k < n->value; ++k) stack[top++] = (Visit){ast_lists[n->a + k], 0, 0, 0};
+                break;
+            case N_ASSIGN:
+                top--;
+                if (on(DF_STOCKAGE_MORT) && !is_live(n->value) && !ast_nodes[n->a].may_trap) {
+                    /* an empty block in its place */
+                    n->kind = N_BLOCK;
+                    n->value = 0;
+                    n->a = 0;
+                    dataflow_counts[DF_STOCKAGE_MORT]++;
+                    break;
+                }
+                stores_after++;
+                set_fact(n->value, 0);
+                uses(n->a);
+                break;
+            case N_READ:
+                top--;
+                stores_after++;
+                set_fact(n->value, 0);
+                break;
+            case N_WRITE:
+                top--;
+                loads_after++;
+                set_fact(n->value, 1);
+                break;
+            case N_IF:
+                if (v->step == 0) {
+                    v->mark = trail_count;
+                    v->base = changes_count;
+                    v->step = 1;
+                    stack[top++] = (Visit){n->b, 0, 0, 0};
+                } else if (v->step == 1) {
+                    collect_changes(v->mark, is_live);
+                    undo(v->mark);
+                    v->step = 2;
+                    if (n->c >= 0) stack[top++] = (Visit){n->c, 0, 0, 0};
+                } else {
+                    int mid = changes_count;
+                    collect_changes(v->mark, is_live);
+                    undo(v->mark);
+                    merge_branches(v->base, mid, is_live, join_liveness);
+                    uses(n->a);
+                    top--;
+                }
+                break;
+            case N_WHILE:
+                if (v->step == 0) {
+                    chain[depth] = s;
+                    chain_time[depth++] = ++now;
+                    v->mark = trail_count;
+                    v->step = 1;
+                    stack[top++] = (Visit){n->b, 0, 0, 0};
+                } else {
+                    /* the test runs first: what is live there is live
+                       before the loop, as is what was live after it */
+                    uses(n->a);
+                    int base = changes_count;
+                    collect_changes(v->mark, is_live);
+                    undo(v->mark);
+                    depth--;
+                    for (int k = base; k < changes_count; ++k) {
+                        if (changes[k].fact) set_fact(changes[k].var, 1);
+                    }
+                    changes_count = base;
+                    top--;
+                }
+                break;
+            default:
+                top--;
+                break;
+        }
+    }
+}
+
+static int32_t stored_address(int i) {
+    return ast_nodes[i].kind == N_ASSIGN || ast_nodes[i].kind == N_READ ? ast_nodes[i].value : -1;
+}
+
+static int32_t read_address(int i) {
+    return ast_nodes[i].kind == N_VAR || ast_nodes[i].kind == N_WRITE ? ast_nodes[i].value : -1;
+}
+
+void dataflow(int root, unsigned passes) {
+    int count = ast_count;
+    int32_t nvars = next_address;
+    passes_on = passes;
+
+    lo = ast_subtree_starts();
+    fact = allocate(nvars, sizeof(int));
+    stamp = allocate(nvars, sizeof(int));
+    seen = allocate(nvars, sizeof(int));
+    pending = allocate(nvars, sizeof(int));
+    chain = allocate(count, sizeof(int));
+    chain_time = allocate(count, sizeof(int));
+    source = allocate(count, sizeof(int));
+    reached = allocate(count, sizeof(int));
+    todo = allocate(count, sizeof(int));
+    stack = allocate(count, sizeof(Visit));
+    for (int i = 0; i < count; ++i) reached[i] = 0;
+    for (int32_t v = 0; v < nvars; ++v) seen[v] = 0;
+    reach_mark = seen_mark = 0;
+    depth = 0;
+
+    ast_index_build(&stores, nvars, stored_address);
+    for (int32_t v = 0; v < nvars; ++v) {
+        fact[v] = ENTRY;
+        stamp[v] = 0;
+    }
+    forward(ast_nodes[root].b);
+    ast_index_free(&stores);
+
+    /* nothing is read after the program ends */
+    ast_index_build(&reads, nvars, read_address);
+    for (int32_t v = 0; v < nvars; ++v) {
+        fact[v] = 0;
+        stamp[v] = -1;
+    }
+    now = 0;
+    trail_count = changes_count = 0;
+    backward(ast_nodes[root].b);
+    ast_index_free(&reads);
+
+    free(lo);
+    free(fact);
+    free(stamp);
+    free(seen);
+    free(pending);
+    free(chain);
+    free(chain_time);
+    free(source);
+    free(reached);
+    free(todo);
+    free(stack);
+    free(trail);
+    free(changes);
+    lo = fact = stamp = seen = pending = chain = chain_time = source = reached = todo = NULL;
+    stack = NULL;
+    trail = changes = NULL;
+    trail_count = trail_capacity = changes_count = changes_capacity = 0;
+}
+
+void dataflow_print_stats(FILE *file) {
+    for (int p = 0; p < DF_COUNT; ++p) {
+        fprintf(file, "dataflow %-20s %d\n", pass_names[p], dataflow_counts[p]);
+    }
+    fprintf(file, "dataflow chargements %d -> %d, stockages %d -> %d\n",
+            loads_before, loads_after, stores_before, stores_after);
+}
@@ -0,0 +1,40 @@
+#ifndef DATAFLOW_H
+#define DATAFLOW_H
+
+#include <stdio.h>
+
+/*
+ * Dataflow passes over the syntax tree, between optimiser() and licm().
+ * Every variable lives at a fixed address, so both analyses track one
+ * fact per address along the structured statements:
+ *
+ *   reaching definitions  the only assignment to x (if just one) whose
+ *                         value can be in x at a given read
+ *   liveness              whether the value of x may still be read
+ *
+ * and the passes rewrite the tree with what they find.
+ */
+typedef enum {
+    DF_CONSTANTE,       /* read of x whose only reaching definition is x := c: c */
+    DF_COPIE,           /* read of x whose only reaching definition is x := y,
+                           y unchanged since: read of y */
+    DF_STOCKAGE_MORT,   /* x := e, x not live after and e cannot fail: removed */
+    DF_COUNT
+} DataflowPass;
+
+#define DF_TOUTES ((1u << DF_COUNT) - 1)
+
+/* times each pass fired, summed over every dataflow() call of the
+   thread */
+extern _Thread_local int dataflow_counts[DF_COUNT];
+
+const char *dataflow_pass_name(DataflowPass pass);
+/* parses a comma-separated list of pass names ("toutes", "aucune" are
+   accepted too); returns -1 on an unknown name */
+int dataflow_parse_passes(const char *list, unsigned *passes);
+
+/* runs the passes of the mask on the program at root */
+void dataflow(int root, unsigned passes);
+void dataflow_print_stats(FILE *file);
+
+#endif
@@ -0,0 +1,118 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "entrees.h"
+
+static void *checked(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+static void add(Entrees *e, const char *path) {
+    if (e->count == e->capacity) {
+        e->capacity = e->capacity ? e->capacity * 2 : 256;
+        e->paths = checked(realloc(e->paths, (size_t)e->capacity * sizeof(char *)));
+    }
+    e->paths[e->count++] = path;
+}
+
+static int compare_names(const void *x, const void *y) {
+    return strcmp(*(char *const *)x, *(char *const *)y);
+}
+
+static int has_suffix(const char *name, const char *suffix) {
+    size_t len = strlen(name), n = strlen(suffix);
+    return len > n && strcmp(name + len - n, suffix) == 0;
+}
+
+static int add_directory(Entrees *e, const char *path, const char *suffix) {
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        perror(path);
+        return -1;
+    }
+    char **names = NULL;
+    int count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (suffix != NULL ? !has_suffix(entry->d_name, suffix) : entry->d_name[0] == '.') continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            names = checked(realloc(names, (size_t)capacity * sizeof(char *)));
+        }
+        char *name = checked(malloc(strlen(path) + strlen(entry->d_name) + 2));
+        sprintf(name, "%s/%s", path, entry->d_name);
+        names[count++] = name;
+    }
+    closedir(dir);
+    qsort(names, (size_t)count, sizeof(char *), compare_names);
+    for (int i = 0; i < count; ++i) add(e, names[i]);
+    free(names);
+    return 0;
+}
+
+int entrees_add_path(Entrees *e, const char *path, const char *suffix) {
+    struct stat st;
+    if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) return add_directory(e, path, suffix);
+    add(e, path);
+    return 0;
+}
+
+int entrees_add_list(Entrees *e, const char *filename) {
+    FILE *file = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    if (file == NULL) {
+        perror(filename);
+        return -1;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len == 0) continue;
+        add(e, checked(strdup(line)));
+    }
+    if (file != stdin) fclose(file);
+    return 0;
+}
+
+typedef struct {
+    const char *base;   /* name without directory */
+    int len;            /* without suffix */
+    int j;
+} Nom;
+
+static int compare_noms(const void *x, const void *y) {
+    const Nom *a = x, *b = y;
+    int c = strncmp(a->base, b->base, (size_t)(a->len < b->len ? a->len : b->len));
+    if (c != 0) return c;
+    if (a->len != b->len) return a->len < b->len ? -1 : 1;
+    return a->j - b->j;
+}
+
+int entrees_uniques(const Entrees *e, const char *suffix) {
+    Nom *noms = checked(malloc((size_t)(e->count ? e->count : 1) * sizeof(Nom)));
+    for (int j = 0; j < e->count; ++j) {
+        const char *base = strrchr(e->paths[j], '/');
+        base = base ? base + 1 : e->paths[j];
+        size_t len = strlen(base);
+        if (suffix != NULL && has_suffix(base, suffix)) len -= strlen(suffix);
+        noms[j] = (Nom){ base, (int)len, j };
+    }
+    qsort(noms, (size_t)e->count, sizeof(Nom), compare_noms);
+    int status = 0;
+    for (int i = 1; i < e->count && status == 0; ++i) {
+        if (noms[i].len == noms[i - 1].len && strncmp(noms[i].base, noms[i - 1].base, (size_t)noms[i].len) == 0) {
+            fprintf(stderr, "%s and %s have the same name, so would have the same outputs\n",
+                    e->paths[noms[i - 1].j], e->paths[noms[i].j]);
+            status = -1;
+        }
+    }
+    free(noms);
+    return status;
+}
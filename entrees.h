@@ -0,0 +1,31 @@
+#ifndef ENTREES_H
+#define ENTREES_H
+
+/*
+ * Input files of the batch tools (lot.c, executions.c), in the order of
+ * the command line: a file stands for itself, a directory for the files
+ * in it in name order, a list (-l) for the paths on its lines. Out of
+ * memory is reported on stderr and ends the process, as in the tools.
+ */
+
+typedef struct {
+    const char **paths;
+    int count;
+    int capacity;
+} Entrees;
+
+/* a file, or the files of a directory: those whose name ends with
+   suffix, or every one not hidden when suffix is NULL. -1 on a directory
+   that cannot be read, reported on stderr */
+int entrees_add_path(Entrees *e, const char *path, const char *suffix);
+
+/* the paths of a list file, one per line, blank lines skipped; "-" reads
+   stdin. -1 when it cannot be opened, reported on stderr */
+int entrees_add_list(Entrees *e, const char *filename);
+
+/* 0 when no two inputs have the same name once their directory and
+   suffix (if any) are removed, that is when the outputs named after them
+   are all distinct; -1 otherwise, with one such pair on stderr */
+int entrees_uniques(const Entrees *e, const char *suffix);
+
+#endif
@@ -0,0 +1,24 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "erreur.h"
+
+_Thread_local ErreurCible *erreur_cible = NULL;
+
+void erreur(const char *format, ...) {
+    va_list args;
+    ErreurCible *cible = erreur_cible;
+
+    va_start(args, format);
+    if (cible == NULL) {
+        vfprintf(stderr, format, args);
+        fputc('\n', stderr);
+        va_end(args);
+        exit(1);
+    }
+    vsnprintf(cible->message, cible->size, format, args);
+    va_end(args);
+    erreur_cible = NULL;
+    longjmp(cible->retour, 1);
+}
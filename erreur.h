@@ -0,0 +1,32 @@
+#ifndef ERREUR_H
+#define ERREUR_H
+
+#include <setjmp.h>
+#include <stddef.h>
+
+/*
+ * Compile errors. A module that cannot go on calls erreur(), which never
+ * returns: the formatted message goes to the target the calling thread
+ * installed in erreur_cible and control comes back there through
+ * longjmp, so one bad program does not end a batch. With no target, the
+ * message is printed on stderr and the process exits with status 1, as
+ * every tool did before.
+ */
+typedef struct {
+    jmp_buf retour;
+    char *message;      /* the message, without a final newline */
+    size_t size;
+} ErreurCible;
+
+extern _Thread_local ErreurCible *erreur_cible;
+
+/* usage (setjmp() must be the whole condition):
+       ErreurCible cible = { .message = buffer, .size = sizeof(buffer) };
+       erreur_cible = &cible;
+       if (setjmp(cible.retour) != 0) { ... cible.message ... }
+       ...
+       erreur_cible = NULL;
+   erreur() clears the target before it jumps */
+_Noreturn void erreur(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#endif
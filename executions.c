@@ -0,0 +1,222 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "entrees.h"
+#include "module.h"
+#include "pool.h"
+#include "vm.h"
+
+/* Runs one compiled program over many inputs at once.
+   Usage: executions [-j N] [-f carburant] [-o sortie] [-l liste] programme
+                     (entree | repertoire)...
+   programme is a pile_code.txt listing or a compiled module (.mod, see
+   module.h), loaded once and shared read-only by the worker threads of a
+   work-stealing pool (pool.h); each worker has its own variables and
+   operand stack. Every input file feeds Lire for one run of the
+   program, and what Ecrire prints goes to sortie/<entree>.sortie, so two
+   inputs may not have the same name. A directory stands for the files
+   in it, -l for the file names in liste, one per line. With -f, a run
+   is stopped once it ran about carburant instructions (see Vm.fuel), so
+   that a loop that never ends only costs its budget. The summary, one
+   line per input in input order with its instruction count, goes to
+   stdout and to sortie/resume.txt.
+   Exit status 1 if a run did not end with Halte. */
+
+typedef struct {
+    const char *entree;
+    int status;             /* VmStatus, or -1 when a file cannot be opened */
+    int pc;
+    uint64_t executed;
+    double seconds;
+    char erreur[256];
+} Run;
+
+static Entrees entrees;
+static Run *runs = NULL;
+static int run_count = 0;
+static const VmProgram *program = NULL;
+static Vm *vms = NULL;              /* one per worker */
+static PoolStats *stats = NULL;
+static int nworkers = 1;
+static uint64_t fuel = 0;
+static const char *sortie = "sortie";
+
+static void execute_run(void *data, int w, int j) {
+    Run *run = &runs[j];
+    Vm *vm = &vms[w];
+    char filename[4096];
+
+    (void)data;
+    const char *base = strrchr(run->entree, '/');
+    snprintf(filename, sizeof(filename), "%s/%s.sortie", sortie, base ? base + 1 : run->entree);
+    FILE *in = fopen(run->entree, "r");
+    FILE *out = in != NULL ? fopen(filename, "w") : NULL;
+    if (out == NULL) {
+        snprintf(run->erreur, sizeof(run->erreur), "%s: %s", in == NULL ? "entree" : "sortie", strerror(errno));
+        run->status = -1;
+        if (in != NULL) fclose(in);
+        return;
+    }
+
+    double t0 = pool_now();
+    vm_reset(vm, in, out);
+    vm->fuel = fuel;
+    run->status = vm_run(vm);
+    run->seconds = pool_now() - t0;
+    run->pc = vm->pc;
+    run->executed = vm->executed;
+    fclose(in);
+    if (fclose(out) != 0 && run->status == VM_OK) {
+        snprintf(run->erreur, sizeof(run->erreur), "sortie: %s", strerror(errno));
+        run->status = -1;
+    }
+}
+
+static void write_summary(FILE *file, double seconds) {
+    int failed = 0, stopped = 0;
+    unsigned long long executed = 0;
+
+    for (int j = 0; j < run_count; ++j) {
+        const Run *run = &runs[j];
+        if (run->status == VM_OK) {
+            fprintf(file, "%s: ok, %llu instructions, %.3f ms\n",
+                    run->entree, (unsigned long long)run->executed, run->seconds * 1e3);
+        } else if (run->status > 0) {
+            fprintf(file, "%s: arret a l'instruction %d : %s, %llu instructions, %.3f ms\n",
+                    run->entree, run->pc, vm_status_message((VmStatus)run->status),
+                    (unsigned long long)run->executed, run->seconds * 1e3);
+        } else {
+            fprintf(file, "%s: erreur: %s\n", run->entree, run->erreur);
+        }
+        executed += run->executed;
+        failed += run->status != VM_OK;
+        stopped += run->status == VM_ERR_FUEL;
+    }
+    fprintf(file, "\n%d entrees, %d terminees, %d sans carburant, %d en erreur\n",
+            run_count, run_count - failed, stopped, failed - stopped);
+    fprintf(file, "instructions %llu\n", executed);
+    fprintf(file, "%d threads, %.3f s (%.0f executions/s, %.1f M instructions/s)\n", nworkers, seconds,
+            seconds > 0 ? run_count / seconds : 0.0, seconds > 0 ? executed / seconds / 1e6 : 0.0);
+    for (int w = 0; w < nworkers; ++w)
+        fprintf(file, "  thread %d: %d executions, %d vols, %.3f s d'execution\n",
+                w, stats[w].done, stats[w].steals, stats[w].busy);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j N] [-f carburant] [-o sortie] [-l liste] programme (entree | repertoire)...\n",
+            prog);
+    fprintf(stderr, "  programme    pile_code.txt listing or compiled module (.mod)\n");
+    fprintf(stderr, "  -j N         N threads (default: one per processor)\n");
+    fprintf(stderr, "  -f carburant stop a run after about this many instructions (default: no limit)\n");
+    fprintf(stderr, "  -o sortie    directory of the outputs and resume.txt (default: sortie)\n");
+    fprintf(stderr, "  -l liste     also run the input files named in liste, one per line (- = stdin)\n");
+    fprintf(stderr, "  repertoire   stands for the files it contains\n");
+}
+
+int main(int argc, char **argv) {
+    const char *programme = NULL;
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    nworkers = processors > 0 ? (int)processors : 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nworkers = atoi(argv[++i]);
+            if (nworkers < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+            char *end;
+            const char *text = argv[++i];
+            errno = 0;
+            fuel = strtoull(text, &end, 10);
+            if (text[0] < '0' || text[0] > '9' || *end != '\0' || errno != 0) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            sortie = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if (entrees_add_list(&entrees, argv[++i]) != 0) return 1;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else if (programme == NULL) {
+            programme = argv[i];
+        } else if (entrees_add_path(&entrees, argv[i], NULL) != 0) {
+            return 1;
+        }
+    }
+    if (programme == NULL || entrees.count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (entrees_uniques(&entrees, NULL) != 0) return 1;
+    run_count = entrees.count;
+    runs = calloc((size_t)run_count, sizeof(Run));
+    if (runs == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int j = 0; j < run_count; ++j) runs[j].entree = entrees.paths[j];
+    if (mkdir(sortie, 0777) != 0 && errno != EEXIST) {
+        perror(sortie);
+        return 1;
+    }
+    if (nworkers > run_count) nworkers = run_count;
+
+    /* a module runs where it is mapped, a listing once loaded */
+    size_t len = strlen(programme);
+    VmProgram loaded;
+    Module module;
+    int en_place = len > 4 && strcmp(programme + len - 4, ".mod") == 0;
+    if (en_place) {
+        if (module_open(&module, programme) != 0) return 1;
+        program = &module.prog;
+    } else {
+        if (vm_load_file(&loaded, programme) != 0) return 1;
+        program = &loaded;
+    }
+
+    vms = calloc((size_t)nworkers, sizeof(Vm));
+    stats = calloc((size_t)nworkers, sizeof(PoolStats));
+    if (vms == NULL || stats == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int w = 0; w < nworkers; ++w) {
+        if (vm_init(&vms[w], program, NULL, NULL) != 0) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    double t0 = pool_now();
+    if (pool_run(nworkers, run_count, execute_run, NULL, stats) != 0) return 1;
+    double seconds = pool_now() - t0;
+
+    char filename[4096];
+    snprintf(filename, sizeof(filename), "%s/resume.txt", sortie);
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        perror(filename);
+        return 1;
+    }
+    write_summary(file, seconds);
+    fclose(file);
+    write_summary(stdout, seconds);
+
+    for (int w = 0; w < nworkers; ++w) vm_free(&vms[w]);
+    free(vms);
+    free(stats);
+    if (en_place) module_close(&module);
+    else vm_free_program(&loaded);
+    int failed = 0;
+    for (int j = 0; j < run_count; ++j) failed |= runs[j].status != VM_OK;
+    return failed;
+}
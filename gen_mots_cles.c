@@ -0,0 +1,79 @@
+/* Generates mots_cles.h: a collision-free hash of the Pascal keywords.
+   The hash only looks at the first two characters (case-folded) and the
+   length, so lookup costs one table load and at most seven byte compares.
+   Usage: gen_mots_cles > mots_cles.h */
+#include <stdio.h>
+#include <string.h>
+
+static const char *keywords[] = {
+    "program", "begin", "end", "var", "integer", "char", "if", "then", "else",
+    "while", "do", "read", "readln", "write", "writeln"
+};
+static const char *keywordTypes[] = {
+    "PROGRAM", "BEGIN", "END", "VAR", "INTEGER", "CHAR", "IF", "THEN", "ELSE",
+    "WHILE", "DO", "READ", "READLN", "WRITE", "WRITELN"
+};
+#define KEYWORDS_COUNT ((int)(sizeof(keywords) / sizeof(keywords[0])))
+
+static unsigned hash(unsigned a, unsigned b, unsigned c0, unsigned c1, unsigned len, unsigned mask) {
+    return (c0 * a + c1 * b + len) & mask;
+}
+
+int main(void) {
+    unsigned min_len = 255, max_len = 0;
+    for (int i = 0; i < KEYWORDS_COUNT; ++i) {
+        unsigned len = (unsigned)strlen(keywords[i]);
+        if (len < min_len) min_len = len;
+        if (len > max_len) max_len = len;
+    }
+
+    /* smallest power-of-two table first, then the smallest multipliers */
+    for (unsigned size = 16; size <= 256; size *= 2) {
+        for (unsigned a = 1; a < 256; ++a) {
+            for (unsigned b = 1; b < 256; ++b) {
+                int slot[256];
+                int ok = 1;
+                memset(slot, -1, sizeof(slot));
+                for (int i = 0; i < KEYWORDS_COUNT && ok; ++i) {
+                    const char *k = keywords[i];
+                    unsigned h = hash(a, b, (unsigned char)k[0], (unsigned char)k[1], (unsigned)strlen(k), size - 1);
+                    if (slot[h] != -1) ok = 0;
+                    else slot[h] = i;
+                }
+                if (!ok) continue;
+
+                printf("/* Generated by gen_mots_cles.c - do not edit. */\n");
+                printf("#ifndef MOTS_CLES_H\n#define MOTS_CLES_H\n\n");
+                printf("#include \"analyseur_lex.h\"\n\n");
+                printf("#define KEYWORD_MIN_LENGTH %u\n", min_len);
+                printf("#define KEYWORD_MAX_LENGTH %u\n", max_len);
+                printf("#define KEYWORD_HASH(c0, c1, len) (((unsigned)(c0) * %uu + (unsigned)(c1) * %uu + (unsigned)(len)) & %uu)\n\n",
+                       a, b, size - 1);
+                printf("typedef struct {\n    char text[%u];\n    unsigned char length;\n    unsigned char type;\n} KeywordSlot;\n\n",
+                       max_len + 1);
+                printf("static const KeywordSlot keyword_table[%u] = {\n", size);
+                for (unsigned h = 0; h < size; ++h) {
+                    if (slot[h] == -1) continue;
+                    printf("    [%2u] = { \"%s\", %u, %s },\n", h, keywords[slot[h]],
+                           (unsigned)strlen(keywords[slot[h]]), keywordTypes[slot[h]]);
+                }
+                printf("};\n\n");
+                printf("/* Keyword type of an identifier made of letters and digits, compared\n"
+                       "   case-insensitively in place (c | 0x20 folds A-Z and keeps digits). */\n");
+                printf("static inline int keyword_lookup(const char *s, unsigned length, TokenType *type) {\n");
+                printf("    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return 0;\n");
+                printf("    const KeywordSlot *k = &keyword_table[KEYWORD_HASH(s[0] | 0x20, s[1] | 0x20, length)];\n");
+                printf("    if (k->length != length) return 0;\n");
+                printf("    for (unsigned i = 0; i < length; ++i) {\n");
+                printf("        if ((s[i] | 0x20) != k->text[i]) return 0;\n");
+                printf("    }\n");
+                printf("    *type = (TokenType)k->type;\n");
+                printf("    return 1;\n");
+                printf("}\n\n#endif\n");
+                return 0;
+            }
+        }
+    }
+    fprintf(stderr, "no collision-free hash found\n");
+    return 1;
+}
@@ -0,0 +1,1036 @@
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyseur_lex.h"
+#include "erreur.h"
+#include "incremental.h"
+
+/* The text is a treap of chunks in text order, each with the bytes of its
+   subtree: an edit splits it and merges it back around the new bytes. */
+#define CHUNK 1024
+
+typedef struct Chunk {
+    struct Chunk *left, *right;
+    unsigned priority;
+    unsigned length;
+    size_t bytes;               /* of the subtree */
+    char data[CHUNK];
+} Chunk;
+
+typedef struct Statement Statement;
+
+/* statements of a block, a treap in order */
+typedef struct {
+    Statement *children;
+    unsigned first;             /* offset of its first statement, or of its end
+                                   when it has none, from the start of the
+                                   statement it is in (of the text for the
+                                   body of the program) */
+} Block;
+
+/* A statement directly in a block, as a node of the block's treap, with
+   the nodes it is made of but for the statements of its own blocks,
+   which are statements of those blocks. Its span runs from its first
+   byte to the next statement of the block, or to the block's end: the
+   spans of a treap give the offsets of its statements. */
+struct Statement {
+    Statement *left, *right;
+    unsigned priority;
+    int count;                  /* statements of the subtree */
+    size_t bytes;               /* their spans */
+    unsigned span;
+    int node_count, block_count;
+    Block *blocks;
+    AstNode *nodes;             /* in the order of the parse, children as
+                                   indexes into nodes; an N_BLOCK has its
+                                   statements in blocks[a] */
+};
+
+/* offsets of the first and last tokens of a node parsed */
+typedef struct {
+    unsigned start, end;
+} Extent;
+
+/* node of the thread's tree while its statements are moved out */
+typedef struct {
+    int owner;                  /* the statement it belongs to, or -1 */
+    int local;                  /* its index in that statement */
+    int nodes, blocks;          /* of the statement, when it is one */
+    Statement *statement;
+} Slot;
+
+/* block around the edit; index, statement and inner say where the block
+   of the next level is */
+typedef struct {
+    Block *block;
+    size_t start;
+    int index;
+    Statement *statement;
+    int inner;
+} Level;
+
+/* statement being copied into the materialized tree */
+typedef struct {
+    const Statement *statement; /* NULL for the body of the program */
+    int next;                   /* its next node */
+    int map;                    /* in Document.map: where its nodes went */
+    const Block *block;         /* whose statements are copied, or NULL */
+    int kids, kid_count, kid;   /* in Document.stack: those statements */
+    int mark;
+} Copy;
+
+struct Document {
+    Chunk *text;
+    size_t size;
+    unsigned seed;
+
+    /* last parse that succeeded */
+    int has_tree;
+    AstNode *decls;             /* N_DECL nodes, a: offset into names */
+    int decl_count;
+    size_t decl_capacity;
+    int32_t *names;
+    int name_count;
+    size_t name_capacity;
+    size_t begin;               /* offset of the begin of the body */
+    Block body;
+
+    /* bytes start .. old_end - 1 of the text of the tree are now bytes
+       start .. new_end - 1 */
+    int dirty;
+    size_t start, old_end, new_end;
+
+    /* parse in progress */
+    char *window;               /* bytes window_start .. of the text */
+    size_t window_start, window_length, window_capacity;
+    int window_first;           /* first token lexed in it */
+    char **retired;             /* earlier windows of the parse, which the */
+    int retired_count;          /* tokens the parser holds may point into */
+    size_t retired_capacity;
+    size_t lexed;               /* where the next token starts */
+    unsigned *offsets;          /* of the tokens given to the parser */
+    int offset_count;
+    size_t offset_capacity;
+    Extent *extents;            /* by node */
+    size_t extent_capacity;
+    Block *block;               /* whose statements parser_statements() parses */
+    size_t block_start;
+    int sync_index;             /* statement of block the parse stopped at */
+    size_t sync;                /* its offset now */
+    Slot *slots;
+    size_t slot_capacity;
+    Level *levels;
+    int level_count;
+    size_t level_capacity;
+
+    /* scratch of the walks over the statements */
+    Statement **stack;
+    int stack_count;
+    size_t stack_capacity;
+    Copy *copies;
+    int copy_count;
+    size_t copy_capacity;
+    int *map;
+    int map_count;
+    size_t map_capacity;
+    int32_t *pending;
+    int pending_count;
+    size_t pending_capacity;
+
+    /* built on demand */
+    char *flat;
+    size_t flat_capacity;
+    int flat_valid;
+    AstTree tree;
+    size_t node_capacity, list_capacity;
+    int tree_valid;
+
+    DocumentStats stats;
+    char erreur[256];
+};
+
+static void *grow(void *ptr, size_t *capacity, size_t elem, size_t needed) {
+    size_t n = *capacity ? *capacity : 1024;
+    while (n < needed) n *= 2;
+    void *grown = realloc(ptr, n * elem);
+    if (grown == NULL) {
+        erreur("Out of memory");
+    }
+    *capacity = n;
+    return grown;
+}
+
+static unsigned priority(Document *doc) {
+    doc->seed ^= doc->seed << 13;
+    doc->seed ^= doc->seed >> 17;
+    doc->seed ^= doc->seed << 5;
+    return doc->seed;
+}
+
+/* ---------- text ---------- */
+
+static size_t chunk_bytes(const Chunk *c) {
+    return c != NULL ? c->bytes : 0;
+}
+
+static void chunk_update(Chunk *c) {
+    c->bytes = chunk_bytes(c->left) + c->length + chunk_bytes(c->right);
+}
+
+static Chunk *chunk_new(Document *doc, const char *text, size_t length) {
+    Chunk *c = malloc(sizeof(Chunk));
+    if (c == NULL) {
+        erreur("Out of memory");
+    }
+    c->left = c->right = NULL;
+    c->priority = priority(doc);
+    c->length = (unsigned)length;
+    c->bytes = length;
+    memcpy(c->data, text, length);
+    return c;
+}
+
+static void chunk_free(Chunk *c) {
+    while (c != NULL) {
+        Chunk *right = c->right;
+        chunk_free(c->left);
+        free(c);
+        c = right;
+    }
+}
+
+static Chunk *chunk_merge(Chunk *a, Chunk *b) {
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (a->priority > b->priority) {
+        a->right = chunk_merge(a->right, b);
+        chunk_update(a);
+        return a;
+    }
+    b->left = chunk_merge(a, b->left);
+    chunk_update(b);
+    return b;
+}
+
+/* the bytes before offset into *l, the others into *r */
+static void chunk_split(Document *doc, Chunk *c, size_t offset, Chunk **l, Chunk **r) {
+    if (c == NULL) {
+        *l = *r = NULL;
+        return;
+    }
+    size_t left = chunk_bytes(c->left);
+    if (offset <= left) {
+        chunk_split(doc, c->left, offset, l, &c->left);
+        *r = c;
+    } else if (offset >= left + c->length) {
+        chunk_split(doc, c->right, offset - left - c->length, &c->right, r);
+        *l = c;
+    } else {
+        size_t k = offset - left;
+        *r = chunk_merge(chunk_new(doc, c->data + k, c->length - k), c->right);
+        c->length = (unsigned)k;
+        c->right = NULL;
+        *l = c;
+    }
+    chunk_update(c);
+}
+
+/* copies what fits of text into the last chunk of c */
+static size_t chunk_fill(Chunk *c, const char *text, size_t length) {
+    if (c == NULL) return 0;
+    size_t n;
+    if (c->right != NULL) {
+        n = chunk_fill(c->right, text, length);
+    } else {
+        n = CHUNK - c->length < length ? CHUNK - c->length : length;
+        memcpy(c->data + c->length, text, n);
+        c->length += (unsigned)n;
+    }
+    c->bytes += n;
+    return n;
+}
+
+static Chunk *chunk_append(Document *doc, Chunk *c, const char *text, size_t length) {
+    size_t n = chunk_fill(c, text, length);
+    for (text += n, length -= n; length > 0; text += n, length -= n) {
+        n = length < CHUNK ? length : CHUNK;
+        c = chunk_merge(c, chunk_new(doc, text, n));
+    }
+    return c;
+}
+
+static void chunk_read(const Chunk *c, size_t offset, size_t length, char *out) {
+    while (c != NULL && length > 0) {
+        size_t left = chunk_bytes(c->left), n;
+        if (offset < left) {
+            n = left - offset < length ? left - offset : length;
+            chunk_read(c->left, offset, n, out);
+            out += n;
+            length -= n;
+            offset = left;
+        }
+        size_t k = offset - left;
+        if (k < c->length && length > 0) {
+            n = c->length - k < length ? c->length - k : length;
+            memcpy(out, c->data + k, n);
+            out += n;
+            length -= n;
+            k += n;
+        }
+        offset = k - c->length;
+        c = c->right;
+    }
+}
+
+static void text_replace(Document *doc, size_t offset, size_t removed, const char *text, size_t length) {
+    Chunk *before, *rest, *gone, *after;
+    chunk_split(doc, doc->text, offset, &before, &rest);
+    chunk_split(doc, rest, removed, &gone, &after);
+    chunk_free(gone);
+    doc->text = chunk_merge(chunk_append(doc, before, text, length), after);
+    doc->size = doc->size - removed + length;
+}
+
+/* ---------- statements ---------- */
+
+static int statement_count(const Statement *s) {
+    return s != NULL ? s->count : 0;
+}
+
+static size_t statement_bytes(const Statement *s) {
+    return s != NULL ? s->bytes : 0;
+}
+
+static void statement_update(Statement *s) {
+    s->count = statement_count(s->left) + 1 + statement_count(s->right);
+    s->bytes = statement_bytes(s->left) + s->span + statement_bytes(s->right);
+}
+
+static Statement *statement_merge(Statement *a, Statement *b) {
+    if (a == NULL) return b;
+    if (b == NULL) return a;
+    if (a->priority > b->priority) {
+        a->right = statement_merge(a->right, b);
+        statement_update(a);
+        return a;
+    }
+    b->left = statement_merge(a, b->left);
+    statement_update(b);
+    return b;
+}
+
+/* the first k statements into *l, the others into *r */
+static void statement_split(Statement *s, int k, Statement **l, Statement **r) {
+    if (s == NULL) {
+        *l = *r = NULL;
+        return;
+    }
+    if (k <= statement_count(s->left)) {
+        statement_split(s->left, k, l, &s->left);
+        *r = s;
+    } else {
+        statement_split(s->right, k - statement_count(s->left) - 1, &s->right, r);
+        *l = s;
+    }
+    statement_update(s);
+}
+
+/* the statement whose span holds offset (from the first statement), its
+   index in *index and its offset in *start; NULL past the last one */
+static Statement *statement_find(Statement *s, size_t offset, int *index, size_t *start) {
+    int before = 0;
+    size_t at = 0;
+    while (s != NULL) {
+        size_t left = statement_bytes(s->left);
+        if (offset < left) {
+            s = s->left;
+        } else if (offset < left + s->span) {
+            *index = before + statement_count(s->left);
+            *start = at + left;
+            return s;
+        } else {
+            before += statement_count(s->left) + 1;
+            at += left + s->span;
+            offset -= left + s->span;
+            s = s->right;
+        }
+    }
+    return NULL;
+}
+
+/* the statement of block holding offset, or its last one when offset is
+   at its end; NULL when it is empty */
+static Statement *statement_at(const Block *block, size_t offset, int *index, size_t *start) {
+    size_t bytes = statement_bytes(block->children);
+    if (bytes == 0) return NULL;
+    return statement_find(block->children, offset < bytes ? offset : bytes - 1, index, start);
+}
+
+/* adds delta (two's complement) to the span of statement k */
+static void statement_resize(Statement *s, int k, size_t delta) {
+    while (s != NULL) {
+        int left = statement_count(s->left);
+        s->bytes += delta;
+        if (k == left) {
+            s->span += (unsigned)delta;
+            return;
+        }
+        if (k < left) {
+            s = s->left;
+        } else {
+            k -= left + 1;
+            s = s->right;
+        }
+    }
+}
+
+static void push_statement(Document *doc, Statement *s) {
+    if ((size_t)doc->stack_count == doc->stack_capacity)
+        doc->stack = grow(doc->stack, &doc->stack_capacity, sizeof(Statement *), (size_t)doc->stack_count + 1);
+    doc->stack[doc->stack_count++] = s;
+}
+
+/* frees the statements of a treap and those of their blocks */
+static void statement_free(Document *doc, Statement *s) {
+    int base = doc->stack_count;
+    push_statement(doc, s);
+    while (doc->stack_count > base) {
+        s = doc->stack[--doc->stack_count];
+        if (s == NULL) continue;
+        push_statement(doc, s->left);
+        push_statement(doc, s->right);
+        for (int b = 0; b < s->block_count; ++b) push_statement(doc, s->blocks[b].children);
+        free(s);
+    }
+}
+
+/* pushes the statements of a treap in order */
+static void collect(Document *doc, Statement *s) {
+    for (; s != NULL; s = s->right) {
+        collect(doc, s->left);
+        push_statement(doc, s);
+    }
+}
+
+/* ---------- parse ---------- */
+
+/* structural children of a node (ast_children()), as its fields */
+static int node_children(AstNode *n, int32_t *out[3]) {
+    int k = 0;
+    switch (n->kind) {
+        case N_ASSIGN:
+        case N_SHL: case N_SHR:
+            out[k++] = &n->a;
+            break;
+        case N_IF:
+        case N_WHILE:
+            out[k++] = &n->a;
+            out[k++] = &n->b;
+            if (n->c >= 0) out[k++] = &n->c;
+            break;
+        case N_ADD: case N_SUB: case N_MUL: case N_DIV: case N_MOD: case N_COMPARE:
+            out[k++] = &n->a;
+            out[k++] = &n->b;
+            break;
+        default:
+            break;
+    }
+    return k;
+}
+
+#define WINDOW 65536
+
+/* ParseHooks.next: lexes from a window of the text, moved on, or made
+   larger, when a token may go on past it */
+static void hook_next(void *data, Token *token) {
+    Document *doc = data;
+    for (;;) {
+        Source src;
+        source_from_buffer(&src, doc->window, doc->window_length);
+        src.pos = doc->lexed - doc->window_start;
+        SpanToken span = nextSpanToken(&src);
+        size_t end = doc->window_start + doc->window_length;
+        if (end < doc->size && span.offset + span.length >= doc->window_length) {
+            size_t kept = end - doc->lexed;
+            size_t length = kept < WINDOW / 2 ? WINDOW : 2 * kept;
+            if (length > doc->size - doc->lexed) length = doc->size - doc->lexed;
+            if (doc->offset_count > doc->window_first) {
+                /* Token.text of the tokens lexed in it */
+                if ((size_t)doc->retired_count == doc->retired_capacity)
+                    doc->retired = grow(doc->retired, &doc->retired_capacity, sizeof(char *),
+                                        (size_t)doc->retired_count + 1);
+                doc->retired[doc->retired_count++] = doc->window;
+                doc->window = NULL;
+                doc->window_capacity = 0;
+            }
+            if (length > doc->window_capacity) doc->window = grow(doc->window, &doc->window_capacity, 1, length);
+            chunk_read(doc->text, doc->lexed, length, doc->window);
+            doc->window_start = doc->lexed;
+            doc->window_length = length;
+            doc->window_first = doc->offset_count;
+            continue;
+        }
+        spanTokenToToken(&src, span, token);
+        token->offset += (unsigned)doc->window_start;
+        doc->lexed = doc->window_start + src.pos;
+        if ((size_t)doc->offset_count == doc->offset_capacity)
+            doc->offsets = grow(doc->offsets, &doc->offset_capacity, sizeof(unsigned), (size_t)doc->offset_count + 1);
+        doc->offsets[doc->offset_count++] = token->offset;
+        doc->stats.relexed++;
+        return;
+    }
+}
+
+/* ParseHooks.parsed */
+static void hook_parsed(void *data, int start, int end, int root) {
+    Document *doc = data;
+    if ((size_t)root >= doc->extent_capacity)
+        doc->extents = grow(doc->extents, &doc->extent_capacity, sizeof(Extent), (size_t)root + 1);
+    doc->extents[root].start = doc->offsets[start];
+    doc->extents[root].end = doc->offsets[end - 1];
+    doc->stats.parsed++;
+}
+
+/* ParseHooks.boundary: stops at a statement past the edit that starts
+   where one of the block started before it */
+static int hook_boundary(void *data, int start) {
+    Document *doc = data;
+    size_t at = doc->offsets[start];
+    int index;
+    size_t old;
+    if (at < doc->new_end) return 0;
+    size_t offset = at - doc->new_end + doc->old_end - doc->block_start;
+    if (statement_find(doc->block->children, offset, &index, &old) == NULL || old != offset) return 0;
+    doc->sync_index = index;
+    doc->sync = at;
+    return 1;
+}
+
+static void release_windows(Document *doc) {
+    while (doc->retired_count > 0) free(doc->retired[--doc->retired_count]);
+}
+
+static void parse_from(Document *doc, size_t offset) {
+    release_windows(doc);
+    doc->lexed = doc->window_start = offset;
+    doc->window_length = 0;
+    doc->window_first = 0;
+    doc->offset_count = 0;
+}
+
+/* treap of the statements roots moved out, the last one ending at end */
+static Statement *make_children(Document *doc, const int32_t *roots, int n, size_t end) {
+    Statement *children = NULL;
+    for (int k = 0; k < n; ++k) {
+        Statement *s = doc->slots[roots[k]].statement;
+        size_t next = k + 1 < n ? doc->extents[roots[k + 1]].start : end;
+        s->span = (unsigned)(next - doc->extents[roots[k]].start);
+        statement_update(s);
+        children = statement_merge(children, s);
+    }
+    return children;
+}
+
+/* Moves the statements roots[0 .. n - 1] of the thread's tree, and those
+   of their blocks, out of it: a node belongs to the statement of its
+   parent, unless it is a statement of a block. One pass from the root
+   (parents come after their children) finds the statements, the next
+   ones copy their nodes in order. */
+static void move_statements(Document *doc, const int32_t *roots, int n) {
+    if ((size_t)ast_count > doc->slot_capacity)
+        doc->slots = grow(doc->slots, &doc->slot_capacity, sizeof(Slot), (size_t)ast_count);
+    Slot *slot = doc->slots;
+    int32_t *kids[3];
+
+    for (int i = 0; i < ast_count; ++i) {
+        slot[i].owner = -1;
+        slot[i].nodes = slot[i].blocks = 0;
+    }
+    for (int k = 0; k < n; ++k) slot[roots[k]].owner = roots[k];
+    for (int i = ast_count; i-- > 0; ) {
+        AstNode *node = &ast_nodes[i];
+        if (slot[i].owner < 0) continue;
+        for (int k = node_children(node, kids); k-- > 0; ) slot[*kids[k]].owner = slot[i].owner;
+        if (node->kind == N_BLOCK) {
+            for (int k = 0; k < node->value; ++k) slot[ast_lists[node->a + k]].owner = ast_lists[node->a + k];
+        }
+    }
+    for (int i = 0; i < ast_count; ++i) {
+        Slot *owner = slot[i].owner >= 0 ? &slot[slot[i].owner] : NULL;
+        if (owner == NULL) continue;
+        slot[i].local = owner->nodes++;
+        if (ast_nodes[i].kind == N_BLOCK) owner->blocks++;
+    }
+    for (int i = 0; i < ast_count; ++i) {
+        if (slot[i].owner != i) continue;
+        Statement *s = malloc(sizeof(Statement) + (size_t)slot[i].blocks * sizeof(Block) +
+                              (size_t)slot[i].nodes * sizeof(AstNode));
+        if (s == NULL) {
+            erreur("Out of memory");
+        }
+        s->left = s->right = NULL;
+        s->priority = priority(doc);
+        s->node_count = s->block_count = 0;
+        s->blocks = (Block *)(s + 1);
+        s->nodes = (AstNode *)(s->blocks + slot[i].blocks);
+        slot[i].statement = s;
+    }
+    for (int i = 0; i < ast_count; ++i) {
+        if (slot[i].owner < 0) continue;
+        Statement *s = slot[slot[i].owner].statement;
+        AstNode node = ast_nodes[i];
+        for (int k = node_children(&node, kids); k-- > 0; ) *kids[k] = slot[*kids[k]].local;
+        if (node.kind == N_BLOCK) {
+            Block *block = &s->blocks[s->block_count];
+            unsigned end = doc->extents[i].end;
+            block->children = make_children(doc, ast_lists + node.a, node.value, end);
+            block->first = (node.value > 0 ? doc->extents[ast_lists[node.a]].start : end) -
+                           doc->extents[slot[i].owner].start;
+            node.a = s->block_count++;
+        }
+        s->nodes[s->node_count++] = node;
+    }
+}
+
+/* the N_DECL nodes of the thread's tree, with their names */
+static void keep_header(Document *doc, int decls, int ndecl) {
+    doc->decl_count = doc->name_count = 0;
+    for (int k = 0; k < ndecl; ++k) {
+        AstNode decl = ast_nodes[ast_lists[decls + k]];
+        if ((size_t)doc->decl_count == doc->decl_capacity)
+            doc->decls = grow(doc->decls, &doc->decl_capacity, sizeof(AstNode), (size_t)doc->decl_count + 1);
+        if ((size_t)(doc->name_count + decl.value) > doc->name_capacity)
+            doc->names = grow(doc->names, &doc->name_capacity, sizeof(int32_t), (size_t)(doc->name_count + decl.value));
+        memcpy(doc->names + doc->name_count, ast_lists + decl.a, (size_t)decl.value * sizeof(int32_t));
+        decl.a = doc->name_count;
+        doc->name_count += decl.value;
+        doc->decls[doc->decl_count++] = decl;
+    }
+}
+
+static int parse_all(Document *doc) {
+    ParseHooks hooks = { hook_next, hook_parsed, NULL, doc };
+
+    doc->stats.full = 1;
+    parse_from(doc, 0);
+    int root = parser_hooks(&hooks);
+    int body = ast_nodes[root].b;
+    const AstNode *block = &ast_nodes[body];
+    move_statements(doc, ast_lists + block->a, block->value);
+
+    keep_header(doc, ast_nodes[root].a, ast_nodes[root].value);
+    statement_free(doc, doc->body.children);
+    doc->body.children = make_children(doc, ast_lists + block->a, block->value, doc->extents[body].end);
+    doc->body.first = block->value > 0 ? doc->extents[ast_lists[block->a]].start : doc->extents[body].end;
+    doc->begin = doc->extents[body].start;
+    doc->has_tree = 1;
+    ast_free();
+    return 0;
+}
+
+/* the edit is in the declarations: they are parsed again, and the body
+   kept if it still starts at the same token, with every name it may use
+   still declared */
+static int reparse_header(Document *doc) {
+    ParseHooks hooks = { hook_next, hook_parsed, NULL, doc };
+    size_t begin = doc->begin - doc->old_end + doc->new_end;
+
+    parse_from(doc, 0);
+    int32_t ndecl;
+    int decls = parser_header(&hooks, &ndecl);
+    if (currentToken.offset != begin) {
+        ast_free();
+        return 1;
+    }
+    int32_t last = 0;
+    for (int k = 0; k < doc->name_count; ++k) {
+        if (doc->names[k] > last) last = doc->names[k];
+    }
+    unsigned char *declared = calloc((size_t)last + 1, 1);
+    if (declared == NULL) {
+        erreur("Out of memory");
+    }
+    for (int k = 0; k < ndecl; ++k) {
+        const AstNode *decl = &ast_nodes[ast_lists[decls + k]];
+        for (int j = 0; j < decl->value; ++j) {
+            if (ast_lists[decl->a + j] <= last) declared[ast_lists[decl->a + j]] = 1;
+        }
+    }
+    int kept = 1;
+    for (int k = 0; k < doc->name_count; ++k) kept &= declared[doc->names[k]];
+    free(declared);
+    if (!kept) {
+        ast_free();
+        return 1;
+    }
+
+    keep_header(doc, decls, ndecl);
+    doc->body.first = (unsigned)(doc->body.first - doc->begin + begin);
+    doc->begin = begin;
+    ast_free();
+    return 0;
+}
+
+/* reparses the statements of levels[l].block from the one the edit
+   starts in until one that starts where one did before the edit, past
+   it, or until the end of the block if it is where it was; 1 when
+   neither comes */
+static int reparse_level(Document *doc, int l) {
+    ParseHooks hooks = { hook_next, hook_parsed, hook_boundary, doc };
+    Level *level = &doc->levels[l];
+    Block *block = level->block;
+    size_t delta = doc->new_end - doc->old_end;     /* two's complement */
+    int first = 0, last;
+    size_t from = 0;    /* left as is for an empty block */
+
+    statement_at(block, doc->start - level->start, &first, &from);
+    from += level->start;
+    doc->block = block;
+    doc->block_start = level->start;
+    doc->sync_index = -1;
+    parse_from(doc, from);
+    int32_t count;
+    int list = parser_statements(&hooks, doc->names, doc->name_count, &count);
+    if (doc->sync_index >= 0) {
+        last = doc->sync_index;
+    } else if (currentToken.type == END &&
+               currentToken.offset == level->start + statement_bytes(block->children) + delta) {
+        last = statement_count(block->children);
+        doc->sync = currentToken.offset;
+    } else {
+        ast_free();
+        return 1;
+    }
+    move_statements(doc, ast_lists + list, count);
+
+    Statement *before, *rest, *old, *after;
+    statement_split(block->children, first, &before, &rest);
+    statement_split(rest, last - first, &old, &after);
+    before = statement_merge(before, make_children(doc, ast_lists + list, count, doc->sync));
+    block->children = statement_merge(before, after);
+    statement_free(doc, old);
+    /* when the edit starts the text at from, the first statement may now
+       start further on: the bytes before it go to the statement before,
+       or before the first one */
+    size_t gap = (count > 0 ? doc->extents[ast_lists[list]].start : doc->sync) - from;
+    if (gap > 0 && first > 0) statement_resize(block->children, first - 1, gap);
+    else if (gap > 0) block->first += (unsigned)gap;
+
+    /* the blocks around it grow by delta, and those after it in the same
+       statements move */
+    while (l-- > 0) {
+        level = &doc->levels[l];
+        for (int b = level->inner + 1; b < level->statement->block_count; ++b)
+            level->statement->blocks[b].first += (unsigned)delta;
+        statement_resize(level->block->children, level->index, delta);
+    }
+    ast_free();
+    return 0;
+}
+
+/* the edit is in the body: it is reparsed from the deepest block around
+   the edit, then from the blocks around that one, until a parse ends
+   where the old tree has the same text */
+static int reparse_body(Document *doc) {
+    Block *block = &doc->body;
+    size_t start = doc->body.first;
+
+    doc->level_count = 0;
+    for (;;) {
+        if ((size_t)doc->level_count == doc->level_capacity)
+            doc->levels = grow(doc->levels, &doc->level_capacity, sizeof(Level), (size_t)doc->level_count + 1);
+        Level *level = &doc->levels[doc->level_count++];
+        level->block = block;
+        level->start = start;
+
+        int index, b;
+        size_t at;
+        Statement *s = statement_at(block, doc->start - start, &index, &at);
+        if (s == NULL) return 1;
+        at += start;
+        for (b = 0; b < s->block_count; ++b) {
+            size_t first = at + s->blocks[b].first;
+            if (s->blocks[b].children != NULL && doc->start >= first &&
+                doc->old_end <= first + statement_bytes(s->blocks[b].children)) break;
+        }
+        if (b == s->block_count) break;
+        level->index = index;
+        level->statement = s;
+        level->inner = b;
+        block = &s->blocks[b];
+        start = at + block->first;
+    }
+    for (int l = doc->level_count; l-- > 0; ) {
+        if (reparse_level(doc, l) == 0) return 0;
+    }
+    return 1;
+}
+
+/* reparses the edit in the old tree, 1 when the whole text must be
+   parsed instead. Kept out of reparse so that its locals are not in the
+   frame of the setjmp there. */
+__attribute__((noinline)) static int reparse_tree(Document *doc) {
+    if (doc->has_tree && doc->old_end <= doc->begin)
+        return reparse_header(doc);
+    if (doc->has_tree && doc->start >= doc->body.first &&
+        doc->old_end <= doc->body.first + statement_bytes(doc->body.children))
+        return reparse_body(doc);
+    return 1;
+}
+
+static int reparse(Document *doc) {
+    ErreurCible cible = { .message = doc->erreur, .size = sizeof(doc->erreur) };
+
+    doc->erreur[0] = '\0';
+    memset(&doc->stats, 0, sizeof(doc->stats));
+    erreur_cible = &cible;
+    if (setjmp(cible.retour) != 0) {
+        ast_free();
+        release_windows(doc);
+        return -1;
+    }
+    if (reparse_tree(doc) != 0) parse_all(doc);
+    release_windows(doc);
+    erreur_cible = NULL;
+    doc->dirty = 0;
+    return 0;
+}
+
+/* ---------- tree ---------- */
+
+static int emit_node(Document *doc, AstNode node) {
+    AstTree *tree = &doc->tree;
+    if ((size_t)tree->count == doc->node_capacity)
+        tree->nodes = grow(tree->nodes, &doc->node_capacity, sizeof(AstNode), (size_t)tree->count + 1);
+    tree->nodes[tree->count] = node;
+    return tree->count++;
+}
+
+static void emit_push(Document *doc, int32_t item) {
+    if ((size_t)doc->pending_count == doc->pending_capacity)
+        doc->pending = grow(doc->pending, &doc->pending_capacity, sizeof(int32_t), (size_t)doc->pending_count + 1);
+    doc->pending[doc->pending_count++] = item;
+}
+
+/* as ast_list_close() */
+static int emit_close(Document *doc, int mark, int32_t *length) {
+    AstTree *tree = &doc->tree;
+    int n = doc->pending_count - mark;
+    if ((size_t)(tree->list_count + n) > doc->list_capacity)
+        tree->lists = grow(tree->lists, &doc->list_capacity, sizeof(int32_t), (size_t)(tree->list_count + n));
+    memcpy(tree->lists + tree->list_count, doc->pending + mark, (size_t)n * sizeof(int32_t));
+    doc->pending_count = mark;
+    tree->list_count += n;
+    *length = n;
+    return tree->list_count - n;
+}
+
+static void push_copy(Document *doc, const Statement *s) {
+    if ((size_t)doc->copy_count == doc->copy_capacity)
+        doc->copies = grow(doc->copies, &doc->copy_capacity, sizeof(Copy), (size_t)doc->copy_count + 1);
+    int nodes = s != NULL ? s->node_count : 0;
+    if ((size_t)(doc->map_count + nodes) > doc->map_capacity)
+        doc->map = grow(doc->map, &doc->map_capacity, sizeof(int), (size_t)(doc->map_count + nodes));
+    Copy *c = &doc->copies[doc->copy_count++];
+    c->statement = s;
+    c->next = 0;
+    c->map = doc->map_count;
+    c->block = NULL;
+    doc->map_count += nodes;
+}
+
+static void open_block(Document *doc, Copy *c, const Block *block) {
+    c->block = block;
+    c->kids = doc->stack_count;
+    collect(doc, block->children);
+    c->kid_count = doc->stack_count - c->kids;
+    c->kid = 0;
+    c->mark = doc->pending_count;
+}
+
+/* Copies the body of the program into doc->tree, as the parser builds
+   it: the nodes of a statement in order, the statements of a block
+   before the block, each list closed when its block is. The statements
+   waiting for those of their blocks are on a stack, so that deeply
+   nested programs need no C stack. Returns the body. */
+static int emit_body(Document *doc) {
+    int body = -1;
+
+    doc->copy_count = doc->map_count = doc->stack_count = 0;
+    push_copy(doc, NULL);
+    open_block(doc, &doc->copies[0], &doc->body);
+    while (doc->copy_count > 0) {
+        Copy *c = &doc->copies[doc->copy_count - 1];
+        const Statement *s = c->statement;
+        if (c->block != NULL && c->kid < c->kid_count) {
+            push_copy(doc, doc->stack[c->kids + c->kid++]);
+        } else if (c->block != NULL) {
+            int32_t count;
+            int list = emit_close(doc, c->mark, &count);
+            AstNode node = s != NULL ? s->nodes[c->next] : (AstNode){ .kind = N_BLOCK };
+            node.value = count;
+            node.a = list;
+            node.b = node.c = -1;
+            int i = emit_node(doc, node);
+            doc->stack_count = c->kids;
+            c->block = NULL;
+            if (s == NULL) {
+                body = i;
+                doc->copy_count--;
+            } else {
+                doc->map[c->map + c->next++] = i;
+            }
+        } else if (c->next == s->node_count) {
+            int root = doc->map[c->map + c->next - 1];
+            doc->map_count = c->map;
+            doc->copy_count--;
+            emit_push(doc, root);
+        } else if (s->nodes[c->next].kind == N_BLOCK) {
+            open_block(doc, c, &s->blocks[s->nodes[c->next].a]);
+        } else {
+            AstNode node = s->nodes[c->next];
+            int32_t *kids[3];
+            for (int k = node_children(&node, kids); k-- > 0; ) *kids[k] = doc->map[c->map + *kids[k]];
+            doc->map[c->map + c->next++] = emit_node(doc, node);
+        }
+    }
+    return body;
+}
+
+static void materialize(Document *doc) {
+    doc->tree.count = doc->tree.list_count = 0;
+    doc->pending_count = 0;
+    for (int k = 0; k < doc->decl_count; ++k) {
+        AstNode decl = doc->decls[k];
+        int mark = doc->pending_count;
+        for (int j = 0; j < decl.value; ++j) emit_push(doc, doc->names[decl.a + j]);
+        decl.a = emit_close(doc, mark, &decl.value);
+        emit_push(doc, emit_node(doc, decl));
+    }
+    int32_t ndecl;
+    int decls = emit_close(doc, 0, &ndecl);
+    int body = emit_body(doc);
+    emit_node(doc, (AstNode){ .kind = N_PROGRAM, .value = ndecl, .a = decls, .b = body, .c = -1 });
+    doc->tree_valid = 1;
+}
+
+/* ---------- document ---------- */
+
+Document *document_open(const char *text, size_t size) {
+    Document *doc = calloc(1, sizeof(*doc));
+    if (doc == NULL) return NULL;
+    doc->seed = 2463534242u;
+    if (document_edit(doc, 0, 0, text, size) != 0 && doc->size != size) {
+        document_close(doc);
+        return NULL;
+    }
+    return doc;
+}
+
+void document_close(Document *doc) {
+    if (doc == NULL) return;
+    chunk_free(doc->text);
+    statement_free(doc, doc->body.children);
+    free(doc->decls);
+    free(doc->names);
+    free(doc->window);
+    release_windows(doc);
+    free(doc->retired);
+    free(doc->offsets);
+    free(doc->extents);
+    free(doc->slots);
+    free(doc->levels);
+    free(doc->stack);
+    free(doc->copies);
+    free(doc->map);
+    free(doc->pending);
+    free(doc->flat);
+    ast_tree_free(&doc->tree);
+    free(doc);
+}
+
+int document_edit(Document *doc, size_t offset, size_t removed, const char *text, size_t length) {
+    ErreurCible cible = { .message = doc->erreur, .size = sizeof(doc->erreur) };
+
+    if (offset > doc->size || removed > doc->size - offset) {
+        snprintf(doc->erreur, sizeof(doc->erreur), "Edit of %zu bytes at %zu is past the end of the text (%zu bytes)",
+                 removed, offset, doc->size);
+        return -1;
+    }
+    erreur_cible = &cible;
+    if (setjmp(cible.retour) != 0) return -1;
+    text_replace(doc, offset, removed, text, length);
+    erreur_cible = NULL;
+    doc->flat_valid = doc->tree_valid = 0;
+
+    /* the edits since the last parse that succeeded, as one */
+    if (!doc->dirty) {
+        doc->start = offset;
+        doc->old_end = offset + removed;
+        doc->new_end = offset + length;
+        doc->dirty = 1;
+    } else {
+        size_t end = doc->new_end > offset + removed ? doc->new_end : offset + removed;
+        if (offset < doc->start) doc->start = offset;
+        doc->old_end += end - doc->new_end;
+        doc->new_end = end - removed + length;
+    }
+    return reparse(doc);
+}
+
+const char *document_text(Document *doc, size_t *size) {
+    if (!doc->flat_valid) {
+        if (doc->size + 1 > doc->flat_capacity) {
+            char *flat = realloc(doc->flat, doc->size + 1);
+            if (flat == NULL) return NULL;
+            doc->flat = flat;
+            doc->flat_capacity = doc->size + 1;
+        }
+        chunk_read(doc->text, 0, doc->size, doc->flat);
+        doc->flat[doc->size] = '\0';
+        doc->flat_valid = 1;
+    }
+    *size = doc->size;
+    return doc->flat;
+}
+
+const char *document_erreur(const Document *doc) {
+    return doc->erreur;
+}
+
+const DocumentStats *document_stats(const Document *doc) {
+    return &doc->stats;
+}
+
+const AstTree *document_tree(Document *doc) {
+    if (!doc->has_tree) return NULL;
+    if (!doc->tree_valid) {
+        ErreurCible cible = { .message = doc->erreur, .size = sizeof(doc->erreur) };
+        erreur_cible = &cible;
+        if (setjmp(cible.retour) != 0) return NULL;
+        materialize(doc);
+        erreur_cible = NULL;
+    }
+    return &doc->tree;
+}
+
+int document_compile(Document *doc, Compilation *c) {
+    ErreurCible cible = { .message = c->erreur, .size = sizeof(c->erreur) };
+
+    if (!doc->has_tree) {
+        snprintf(c->erreur, sizeof(c->erreur), "%s", doc->erreur);
+        return -1;
+    }
+    erreur_cible = &cible;
+    if (setjmp(cible.retour) != 0) {
+        ast_free();
+        return -1;
+    }
+    if (!doc->tree_valid) materialize(doc);
+    ast_free();
+    int root = ast_copy(&doc->tree, 0, doc->tree.count - 1, 0, doc->tree.list_count);
+    erreur_cible = NULL;
+    return compiler_ast(c, root);
+}
@@ -0,0 +1,71 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+
+#include "analyseur_synt.h"
+#include "ast.h"
+
+/*
+ * Incremental front end, for an editor or a watch mode that recompiles
+ * the same source after each change. A Document keeps the text and the
+ * syntax tree of the last parse that succeeded, both in pieces that an
+ * edit replaces in place:
+ *
+ *   - the text is a balanced tree of chunks of at most a kilobyte;
+ *   - the tree is kept as the statements of each block, a balanced tree
+ *     of them in order, each with its own nodes and the offset of the
+ *     next statement from it, so that an edit moves none of the others.
+ *
+ * document_edit() replaces a range of the text, then lexes and parses
+ * again the statements of the innermost block around the edit, from the
+ * one the edit starts in, until a statement past the edit starts where
+ * one did before it, or until the block ends where it did: the others
+ * are kept. When neither happens, the block around that one is
+ * reparsed the same way, and so on out to the whole program; an edit of
+ * the declarations reparses them alone. An edit thus costs about the
+ * statements and tokens it touches, and a few tree operations
+ * logarithmic in the size of the program.
+ *
+ * document_text() and document_tree() put the pieces together, in one
+ * pass over the whole program, when they are asked for.
+ *
+ * A document belongs to the thread that opened it: its tree holds names
+ * interned in that thread (symtab.h), which compiler() would reset.
+ */
+
+typedef struct Document Document;
+
+typedef struct {
+    int relexed;        /* tokens lexed by the last edit */
+    int parsed;         /* statements parsed */
+    int full;           /* 1 when the whole program was parsed again */
+} DocumentStats;
+
+/* copies text and parses it; NULL when out of memory. A source that does
+   not parse still makes a document, with document_erreur() set. */
+Document *document_open(const char *text, size_t size);
+void document_close(Document *doc);
+
+/* replaces removed bytes at offset by length bytes of text; returns 0, or
+   -1 if the new text does not parse (document_erreur() says why; the
+   tree of the last parse that succeeded is kept, and the next edits
+   reparse what changed since) */
+int document_edit(Document *doc, size_t offset, size_t removed, const char *text, size_t length);
+
+/* the text in one piece, valid until the next edit; NULL when out of
+   memory */
+const char *document_text(Document *doc, size_t *size);
+/* message of the last parse, "" when it succeeded */
+const char *document_erreur(const Document *doc);
+const DocumentStats *document_stats(const Document *doc);
+/* tree of the last parse that succeeded (its root is the last node),
+   valid until the next edit, or NULL if none did (or when out of memory,
+   with document_erreur() set) */
+const AstTree *document_tree(Document *doc);
+
+/* compiles the tree of the last parse that succeeded, as compiler() would
+   compile the text it came from */
+int document_compile(Document *doc, Compilation *c);
+
+#endif
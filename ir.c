@@ -0,0 +1,588 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erreur.h"
+#include "ir.h"
+
+int ir_counts[IR_OPT_COUNT];
+
+static const char *const opt_names[IR_OPT_COUNT] = {
+    [IR_OPT_AFFECTATION] = "affectation",
+    [IR_OPT_BRANCHEMENT] = "branchement",
+    [IR_OPT_MORT] = "mort",
+    [IR_OPT_SAUT] = "saut"
+};
+
+/* ---------- building ---------- */
+
+static IrInstr *built;
+static int *built_origin;
+static int built_count;
+static int built_capacity;
+static int next_reg;            /* next temporary */
+
+static int emit(int op, int d, int a, int b, int pc) {
+    if (built_count == built_capacity) {
+        built_capacity = built_capacity ? built_capacity * 2 : 1024;
+        built = realloc(built, (size_t)built_capacity * sizeof(IrInstr));
+        built_origin = realloc(built_origin, (size_t)built_capacity * sizeof(int));
+        if (built == NULL || built_origin == NULL) {
+            erreur("Code memory overflow");
+        }
+    }
+    built[built_count] = (IrInstr){(uint16_t)op, d, a, b};
+    built_origin[built_count] = pc;
+    return built_count++;
+}
+
+/* a stack entry: a constant, or the register holding the value */
+typedef struct {
+    int is_const;
+    int32_t v;
+} Val;
+
+static Val *stack;
+static int nvars;
+
+static Val reg_val(int r) {
+    return (Val){0, r};
+}
+
+/* the register holding v, loading a constant into a new temporary */
+static int in_reg(Val v, int pc) {
+    if (!v.is_const) return v.v;
+    int t = next_reg++;
+    emit(IR_MOVI, t, 0, v.v, pc);
+    return t;
+}
+
+/* entries 0..height-1 still reading variable x (or any variable when
+   x < 0) get their own copy before it changes */
+static void before_write(int x, int height, int pc) {
+    for (int k = 0; k < height; ++k) {
+        if (stack[k].is_const || stack[k].v >= nvars || (x >= 0 && stack[k].v != x)) continue;
+        int t = next_reg++;
+        emit(IR_MOV, t, stack[k].v, 0, pc);
+        stack[k] = reg_val(t);
+    }
+}
+
+/* at the edges of a block entry k lives in register nvars + k */
+static void materialize_all(int height, int pc) {
+    for (int k = 0; k < height; ++k) {
+        int s = nvars + k;
+        if (stack[k].is_const) emit(IR_MOVI, s, 0, stack[k].v, pc);
+        else if (stack[k].v != s) emit(IR_MOV, s, stack[k].v, 0, pc);
+        stack[k] = reg_val(s);
+    }
+}
+
+/* condition index (order of OP_COMPARER_*) with the operands swapped */
+static const int mirrored[6] = {1, 0, 2, 4, 3, 5};
+
+static int holds(int c, int32_t a, int32_t b) {
+    switch (c) {
+        case 0: return a > b;
+        case 1: return a < b;
+        case 2: return a == b;
+        case 3: return a >= b;
+        case 4: return a <= b;
+        default: return a != b;
+    }
+}
+
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+
+/* translates stack instruction i, the stack being h high */
+static void translate(const Instr *in, int i, int h) {
+    int a = h - 2, b = h - 1;
+    Val x = a >= 0 ? stack[a] : (Val){1, 0};
+    Val y = b >= 0 ? stack[b] : (Val){1, 0};
+    int t;
+
+    switch (in->op) {
+        case OP_VALEURG:
+        case OP_EMPILER:
+            stack[h] = (Val){1, in->arg};
+            break;
+
+        case OP_VALEURD:
+            /* read where it is used; before_write() keeps that safe */
+            stack[h] = reg_val(in->arg);
+            break;
+
+        case OP_AFFECTER:
+            if (x.is_const && (uint32_t)x.v < (uint32_t)nvars) {
+                before_write(x.v, a, i);
+                if (y.is_const) emit(IR_MOVI, x.v, 0, y.v, i);
+                else if (y.v != x.v) emit(IR_MOV, x.v, y.v, 0, i);
+            } else {
+                /* may write any variable; a constant address out of
+                   range fails at run time */
+                before_write(-1, a, i);
+                int ra = in_reg(x, i);
+                emit(IR_STORE, 0, ra, in_reg(y, i), i);
+            }
+            break;
+
+        case OP_ADD:
+        case OP_MUL:
+            if (x.is_const && y.is_const) {
+                uint32_t p = (uint32_t)x.v, q = (uint32_t)y.v;
+                stack[a] = (Val){1, WRAP(in->op == OP_ADD ? p + q : p * q)};
+                break;
+            }
+            if (x.is_const) {
+                Val swap = x;
+                x = y;
+                y = swap;
+            }
+            t = next_reg++;
+            if (y.is_const) emit(in->op == OP_ADD ? IR_ADDI : IR_MULI, t, x.v, y.v, i);
+            else emit(in->op == OP_ADD ? IR_ADD : IR_MUL, t, x.v, y.v, i);
+            stack[a] = reg_val(t);
+            break;
+
+        case OP_SUB:
+            if (x.is_const && y.is_const) {
+                stack[a] = (Val){1, WRAP((uint32_t)x.v - (uint32_t)y.v)};
+                break;
+            }
+            t = next_reg++;
+            if (y.is_const) emit(IR_SUBI, t, x.v, y.v, i);
+            else if (x.is_const) emit(IR_RSUBI, t, y.v, x.v, i);
+            else emit(IR_SUB, t, x.v, y.v, i);
+            stack[a] = reg_val(t);
+            break;
+
+        case OP_DIV:
+        case OP_MOD:
+            if (x.is_const && y.is_const && y.v != 0) {
+                if (in->op == OP_MOD) stack[a] = (Val){1, y.v == -1 ? 0 : x.v % y.v};
+                else stack[a] = (Val){1, y.v == -1 ? WRAP(0u - (uint32_t)x.v) : x.v / y.v};
+                break;
+            }
+            {
+                int rx = in_reg(x, i);
+                t = next_reg++;
+                if (in->op == OP_MOD) emit(y.is_const ? IR_MODI : IR_MOD, t, rx, y.v, i);
+                else emit(y.is_const ? IR_DIVI : IR_DIV, t, rx, y.v, i);
+            }
+            stack[a] = reg_val(t);
+            break;
+
+        case OP_DECALER_GAUCHE:
+            if (y.is_const) {
+                stack[b] = (Val){1, WRAP((uint32_t)y.v << in->arg)};
+                break;
+            }
+            t = next_reg++;
+            emit(IR_SHL, t, y.v, in->arg, i);
+            stack[b] = reg_val(t);
+            break;
+
+        case OP_DECALER_DROITE:
+            if (y.is_const) {
+                stack[b] = (Val){1, WRAP((uint32_t)y.v + ((uint32_t)(y.v >> 31) & ((1u << in->arg) - 1))) >> in->arg};
+                break;
+            }
+            t = next_reg++;
+            emit(IR_SHR, t, y.v, in->arg, i);
+            stack[b] = reg_val(t);
+            break;
+
+        case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+        case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF: {
+            int c = in->op - OP_COMPARER_SUP;
+            if (x.is_const && y.is_const) {
+                stack[a] = (Val){1, holds(c, x.v, y.v)};
+                break;
+            }
+            if (x.is_const) {
+                Val swap = x;
+                x = y;
+                y = swap;
+                c = mirrored[c];
+            }
+            t = next_reg++;
+            emit((y.is_const ? IR_CMPI_SUP : IR_CMP_SUP) + c, t, x.v, y.v, i);
+            stack[a] = reg_val(t);
+            break;
+        }
+
+        case OP_ALLER:
+            materialize_all(h, i);
+            emit(IR_JMP, in->arg, 0, 0, i);
+            break;
+
+        case OP_ALLER_SI_FAUX:
+            materialize_all(h - 1, i);
+            if (!y.is_const) emit(IR_JZ, in->arg, y.v, 0, i);
+            else if (y.v == 0) emit(IR_JMP, in->arg, 0, 0, i);
+            break;
+
+        case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+        case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF: {
+            int c = in->op - OP_ALLER_SI_PAS_SUP;
+            materialize_all(h - 2, i);
+            if (x.is_const && y.is_const) {
+                if (!holds(c, x.v, y.v)) emit(IR_JMP, in->arg, 0, 0, i);
+                break;
+            }
+            if (x.is_const) {
+                Val swap = x;
+                x = y;
+                y = swap;
+                c = mirrored[c];
+            }
+            emit((y.is_const ? IR_JNOTI_SUP : IR_JNOT_SUP) + c, in->arg, x.v, y.v, i);
+            break;
+        }
+
+        case OP_INCR:
+            before_write(in->arg, h, i);
+            emit(IR_ADDI, in->arg, in->arg, in->arg2, i);
+            break;
+
+        case OP_LIRE:
+            t = next_reg++;
+            emit(IR_READ, t, 0, 0, i);
+            stack[h] = reg_val(t);
+            break;
+
+        case OP_ECRIRE:
+            emit(IR_WRITE, 0, in_reg(y, i), 0, i);
+            break;
+
+        case OP_HALTE:
+            emit(IR_HALT, 0, 0, 0, i);
+            break;
+    }
+}
+
+static int is_jump(int op) {
+    return op == IR_JMP || op == IR_JZ || (op >= IR_JNOT_SUP && op <= IR_JNOTI_DIFF);
+}
+
+static int stack_effect(int op) {
+    switch (op) {
+        case OP_VALEURG: case OP_VALEURD: case OP_EMPILER: case OP_LIRE:
+            return 1;
+        case OP_AFFECTER:
+        case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+        case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF:
+            return -2;
+        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+        case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+        case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF:
+        case OP_ALLER_SI_FAUX: case OP_ECRIRE:
+            return -1;
+        default:
+            return 0;
+    }
+}
+
+int ir_build(IrProgram *ir, const VmProgram *prog) {
+    memset(ir, 0, sizeof(*ir));
+    int n = prog->count;
+    int *first = malloc((size_t)(n + 1) * sizeof(int));
+    char *target = calloc((size_t)n + 1, 1);
+    stack = malloc(((size_t)prog->max_stack + 1) * sizeof(Val));
+    if (first == NULL || target == NULL || stack == NULL) {
+        erreur("Code memory overflow");
+    }
+    for (int i = 0; i < n; ++i) {
+        if (opcode_is_jump(prog->code[i].op)) target[prog->code[i].arg] = 1;
+    }
+    nvars = prog->nvars;
+    built = NULL;
+    built_origin = NULL;
+    built_count = built_capacity = 0;
+    next_reg = nvars + prog->max_stack;
+
+    int h = 0, open = 1;        /* open: the previous instruction falls through */
+    for (int i = 0; i <= n; ++i) {
+        int height = prog->height[i];
+        if (open && target[i]) materialize_all(h, i);
+        first[i] = built_count;
+        if (height < 0) {       /* unreachable */
+            open = 0;
+            continue;
+        }
+        if (!open || target[i]) {
+            for (int k = 0; k < height; ++k) stack[k] = reg_val(nvars + k);
+        }
+        translate(&prog->code[i], i, height);
+        h = height + stack_effect(prog->code[i].op);
+        open = prog->code[i].op != OP_ALLER && prog->code[i].op != OP_HALTE;
+    }
+    for (int k = 0; k < built_count; ++k) {
+        if (is_jump(built[k].op)) built[k].d = first[built[k].d];
+    }
+    free(first);
+    free(target);
+    free(stack);
+    stack = NULL;
+
+    ir->code = built;
+    ir->origin = built_origin;
+    ir->count = built_count;
+    ir->nvars = nvars;
+    ir->nslots = prog->max_stack;
+    ir->nregs = next_reg;
+    built = NULL;
+    built_origin = NULL;
+    return 0;
+}
+
+/* ---------- optimization ---------- */
+
+/* registers instruction in reads, in out[]; returns how many */
+static int reads(const IrInstr *in, int out[2]) {
+    switch (in->op) {
+        case IR_NOP: case IR_MOVI: case IR_JMP: case IR_READ: case IR_HALT:
+            return 0;
+        case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD: case IR_STORE:
+        case IR_CMP_SUP: case IR_CMP_INF: case IR_CMP_EGAL:
+        case IR_CMP_SUP_EGAL: case IR_CMP_INF_EGAL: case IR_CMP_DIFF:
+        case IR_JNOT_SUP: case IR_JNOT_INF: case IR_JNOT_EGAL:
+        case IR_JNOT_SUP_EGAL: case IR_JNOT_INF_EGAL: case IR_JNOT_DIFF:
+            out[0] = in->a;
+            out[1] = in->b;
+            return 2;
+        default:
+            out[0] = in->a;
+            return 1;
+    }
+}
+
+/* register the instruction writes, or -1 */
+static int writes(const IrInstr *in) {
+    if (in->op >= IR_MOV && in->op <= IR_CMPI_DIFF) return in->d;
+    return in->op == IR_READ ? in->d : -1;
+}
+
+/* no effect but its result: removable once that is unused */
+static int is_pure(int op) {
+    return op >= IR_MOV && op <= IR_CMPI_DIFF && (op < IR_DIV || op > IR_MODI);
+}
+
+/* drops the IR_NOPs, jumps going to the next instruction kept */
+static void compact(IrProgram *ir) {
+    int *renum = malloc(((size_t)ir->count + 1) * sizeof(int));
+    if (renum == NULL) {
+        erreur("Code memory overflow");
+    }
+    int kept = 0;
+    for (int i = 0; i < ir->count; ++i) {
+        renum[i] = kept;
+        if (ir->code[i].op != IR_NOP) kept++;
+    }
+    renum[ir->count] = kept;
+    for (int i = 0, k = 0; i < ir->count; ++i) {
+        if (ir->code[i].op == IR_NOP) continue;
+        ir->code[k] = ir->code[i];
+        ir->origin[k] = ir->origin[i];
+        if (is_jump(ir->code[k].op)) ir->code[k].d = renum[ir->code[k].d];
+        k++;
+    }
+    ir->count = kept;
+    free(renum);
+}
+
+void ir_optimiser(IrProgram *ir) {
+    int base = ir->nvars + ir->nslots;
+    int ntemps = ir->nregs - base;
+    int *uses = calloc((size_t)ntemps + 1, sizeof(int));
+    int *def = malloc(((size_t)ntemps + 1) * sizeof(int));
+    char *target = calloc((size_t)ir->count + 1, 1);
+    if (uses == NULL || def == NULL || target == NULL) {
+        erreur("Code memory overflow");
+    }
+    for (int i = 0; i < ir->count; ++i) {
+        const IrInstr *in = &ir->code[i];
+        int r[2], n = reads(in, r);
+        for (int k = 0; k < n; ++k) {
+            if (r[k] >= base) uses[r[k] - base]++;
+        }
+        if (writes(in) >= base) def[writes(in) - base] = i;
+        if (is_jump(in->op)) target[in->d] = 1;
+    }
+
+    /* temporaries have one definition, in the block of their only use
+       for values of the stack code: each pattern needs the definition
+       right before its use, in the same block */
+    for (int i = 1; i < ir->count; ++i) {
+        IrInstr *in = &ir->code[i], *prev = &ir->code[i - 1];
+        if (target[i] || prev->op == IR_NOP) continue;
+        if (in->op == IR_MOV && in->a >= base && uses[in->a - base] == 1 && def[in->a - base] == i - 1) {
+            prev->d = in->d;
+            in->op = IR_NOP;
+            uses[in->a - base] = 0;
+            ir_counts[IR_OPT_AFFECTATION]++;
+        } else if (in->op == IR_JZ && in->a >= base && uses[in->a - base] == 1 && def[in->a - base] == i - 1
+                   && prev->op >= IR_CMP_SUP && prev->op <= IR_CMPI_DIFF) {
+            prev->op = (uint16_t)(prev->op + (IR_JNOT_SUP - IR_CMP_SUP));
+            prev->d = in->d;
+            in->op = IR_NOP;
+            uses[in->a - base] = 0;
+            ir_counts[IR_OPT_BRANCHEMENT]++;
+        }
+    }
+
+    /* backward, so that a whole chain of unused values goes */
+    for (int i = ir->count - 1; i >= 0; --i) {
+        IrInstr *in = &ir->code[i];
+        int w = writes(in);
+        if (w < base || !is_pure(in->op) || uses[w - base] > 0) continue;
+        int r[2], n = reads(in, r);
+        for (int k = 0; k < n; ++k) {
+            if (r[k] >= base) uses[r[k] - base]--;
+        }
+        in->op = IR_NOP;
+        ir_counts[IR_OPT_MORT]++;
+    }
+    compact(ir);
+
+    for (int i = 0; i < ir->count; ++i) {
+        if (ir->code[i].op == IR_JMP && ir->code[i].d == i + 1) {
+            ir->code[i].op = IR_NOP;
+            ir_counts[IR_OPT_SAUT]++;
+        }
+    }
+    compact(ir);
+    free(uses);
+    free(def);
+    free(target);
+}
+
+/* Temporaries live from their definition to their last use, inside one
+   block: a linear scan hands their registers back for reuse. */
+void ir_allouer(IrProgram *ir) {
+    int base = ir->nvars + ir->nslots;
+    int ntemps = ir->nregs - base;
+    int *last = malloc(((size_t)ntemps + 1) * sizeof(int));
+    int *assigned = malloc(((size_t)ntemps + 1) * sizeof(int));
+    int *free_regs = malloc(((size_t)ntemps + 1) * sizeof(int));
+    if (last == NULL || assigned == NULL || free_regs == NULL) {
+        erreur("Code memory overflow");
+    }
+    for (int t = 0; t < ntemps; ++t) {
+        last[t] = -1;
+        assigned[t] = -1;
+    }
+    for (int i = 0; i < ir->count; ++i) {
+        int r[2], n = reads(&ir->code[i], r);
+        for (int k = 0; k < n; ++k) {
+            if (r[k] >= base) last[r[k] - base] = i;
+        }
+    }
+
+    int nfree = 0, used = 0;
+    for (int i = 0; i < ir->count; ++i) {
+        IrInstr *in = &ir->code[i];
+        int r[2], n = reads(in, r);
+        for (int k = 0; k < n; ++k) {
+            if (r[k] < base) continue;
+            int t = r[k] - base, to = base + assigned[t];
+            if (k == 0) in->a = to;
+            else in->b = to;
+            if (last[t] == i && (k == 0 || r[0] != r[1])) free_regs[nfree++] = assigned[t];
+        }
+        int w = writes(in);
+        if (w >= base) {
+            int t = w - base;
+            assigned[t] = nfree > 0 ? free_regs[--nfree] : used++;
+            in->d = base + assigned[t];
+            if (last[t] < i) free_regs[nfree++] = assigned[t];    /* never read */
+        }
+    }
+    ir->nregs = base + used;
+    free(last);
+    free(assigned);
+    free(free_regs);
+}
+
+void ir_free(IrProgram *ir) {
+    free(ir->code);
+    free(ir->origin);
+    free(ir->threaded);
+    memset(ir, 0, sizeof(*ir));
+}
+
+int ir_thread(IrProgram *ir);   /* ir_vm.c */
+
+int ir_load(IrProgram *ir, const VmProgram *prog) {
+    if (ir_build(ir, prog) != 0) return -1;
+    ir_optimiser(ir);
+    ir_allouer(ir);
+    if (ir_thread(ir) != 0) {
+        ir_free(ir);
+        return -1;
+    }
+    return 0;
+}
+
+/* ---------- listing ---------- */
+
+static const char *reg_name(const IrProgram *ir, int r, char *buf) {
+    if (r < ir->nvars) sprintf(buf, "v%d", r);
+    else if (r < ir->nvars + ir->nslots) sprintf(buf, "p%d", r - ir->nvars);
+    else sprintf(buf, "t%d", r - ir->nvars - ir->nslots);
+    return buf;
+}
+
+static const char arith_signs[IR_COUNT] = {
+    [IR_ADD] = '+', [IR_ADDI] = '+', [IR_SUB] = '-', [IR_SUBI] = '-',
+    [IR_MUL] = '*', [IR_MULI] = '*', [IR_DIV] = '/', [IR_DIVI] = '/', [IR_MOD] = '%', [IR_MODI] = '%'
+};
+static const char *const cmp_signs[6] = {">", "<", "=", ">=", "<=", "<>"};
+
+void ir_print(FILE *out, const IrProgram *ir) {
+    for (int i = 0; i < ir->count; ++i) {
+        const IrInstr *in = &ir->code[i];
+        char d[16], a[16], b[16];
+        fprintf(out, "%5d: ", i);
+        switch (in->op) {
+            case IR_MOV: fprintf(out, "%s = %s", reg_name(ir, in->d, d), reg_name(ir, in->a, a)); break;
+            case IR_MOVI: fprintf(out, "%s = %d", reg_name(ir, in->d, d), in->b); break;
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+                fprintf(out, "%s = %s %c %s", reg_name(ir, in->d, d), reg_name(ir, in->a, a),
+                        arith_signs[in->op], reg_name(ir, in->b, b));
+                break;
+            case IR_ADDI: case IR_SUBI: case IR_MULI: case IR_DIVI: case IR_MODI:
+                fprintf(out, "%s = %s %c %d", reg_name(ir, in->d, d), reg_name(ir, in->a, a),
+                        arith_signs[in->op], in->b);
+                break;
+            case IR_RSUBI: fprintf(out, "%s = %d - %s", reg_name(ir, in->d, d), in->b, reg_name(ir, in->a, a)); break;
+            case IR_SHL: fprintf(out, "%s = %s << %d", reg_name(ir, in->d, d), reg_name(ir, in->a, a), in->b); break;
+            case IR_SHR: fprintf(out, "%s = %s >> %d", reg_name(ir, in->d, d), reg_name(ir, in->a, a), in->b); break;
+            case IR_JMP: fprintf(out, "aller a %d", in->d); break;
+            case IR_JZ: fprintf(out, "si %s = 0 aller a %d", reg_name(ir, in->a, a), in->d); break;
+            case IR_STORE: fprintf(out, "[%s] = %s", reg_name(ir, in->a, a), reg_name(ir, in->b, b)); break;
+            case IR_READ: fprintf(out, "%s = lire", reg_name(ir, in->d, d)); break;
+            case IR_WRITE: fprintf(out, "ecrire %s", reg_name(ir, in->a, a)); break;
+            case IR_HALT: fprintf(out, "halte"); break;
+            default:
+                if (in->op >= IR_CMP_SUP && in->op <= IR_CMP_DIFF)
+                    fprintf(out, "%s = %s %s %s", reg_name(ir, in->d, d), reg_name(ir, in->a, a),
+                            cmp_signs[in->op - IR_CMP_SUP], reg_name(ir, in->b, b));
+                else if (in->op >= IR_CMPI_SUP && in->op <= IR_CMPI_DIFF)
+                    fprintf(out, "%s = %s %s %d", reg_name(ir, in->d, d), reg_name(ir, in->a, a),
+                            cmp_signs[in->op - IR_CMPI_SUP], in->b);
+                else if (in->op >= IR_JNOT_SUP && in->op <= IR_JNOT_DIFF)
+                    fprintf(out, "si non %s %s %s aller a %d", reg_name(ir, in->a, a),
+                            cmp_signs[in->op - IR_JNOT_SUP], reg_name(ir, in->b, b), in->d);
+                else
+                    fprintf(out, "si non %s %s %d aller a %d", reg_name(ir, in->a, a),
+                            cmp_signs[in->op - IR_JNOTI_SUP], in->b, in->d);
+                break;
+        }
+        fprintf(out, "\n");
+    }
+}
+
+void ir_print_stats(FILE *out) {
+    for (int o = 0; o < IR_OPT_COUNT; ++o) fprintf(out, "ir %-20s %d\n", opt_names[o], ir_counts[o]);
+}
@@ -0,0 +1,93 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "vm.h"
+
+/*
+ * Three-address register form of a loaded stack program. Registers are
+ * numbered in one file: the variables first (register a is the variable
+ * at address a, so an indirect := is a store into the file), then one
+ * register per stack height for values still on the stack at a jump or
+ * a jump target, then temporaries. ir_build() gives every stack value
+ * its own temporary, defined once (SSA); values meeting at a target go
+ * through the per-height registers, which play the part of phi nodes.
+ * ir_optimiser() works on that form, then ir_allouer() lets temporaries
+ * whose lives do not overlap share a register.
+ */
+
+typedef enum {
+    IR_NOP,             /* removed by the optimizer, never executed */
+    IR_MOV,             /* d = a */
+    IR_MOVI,            /* d = #b */
+    IR_ADD,             /* d = a + b */
+    IR_ADDI,            /* d = a + #b */
+    IR_SUB,
+    IR_SUBI,
+    IR_RSUBI,           /* d = #b - a */
+    IR_MUL,
+    IR_MULI,
+    IR_DIV,
+    IR_DIVI,            /* #b may be 0: fails at run time like Div */
+    IR_MOD,
+    IR_MODI,            /* like IR_DIVI */
+    IR_SHL,             /* d = a << #b */
+    IR_SHR,             /* d = a / 2^#b, truncated like Décaler-droite */
+    /* comparisons, in the order of OP_COMPARER_*: d = (a ? b) */
+    IR_CMP_SUP, IR_CMP_INF, IR_CMP_EGAL, IR_CMP_SUP_EGAL, IR_CMP_INF_EGAL, IR_CMP_DIFF,
+    IR_CMPI_SUP, IR_CMPI_INF, IR_CMPI_EGAL, IR_CMPI_SUP_EGAL, IR_CMPI_INF_EGAL, IR_CMPI_DIFF,
+    IR_JMP,             /* goto d */
+    IR_JZ,              /* if a == 0 goto d */
+    /* compare and branch: if !(a ? b) goto d */
+    IR_JNOT_SUP, IR_JNOT_INF, IR_JNOT_EGAL, IR_JNOT_SUP_EGAL, IR_JNOT_INF_EGAL, IR_JNOT_DIFF,
+    IR_JNOTI_SUP, IR_JNOTI_INF, IR_JNOTI_EGAL, IR_JNOTI_SUP_EGAL, IR_JNOTI_INF_EGAL, IR_JNOTI_DIFF,
+    IR_STORE,           /* register a (an address) = b, checked */
+    IR_READ,            /* d = integer read */
+    IR_WRITE,           /* print a */
+    IR_HALT,
+    IR_COUNT
+} IrOp;
+
+typedef struct {
+    uint16_t op;
+    int32_t d;          /* destination register, or jump target */
+    int32_t a;          /* register */
+    int32_t b;          /* register, or the constant of the I forms */
+} IrInstr;
+
+typedef struct {
+    IrInstr *code;
+    int *origin;        /* stack instruction each one comes from, for errors */
+    int count;
+    int nvars;          /* registers 0..nvars-1 are the variables */
+    int nslots;         /* then the per-height registers */
+    int nregs;          /* size of the register file */
+    void *threaded;     /* handler addresses, when built with computed goto */
+} IrProgram;
+
+typedef enum {
+    IR_OPT_AFFECTATION,     /* t = a op b; x = t  ->  x = a op b */
+    IR_OPT_BRANCHEMENT,     /* t = a ? b; if t == 0 goto  ->  if !(a ? b) goto */
+    IR_OPT_MORT,            /* unused temporaries */
+    IR_OPT_SAUT,            /* jumps to the next instruction */
+    IR_OPT_COUNT
+} IrOptimisation;
+
+extern int ir_counts[IR_OPT_COUNT];
+
+int ir_build(IrProgram *ir, const VmProgram *prog);
+void ir_optimiser(IrProgram *ir);
+void ir_allouer(IrProgram *ir);
+void ir_free(IrProgram *ir);
+/* ir_build(), ir_optimiser() and ir_allouer() of a loaded program */
+int ir_load(IrProgram *ir, const VmProgram *prog);
+void ir_print(FILE *out, const IrProgram *ir);
+void ir_print_stats(FILE *out);
+
+/* runs ir with the input, output and results of vm; vm->pc is the stack
+   instruction that stopped the run, vm->executed counts IR instructions */
+VmStatus ir_run(const IrProgram *ir, Vm *vm);
+
+#endif
@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ir.h"
+
+/* Register machine for the IR, dispatched like vm.c: computed goto where
+   the compiler has it, -DVM_SWITCH for the switch loop. */
+#if defined(__GNUC__) && !defined(VM_SWITCH)
+#define VM_THREADED 1
+#endif
+
+typedef struct {
+    const void *handler;
+    int32_t d;
+    int32_t a;
+    int32_t b;
+} IrThreaded;
+
+static VmStatus ir_exec(const IrProgram *ir, Vm *vm, const void *const **handlers);
+
+int ir_thread(IrProgram *ir) {
+#ifdef VM_THREADED
+    const void *const *handlers;
+    ir_exec(NULL, NULL, &handlers);
+    IrThreaded *threaded = malloc(((size_t)ir->count + 1) * sizeof(IrThreaded));
+    if (threaded == NULL) return -1;
+    for (int i = 0; i < ir->count; ++i) {
+        threaded[i].handler = handlers[ir->code[i].op];
+        threaded[i].d = ir->code[i].d;
+        threaded[i].a = ir->code[i].a;
+        threaded[i].b = ir->code[i].b;
+    }
+    ir->threaded = threaded;
+#else
+    (void)ir;
+#endif
+    return 0;
+}
+
+VmStatus ir_run(const IrProgram *ir, Vm *vm) {
+    return ir_exec(ir, vm, NULL);
+}
+
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+
+static VmStatus ir_exec(const IrProgram *ir, Vm *vm, const void *const **handlers) {
+#ifdef VM_THREADED
+    static const void *const table[IR_COUNT] = {
+        [IR_NOP] = &&ir_nop,
+        [IR_MOV] = &&ir_mov,
+        [IR_MOVI] = &&ir_movi,
+        [IR_ADD] = &&ir_add,
+        [IR_ADDI] = &&ir_addi,
+        [IR_SUB] = &&ir_sub,
+        [IR_SUBI] = &&ir_subi,
+        [IR_RSUBI] = &&ir_rsubi,
+        [IR_MUL] = &&ir_mul,
+        [IR_MULI] = &&ir_muli,
+        [IR_DIV] = &&ir_div,
+        [IR_DIVI] = &&ir_divi,
+        [IR_MOD] = &&ir_mod,
+        [IR_MODI] = &&ir_modi,
+        [IR_SHL] = &&ir_shl,
+        [IR_SHR] = &&ir_shr,
+        [IR_CMP_SUP] = &&ir_cmp_sup,
+        [IR_CMP_INF] = &&ir_cmp_inf,
+        [IR_CMP_EGAL] = &&ir_cmp_egal,
+        [IR_CMP_SUP_EGAL] = &&ir_cmp_sup_egal,
+        [IR_CMP_INF_EGAL] = &&ir_cmp_inf_egal,
+        [IR_CMP_DIFF] = &&ir_cmp_diff,
+        [IR_CMPI_SUP] = &&ir_cmpi_sup,
+        [IR_CMPI_INF] = &&ir_cmpi_inf,
+        [IR_CMPI_EGAL] = &&ir_cmpi_egal,
+        [IR_CMPI_SUP_EGAL] = &&ir_cmpi_sup_egal,
+        [IR_CMPI_INF_EGAL] = &&ir_cmpi_inf_egal,
+        [IR_CMPI_DIFF] = &&ir_cmpi_diff,
+        [IR_JMP] = &&ir_jmp,
+        [IR_JZ] = &&ir_jz,
+        [IR_JNOT_SUP] = &&ir_jnot_sup,
+        [IR_JNOT_INF] = &&ir_jnot_inf,
+        [IR_JNOT_EGAL] = &&ir_jnot_egal,
+        [IR_JNOT_SUP_EGAL] = &&ir_jnot_sup_egal,
+        [IR_JNOT_INF_EGAL] = &&ir_jnot_inf_egal,
+        [IR_JNOT_DIFF] = &&ir_jnot_diff,
+        [IR_JNOTI_SUP] = &&ir_jnoti_sup,
+        [IR_JNOTI_INF] = &&ir_jnoti_inf,
+        [IR_JNOTI_EGAL] = &&ir_jnoti_egal,
+        [IR_JNOTI_SUP_EGAL] = &&ir_jnoti_sup_egal,
+        [IR_JNOTI_INF_EGAL] = &&ir_jnoti_inf_egal,
+        [IR_JNOTI_DIFF] = &&ir_jnoti_diff,
+        [IR_STORE] = &&ir_store,
+        [IR_READ] = &&ir_read,
+        [IR_WRITE] = &&ir_write,
+        [IR_HALT] = &&ir_halt
+    };
+    if (handlers != NULL) {
+        *handlers = table;
+        return VM_OK;
+    }
+
+    const IrThreaded *base = ir->threaded;
+    const IrThreaded *ip = base;
+#define CASE(name)  name:
+#define DISPATCH()  goto *ip->handler
+#define NEXT()      do { ++ip; ++executed; DISPATCH(); } while (0)
+#define JUMP(t)     do { ip = base + (t); ++executed; DISPATCH(); } while (0)
+#else
+    (void)handlers;
+    const IrInstr *base = ir->code;
+    const IrInstr *ip = base;
+#define CASE(name)  case name:
+#define DISPATCH()  continue
+/* plain blocks: a do/while wrapper would capture the continue */
+#define NEXT()      { ++ip; ++executed; continue; }
+#define JUMP(t)     { ip = base + (t); ++executed; continue; }
+#define ir_nop IR_NOP
+#define ir_mov IR_MOV
+#define ir_movi IR_MOVI
+#define ir_add IR_ADD
+#define ir_addi IR_ADDI
+#define ir_sub IR_SUB
+#define ir_subi IR_SUBI
+#define ir_rsubi IR_RSUBI
+#define ir_mul IR_MUL
+#define ir_muli IR_MULI
+#define ir_div IR_DIV
+#define ir_divi IR_DIVI
+#define ir_mod IR_MOD
+#define ir_modi IR_MODI
+#define ir_shl IR_SHL
+#define ir_shr IR_SHR
+#define ir_cmp_sup IR_CMP_SUP
+#define ir_cmp_inf IR_CMP_INF
+#define ir_cmp_egal IR_CMP_EGAL
+#define ir_cmp_sup_egal IR_CMP_SUP_EGAL
+#define ir_cmp_inf_egal IR_CMP_INF_EGAL
+#define ir_cmp_diff IR_CMP_DIFF
+#define ir_cmpi_sup IR_CMPI_SUP
+#define ir_cmpi_inf IR_CMPI_INF
+#define ir_cmpi_egal IR_CMPI_EGAL
+#define ir_cmpi_sup_egal IR_CMPI_SUP_EGAL
+#define ir_cmpi_inf_egal IR_CMPI_INF_EGAL
+#define ir_cmpi_diff IR_CMPI_DIFF
+#define ir_jmp IR_JMP
+#define ir_jz IR_JZ
+#define ir_jnot_sup IR_JNOT_SUP
+#define ir_jnot_inf IR_JNOT_INF
+#define ir_jnot_egal IR_JNOT_EGAL
+#define ir_jnot_sup_egal IR_JNOT_SUP_EGAL
+#define ir_jnot_inf_egal IR_JNOT_INF_EGAL
+#define ir_jnot_diff IR_JNOT_DIFF
+#define ir_jnoti_sup IR_JNOTI_SUP
+#define ir_jnoti_inf IR_JNOTI_INF
+#define ir_jnoti_egal IR_JNOTI_EGAL
+#define ir_jnoti_sup_egal IR_JNOTI_SUP_EGAL
+#define ir_jnoti_inf_egal IR_JNOTI_INF_EGAL
+#define ir_jnoti_diff IR_JNOTI_DIFF
+#define ir_store IR_STORE
+#define ir_read IR_READ
+#define ir_write IR_WRITE
+#define ir_halt IR_HALT
+#endif
+#define PC          ((int)(ip - base))
+#define D           (r[ip->d])
+#define A           (r[ip->a])
+#define B           (r[ip->b])
+#define K           (ip->b)
+
+    /* the variables are the first registers, zeroed like vm->memory */
+    int32_t *r = calloc((size_t)ir->nregs + 1, sizeof(int32_t));
+    uint64_t executed = 0;
+    VmStatus status = VM_OK;
+    int32_t a, b;
+
+    if (r == NULL) {
+        vm->pc = 0;
+        vm->executed = 0;
+        return VM_ERR_LOAD;
+    }
+
+#ifdef VM_THREADED
+    DISPATCH();
+#else
+    for (;;) switch (ip->op) {
+#endif
+
+    CASE(ir_nop)
+        NEXT();
+    CASE(ir_mov)
+        D = A;
+        NEXT();
+    CASE(ir_movi)
+        D = K;
+        NEXT();
+    CASE(ir_add)
+        D = WRAP((uint32_t)A + (uint32_t)B);
+        NEXT();
+    CASE(ir_addi)
+        D = WRAP((uint32_t)A + (uint32_t)K);
+        NEXT();
+    CASE(ir_sub)
+        D = WRAP((uint32_t)A - (uint32_t)B);
+        NEXT();
+    CASE(ir_subi)
+        D = WRAP((uint32_t)A - (uint32_t)K);
+        NEXT();
+    CASE(ir_rsubi)
+        D = WRAP((uint32_t)K - (uint32_t)A);
+        NEXT();
+    CASE(ir_mul)
+        D = WRAP((uint32_t)A * (uint32_t)B);
+        NEXT();
+    CASE(ir_muli)
+        D = WRAP((uint32_t)A * (uint32_t)K);
+        NEXT();
+    CASE(ir_div)
+        b = B;
+        goto divide;
+    CASE(ir_divi)
+        b = K;
+    divide:
+        if (b == 0) {
+            status = VM_ERR_DIV_ZERO;
+            goto stop;
+        }
+        D = (b == -1) ? WRAP(0u - (uint32_t)A) : A / b;
+        NEXT();
+    CASE(ir_mod)
+        b = B;
+        goto remainder;
+    CASE(ir_modi)
+        b = K;
+    remainder:
+        if (b == 0) {
+            status = VM_ERR_DIV_ZERO;
+            goto stop;
+        }
+        D = (b == -1) ? 0 : A % b;
+        NEXT();
+    CASE(ir_shl)
+        D = WRAP((uint32_t)A << K);
+        NEXT();
+    CASE(ir_shr)
+        /* biased like op_decaler_droite so that it truncates */
+        a = A;
+        D = WRAP((uint32_t)a + ((uint32_t)(a >> 31) & ((1u << K) - 1))) >> K;
+        NEXT();
+    CASE(ir_cmp_sup)
+        D = A > B;
+        NEXT();
+    CASE(ir_cmp_inf)
+        D = A < B;
+        NEXT();
+    CASE(ir_cmp_egal)
+        D = A == B;
+        NEXT();
+    CASE(ir_cmp_sup_egal)
+        D = A >= B;
+        NEXT();
+    CASE(ir_cmp_inf_egal)
+        D = A <= B;
+        NEXT();
+    CASE(ir_cmp_diff)
+        D = A != B;
+        NEXT();
+    CASE(ir_cmpi_sup)
+        D = A > K;
+        NEXT();
+    CASE(ir_cmpi_inf)
+        D = A < K;
+        NEXT();
+    CASE(ir_cmpi_egal)
+        D = A == K;
+        NEXT();
+    CASE(ir_cmpi_sup_egal)
+        D = A >= K;
+        NEXT();
+    CASE(ir_cmpi_inf_egal)
+        D = A <= K;
+        NEXT();
+    CASE(ir_cmpi_diff)
+        D = A != K;
+        NEXT();
+    CASE(ir_jmp)
+        JUMP(ip->d);
+    CASE(ir_jz)
+        if (A == 0) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnot_sup)
+        if (!(A > B)) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnot_inf)
+        if (!(A < B)) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnot_egal)
+        if (A != B) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnot_sup_egal)
+        if (A < B) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnot_inf_egal)
+        if (A > B) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnot_diff)
+        if (A == B) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnoti_sup)
+        if (!(A > K)) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnoti_inf)
+        if (!(A < K)) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnoti_egal)
+        if (A != K) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnoti_sup_egal)
+        if (A < K) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnoti_inf_egal)
+        if (A > K) JUMP(ip->d);
+        NEXT();
+    CASE(ir_jnoti_diff)
+        if (A == K) JUMP(ip->d);
+        NEXT();
+    CASE(ir_store)
+        a = A;
+        if ((uint32_t)a >= (uint32_t)ir->nvars) {
+            status = VM_ERR_ADDRESS;
+            goto stop;
+        }
+        r[a] = B;
+        NEXT();
+    CASE(ir_read)
+        if (fscanf(vm->in, "%d", &a) != 1) {
+            status = VM_ERR_INPUT;
+            goto stop;
+        }
+        D = a;
+        NEXT();
+    CASE(ir_write)
+        fprintf(vm->out, "%d\n", A);
+        NEXT();
+    CASE(ir_halt)
+        ++executed;
+        goto stop;
+
+#ifndef VM_THREADED
+    default:
+        status = VM_ERR_LOAD;
+        goto stop;
+    }
+#endif
+
+stop:
+    vm->pc = ir->origin[PC];
+    vm->executed = executed;
+    memcpy(vm->memory, r, (size_t)ir->nvars * sizeof(int32_t));
+    free(r);
+    return status;
+}
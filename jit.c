@@ -0,0 +1,758 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erreur.h"
+#include "jit.h"
+
+#if defined(__x86_64__) && (defined(__unix__) || defined(__APPLE__))
+
+#include <sys/mman.h>
+
+/* ---------- machine code buffer ---------- */
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+/* condition codes; cc ^ 1 is the opposite condition */
+enum { CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+#define MEM   R15       /* vm->memory */
+#define SPILL R14       /* vm->stack: homes of the slots past the registers */
+
+/* homes of the first operand stack slots: callee-saved registers first,
+   the others are saved around calls */
+static const int slot_regs[] = {RBX, R12, R13, RBP, RSI, RDI, R8, R9, R10, R11};
+#define NSLOT_REGS ((int)(sizeof(slot_regs) / sizeof(slot_regs[0])))
+
+static uint8_t *out = NULL;
+static size_t out_count = 0;
+static size_t out_capacity = 0;
+
+static void byte(int b) {
+    if (out_count == out_capacity) {
+        out_capacity = out_capacity ? out_capacity * 2 : 4096;
+        out = realloc(out, out_capacity);
+        if (out == NULL) {
+            erreur("Code memory overflow");
+        }
+    }
+    out[out_count++] = (uint8_t)b;
+}
+
+static void dword(int32_t v) {
+    uint32_t u = (uint32_t)v;
+    for (int k = 0; k < 4; ++k) byte((int)(u >> (8 * k)) & 0xFF);
+}
+
+static void patch32(size_t at, int32_t v) {
+    uint32_t u = (uint32_t)v;
+    for (int k = 0; k < 4; ++k) out[at + k] = (uint8_t)(u >> (8 * k));
+}
+
+static void rex(int w, int reg, int index, int base) {
+    int r = 0x40 | w << 3 | (reg >> 3) << 2 | (index >> 3) << 1 | base >> 3;
+    if (r != 0x40) byte(r);
+}
+
+static void modrm_reg(int reg, int rm) {
+    byte(0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+/* [base + disp]; base is never RSP or R12, which would need a SIB byte */
+static void modrm_mem(int reg, int base, int32_t disp) {
+    if (disp >= -128 && disp <= 127) {
+        byte(0x40 | (reg & 7) << 3 | (base & 7));
+        byte(disp & 0xFF);
+    } else {
+        byte(0x80 | (reg & 7) << 3 | (base & 7));
+        dword(disp);
+    }
+}
+
+/* 32-bit "opcode r/m, reg" or "opcode reg, r/m" between registers */
+static void op_rr(int opcode, int reg, int rm) {
+    rex(0, reg, 0, rm);
+    byte(opcode);
+    modrm_reg(reg, rm);
+}
+
+static void op_rm(int opcode, int reg, int base, int32_t disp) {
+    rex(0, reg, 0, base);
+    byte(opcode);
+    modrm_mem(reg, base, disp);
+}
+
+#define ADD_RM  0x01    /* add r/m, reg */
+#define AND_RM  0x21
+#define SUB_RM  0x29
+#define CMP_RM  0x39
+#define TEST_RM 0x85
+#define STORE   0x89    /* mov r/m, reg */
+#define LOAD    0x8B    /* mov reg, r/m */
+
+/* group 1 extensions for op_ri() */
+enum { ALU_ADD = 0, ALU_AND = 4, ALU_SUB = 5, ALU_CMP = 7 };
+
+static void op_ri(int ext, int r, int32_t imm) {
+    rex(0, 0, 0, r);
+    if (imm >= -128 && imm <= 127) {
+        byte(0x83);
+        modrm_reg(ext, r);
+        byte(imm & 0xFF);
+    } else {
+        byte(0x81);
+        modrm_reg(ext, r);
+        dword(imm);
+    }
+}
+
+static void op_mi(int ext, int base, int32_t disp, int32_t imm) {
+    rex(0, 0, 0, base);
+    if (imm >= -128 && imm <= 127) {
+        byte(0x83);
+        modrm_mem(ext, base, disp);
+        byte(imm & 0xFF);
+    } else {
+        byte(0x81);
+        modrm_mem(ext, base, disp);
+        dword(imm);
+    }
+}
+
+static void mov_ri(int r, int32_t imm) {
+    rex(0, 0, 0, r);
+    byte(0xB8 + (r & 7));
+    dword(imm);
+}
+
+static void mov_rr(int dst, int src) {
+    if (dst != src) op_rr(STORE, src, dst);
+}
+
+static void mov_mi(int base, int32_t disp, int32_t imm) {
+    rex(0, 0, 0, base);
+    byte(0xC7);
+    modrm_mem(0, base, disp);
+    dword(imm);
+}
+
+/* mov [MEM + index * 4], reg, or the constant imm when reg < 0 */
+static void store_indexed(int reg, int32_t imm, int index) {
+    rex(0, reg < 0 ? 0 : reg, index, MEM);
+    byte(reg < 0 ? 0xC7 : STORE);
+    byte(0x04 | ((reg < 0 ? 0 : reg) & 7) << 3);   /* [SIB] */
+    byte(0x80 | (index & 7) << 3 | (MEM & 7));      /* scale 4 */
+    if (reg < 0) dword(imm);
+}
+
+static void imul_rr(int dst, int src) {
+    rex(0, dst, 0, src);
+    byte(0x0F);
+    byte(0xAF);
+    modrm_reg(dst, src);
+}
+
+static void imul_rri(int dst, int src, int32_t imm) {
+    rex(0, dst, 0, src);
+    if (imm >= -128 && imm <= 127) {
+        byte(0x6B);
+        modrm_reg(dst, src);
+        byte(imm & 0xFF);
+    } else {
+        byte(0x69);
+        modrm_reg(dst, src);
+        dword(imm);
+    }
+}
+
+/* group 2 (shifts by an immediate) and group 3 (F7) extensions */
+enum { SHIFT_SHL = 4, SHIFT_SAR = 7, F7_NEG = 3, F7_IDIV = 7 };
+
+static void shift_ri(int ext, int r, int k) {
+    rex(0, 0, 0, r);
+    byte(0xC1);
+    modrm_reg(ext, r);
+    byte(k);
+}
+
+static void f7(int ext, int r) {
+    rex(0, 0, 0, r);
+    byte(0xF7);
+    modrm_reg(ext, r);
+}
+
+static void push_r(int r) {
+    rex(0, 0, 0, r);
+    byte(0x50 + (r & 7));
+}
+
+static void pop_r(int r) {
+    rex(0, 0, 0, r);
+    byte(0x58 + (r & 7));
+}
+
+/* rel8 jump whose target is set by patch8() once emitted */
+static size_t jump8(int cc) {
+    byte(cc < 0 ? 0xEB : 0x70 + cc);
+    byte(0);
+    return out_count - 1;
+}
+
+static void patch8(size_t at) {
+    out[at] = (uint8_t)(out_count - (at + 1));
+}
+
+/* ---------- jumps and error exits, resolved once all code is out ---------- */
+
+typedef struct {
+    size_t at;          /* rel32 operand */
+    int target;         /* instruction, or error exit */
+    int status;         /* error exits: status, target being the pc */
+} Patch;
+
+static Patch *patches = NULL;
+static int npatches = 0;
+static int patches_capacity = 0;
+
+#define TO_EXIT (-1)    /* target of Halte: the epilogue */
+
+static void add_patch(size_t at, int target, int status) {
+    if (npatches == patches_capacity) {
+        patches_capacity = patches_capacity ? patches_capacity * 2 : 256;
+        patches = realloc(patches, (size_t)patches_capacity * sizeof(Patch));
+        if (patches == NULL) {
+            erreur("Code memory overflow");
+        }
+    }
+    patches[npatches++] = (Patch){at, target, status};
+}
+
+/* jmp (cc < 0) or jcc to an instruction */
+static void jump_to(int cc, int target) {
+    if (cc < 0) {
+        byte(0xE9);
+    } else {
+        byte(0x0F);
+        byte(0x80 + cc);
+    }
+    add_patch(out_count, target, VM_OK);
+    dword(0);
+}
+
+/* jmp or jcc to code stopping the run with status at instruction pc */
+static void fail(int cc, int pc, VmStatus status) {
+    if (cc < 0) {
+        byte(0xE9);
+    } else {
+        byte(0x0F);
+        byte(0x80 + cc);
+    }
+    add_patch(out_count, pc, status);
+    dword(0);
+}
+
+/* ---------- run-time support ---------- */
+
+/* bit 32 set when an integer was read, in the low half */
+static uint64_t jit_lire(Vm *vm) {
+    int32_t value;
+    if (fscanf(vm->in, "%d", &value) != 1) return 0;
+    return (uint64_t)1 << 32 | (uint32_t)value;
+}
+
+static void jit_ecrire(Vm *vm, int32_t value) {
+    fprintf(vm->out, "%d\n", value);
+}
+
+/* ---------- translation ---------- */
+
+/* An operand stack slot holds either a constant the translator has not
+   written anywhere yet, or a value in its home. */
+typedef struct {
+    int is_const;
+    int32_t value;
+} Slot;
+
+static Slot *slots = NULL;
+
+static int slot_reg(int k) {
+    return k < NSLOT_REGS ? slot_regs[k] : -1;
+}
+
+static int32_t slot_disp(int k) {
+    return 4 * k;
+}
+
+static int callee_saved(int r) {
+    return r == RBX || r == RBP || r >= R12;
+}
+
+/* writes slot k's pending constant to its home */
+static void materialize(int k) {
+    if (!slots[k].is_const) return;
+    if (slot_reg(k) >= 0) mov_ri(slot_reg(k), slots[k].value);
+    else mov_mi(SPILL, slot_disp(k), slots[k].value);
+    slots[k].is_const = 0;
+}
+
+/* at the edges of a block every slot is in its home */
+static void materialize_all(int height) {
+    for (int k = 0; k < height; ++k) materialize(k);
+}
+
+/* a register holding slot k, scratch if it is a constant or spilled */
+static int operand(int k, int scratch) {
+    if (slots[k].is_const) {
+        mov_ri(scratch, slots[k].value);
+        return scratch;
+    }
+    if (slot_reg(k) >= 0) return slot_reg(k);
+    op_rm(LOAD, scratch, SPILL, slot_disp(k));
+    return scratch;
+}
+
+/* slot k's value in the register a result for slot k is computed in:
+   its own, or RAX for a spilled slot */
+static int load_result(int k) {
+    int r = slot_reg(k) >= 0 ? slot_reg(k) : RAX;
+    mov_rr(r, operand(k, r));
+    return r;
+}
+
+/* slot k now holds register r */
+static void set_slot(int k, int r) {
+    slots[k].is_const = 0;
+    if (slot_reg(k) >= 0) mov_rr(slot_reg(k), r);
+    else op_rm(STORE, r, SPILL, slot_disp(k));
+}
+
+static void set_const(int k, int32_t value) {
+    slots[k].is_const = 1;
+    slots[k].value = value;
+}
+
+/* the caller-saved registers of slots 0..live-1 go to their stack
+   slots across a call into C */
+static void save_live(int live, int store) {
+    for (int k = 0; k < live && k < NSLOT_REGS; ++k) {
+        if (!slots[k].is_const && !callee_saved(slot_regs[k]))
+            op_rm(store ? STORE : LOAD, slot_regs[k], SPILL, slot_disp(k));
+    }
+}
+
+static void call(void *function) {
+    byte(0x48);                             /* mov rdi, [rsp]: the Vm */
+    byte(0x8B);
+    byte(0x3C);
+    byte(0x24);
+    byte(0x48);                             /* mov rax, function */
+    byte(0xB8);
+    uint64_t address = (uint64_t)(uintptr_t)function;
+    dword((int32_t)(uint32_t)address);
+    dword((int32_t)(uint32_t)(address >> 32));
+    byte(0xFF);                             /* call rax */
+    byte(0xD0);
+}
+
+/* Comparer-si-xx: condition on (a, b) under which it pushes 1 */
+static int condition(int op) {
+    switch (op) {
+        case OP_COMPARER_SUP: case OP_ALLER_SI_PAS_SUP: return CC_G;
+        case OP_COMPARER_INF: case OP_ALLER_SI_PAS_INF: return CC_L;
+        case OP_COMPARER_EGAL: case OP_ALLER_SI_PAS_EGAL: return CC_E;
+        case OP_COMPARER_SUP_EGAL: case OP_ALLER_SI_PAS_SUP_EGAL: return CC_GE;
+        case OP_COMPARER_INF_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: return CC_LE;
+        default: return CC_NE;
+    }
+}
+
+static int holds(int cc, int32_t a, int32_t b) {
+    switch (cc) {
+        case CC_G: return a > b;
+        case CC_L: return a < b;
+        case CC_E: return a == b;
+        case CC_GE: return a >= b;
+        case CC_LE: return a <= b;
+        default: return a != b;
+    }
+}
+
+/* cmp slot a, slot b, neither being both constants */
+static void compare(int a, int b) {
+    int ra = operand(a, RAX);
+    if (slots[b].is_const) op_ri(ALU_CMP, ra, slots[b].value);
+    else op_rr(CMP_RM, operand(b, RCX), ra);
+}
+
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+
+/* translates instruction i, the operand stack being h high */
+static void translate(const VmProgram *prog, int i, int h) {
+    const Instr *in = &prog->code[i];
+    int a = h - 2, b = h - 1;       /* operands of binary instructions */
+
+    switch (in->op) {
+        case OP_VALEURG:
+        case OP_EMPILER:
+            set_const(h, in->arg);
+            break;
+
+        case OP_VALEURD: {
+            int r = slot_reg(h) >= 0 ? slot_reg(h) : RAX;
+            op_rm(LOAD, r, MEM, 4 * in->arg);
+            set_slot(h, r);
+            break;
+        }
+
+        case OP_AFFECTER:
+            if (slots[a].is_const) {
+                int32_t address = slots[a].value;
+                if ((uint32_t)address >= (uint32_t)prog->nvars) fail(-1, i, VM_ERR_ADDRESS);
+                else if (slots[b].is_const) mov_mi(MEM, 4 * address, slots[b].value);
+                else op_rm(STORE, operand(b, RCX), MEM, 4 * address);
+            } else {
+                int ra = operand(a, RAX);
+                op_ri(ALU_CMP, ra, prog->nvars);
+                fail(CC_AE, i, VM_ERR_ADDRESS);
+                if (slots[b].is_const) store_indexed(-1, slots[b].value, ra);
+                else store_indexed(operand(b, RCX), 0, ra);
+            }
+            break;
+
+        case OP_ADD:
+        case OP_SUB:
+        case OP_MUL: {
+            if (slots[a].is_const && slots[b].is_const) {
+                uint32_t x = (uint32_t)slots[a].value, y = (uint32_t)slots[b].value;
+                set_const(a, WRAP(in->op == OP_ADD ? x + y : in->op == OP_SUB ? x - y : x * y));
+                break;
+            }
+            int r = load_result(a);
+            if (slots[b].is_const) {
+                if (in->op == OP_MUL) imul_rri(r, r, slots[b].value);
+                else op_ri(in->op == OP_ADD ? ALU_ADD : ALU_SUB, r, slots[b].value);
+            } else {
+                int rb = operand(b, RCX);
+                if (in->op == OP_MUL) imul_rr(r, rb);
+                else op_rr(in->op == OP_ADD ? ADD_RM : SUB_RM, rb, r);
+            }
+            set_slot(a, r);
+            break;
+        }
+
+        case OP_DIV:
+        case OP_MOD: {
+            /* idiv leaves the quotient in eax, the remainder in edx */
+            int mod = in->op == OP_MOD, result = mod ? RDX : RAX;
+            if (slots[b].is_const) {
+                int32_t y = slots[b].value;
+                if (y == 0) {
+                    fail(-1, i, VM_ERR_DIV_ZERO);
+                    set_const(a, 0);    /* never reached */
+                } else if (slots[a].is_const) {
+                    int32_t x = slots[a].value;
+                    if (mod) set_const(a, y == -1 ? 0 : x % y);
+                    else set_const(a, y == -1 ? WRAP(0u - (uint32_t)x) : x / y);
+                } else if (y == -1 && mod) {
+                    set_const(a, 0);
+                } else if (y == -1) {
+                    int r = load_result(a);
+                    f7(F7_NEG, r);
+                    set_slot(a, r);
+                } else {
+                    mov_rr(RAX, operand(a, RAX));
+                    byte(0x99);                         /* cdq */
+                    mov_ri(RCX, y);
+                    f7(F7_IDIV, RCX);
+                    set_slot(a, result);
+                }
+            } else {
+                /* INT32_MIN / -1 would fault: -1 negates, and leaves no
+                   remainder */
+                int rb = operand(b, RCX);
+                op_rr(TEST_RM, rb, rb);
+                fail(CC_E, i, VM_ERR_DIV_ZERO);
+                mov_rr(RAX, operand(a, RAX));
+                op_ri(ALU_CMP, rb, -1);
+                size_t to_divide = jump8(CC_NE);
+                if (mod) mov_ri(RDX, 0);
+                else f7(F7_NEG, RAX);
+                size_t to_end = jump8(-1);
+                patch8(to_divide);
+                byte(0x99);                             /* cdq */
+                f7(F7_IDIV, rb);
+                patch8(to_end);
+                set_slot(a, result);
+            }
+            break;
+        }
+
+        case OP_DECALER_GAUCHE:
+            if (slots[b].is_const) {
+                set_const(b, WRAP((uint32_t)slots[b].value << in->arg));
+            } else {
+                int r = load_result(b);
+                shift_ri(SHIFT_SHL, r, in->arg);
+                set_slot(b, r);
+            }
+            break;
+
+        case OP_DECALER_DROITE:
+            if (slots[b].is_const) {
+                int32_t x = slots[b].value;
+                set_const(b, WRAP((uint32_t)x + ((uint32_t)(x >> 31) & ((1u << in->arg) - 1))) >> in->arg);
+            } else {
+                /* bias negative values by 2^k - 1, as the interpreter does */
+                int r = load_result(b);
+                mov_rr(RCX, r);
+                shift_ri(SHIFT_SAR, RCX, 31);
+                op_ri(ALU_AND, RCX, (int32_t)((1u << in->arg) - 1));
+                op_rr(ADD_RM, RCX, r);
+                shift_ri(SHIFT_SAR, r, in->arg);
+                set_slot(b, r);
+            }
+            break;
+
+        case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+        case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF: {
+            int cc = condition(in->op);
+            if (slots[a].is_const && slots[b].is_const) {
+                set_const(a, holds(cc, slots[a].value, slots[b].value));
+                break;
+            }
+            compare(a, b);
+            byte(0x0F);                                 /* setcc cl */
+            byte(0x90 + cc);
+            modrm_reg(0, RCX);
+            byte(0x0F);                                 /* movzx ecx, cl */
+            byte(0xB6);
+            modrm_reg(RCX, RCX);
+            set_slot(a, RCX);
+            break;
+        }
+
+        case OP_ALLER:
+            materialize_all(h);
+            jump_to(-1, in->arg);
+            break;
+
+        case OP_ALLER_SI_FAUX:
+            materialize_all(h - 1);
+            if (slots[b].is_const) {
+                if (slots[b].value == 0) jump_to(-1, in->arg);
+            } else {
+                if (slot_reg(b) >= 0) op_rr(TEST_RM, slot_reg(b), slot_reg(b));
+                else op_mi(ALU_CMP, SPILL, slot_disp(b), 0);
+                jump_to(CC_E, in->arg);
+            }
+            break;
+
+        case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+        case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF: {
+            int cc = condition(in->op);
+            materialize_all(h - 2);
+            if (slots[a].is_const && slots[b].is_const) {
+                if (!holds(cc, slots[a].value, slots[b].value)) jump_to(-1, in->arg);
+                break;
+            }
+            compare(a, b);
+            jump_to(cc ^ 1, in->arg);
+            break;
+        }
+
+        case OP_INCR:
+            op_mi(ALU_ADD, MEM, 4 * in->arg, in->arg2);
+            break;
+
+        case OP_LIRE:
+            save_live(h, 1);
+            call((void *)jit_lire);
+            save_live(h, 0);
+            byte(0x48);                                 /* bt rax, 32 */
+            byte(0x0F);
+            byte(0xBA);
+            byte(0xE0);
+            byte(32);
+            fail(CC_AE, i, VM_ERR_INPUT);               /* carry clear */
+            set_slot(h, RAX);
+            break;
+
+        case OP_ECRIRE:
+            save_live(h - 1, 1);
+            mov_rr(RSI, operand(b, RSI));
+            call((void *)jit_ecrire);
+            save_live(h - 1, 0);
+            break;
+
+        case OP_HALTE:
+            mov_ri(RDX, i);
+            op_rr(0x31, RAX, RAX);                      /* xor eax, eax: VM_OK */
+            jump_to(-1, TO_EXIT);
+            break;
+    }
+}
+
+static int ends_block(int op) {
+    return op == OP_ALLER || op == OP_HALTE;
+}
+
+int jit_compile(JitCode *jit, const VmProgram *prog) {
+    int count = prog->count;        /* code[count] is the final Halte */
+    jit->code = NULL;
+    jit->size = 0;
+    if (prog->nvars > (1 << 28)) return -1;     /* 4 * address must fit a displacement */
+
+    size_t *native = malloc((size_t)(count + 1) * sizeof(size_t));
+    char *target = calloc((size_t)count + 1, 1);
+    slots = malloc(((size_t)prog->max_stack + 1) * sizeof(Slot));
+    if (native == NULL || target == NULL || slots == NULL) {
+        free(native);
+        free(target);
+        free(slots);
+        slots = NULL;
+        return -1;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (opcode_is_jump(prog->code[i].op)) target[prog->code[i].arg] = 1;
+    }
+    out_count = 0;
+    npatches = 0;
+
+    /* prologue: (Vm *vm, int32_t *memory, int32_t *stack), the Vm at [rsp] */
+    push_r(RBX);
+    push_r(RBP);
+    push_r(R12);
+    push_r(R13);
+    push_r(R14);
+    push_r(R15);
+    byte(0x48);                 /* sub rsp, 8: keeps calls 16-byte aligned */
+    byte(0x83);
+    byte(0xEC);
+    byte(0x08);
+    byte(0x48);                 /* mov [rsp], rdi */
+    byte(0x89);
+    byte(0x3C);
+    byte(0x24);
+    rex(1, RSI, 0, MEM);        /* mov r15, rsi */
+    byte(STORE);
+    modrm_reg(RSI, MEM);
+    rex(1, RDX, 0, SPILL);      /* mov r14, rdx */
+    byte(STORE);
+    modrm_reg(RDX, SPILL);
+
+    int h = 0, open = 1;        /* open: the previous instruction falls through */
+    for (int i = 0; i <= count; ++i) {
+        int height = prog->height[i];
+        if (open && target[i]) materialize_all(h);
+        native[i] = out_count;
+        if (height < 0) {       /* unreachable */
+            open = 0;
+            continue;
+        }
+        if (!open || target[i]) {
+            for (int k = 0; k < height; ++k) slots[k].is_const = 0;
+        }
+        translate(prog, i, height);
+        switch (prog->code[i].op) {     /* height after */
+            case OP_VALEURG: case OP_VALEURD: case OP_EMPILER: case OP_LIRE:
+                h = height + 1; break;
+            case OP_AFFECTER:
+            case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+            case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF:
+                h = height - 2; break;
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+            case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF:
+            case OP_ALLER_SI_FAUX: case OP_ECRIRE:
+                h = height - 1; break;
+            default:
+                h = height; break;
+        }
+        open = !ends_block(prog->code[i].op);
+    }
+
+    /* error exits: pc in edx, status in eax, then the epilogue */
+    for (int p = 0; p < npatches; ++p) {
+        if (patches[p].status == VM_OK) continue;
+        patch32(patches[p].at, (int32_t)(out_count - (patches[p].at + 4)));
+        mov_ri(RDX, patches[p].target);
+        mov_ri(RAX, patches[p].status);
+        jump_to(-1, TO_EXIT);
+    }
+    size_t exit = out_count;
+    byte(0x48);                 /* mov rdi, [rsp] */
+    byte(0x8B);
+    byte(0x3C);
+    byte(0x24);
+    op_rm(STORE, RDX, RDI, (int32_t)offsetof(Vm, pc));
+    byte(0x48);                 /* add rsp, 8 */
+    byte(0x83);
+    byte(0xC4);
+    byte(0x08);
+    pop_r(R15);
+    pop_r(R14);
+    pop_r(R13);
+    pop_r(R12);
+    pop_r(RBP);
+    pop_r(RBX);
+    byte(0xC3);
+
+    for (int p = 0; p < npatches; ++p) {
+        if (patches[p].status != VM_OK) continue;
+        size_t to = patches[p].target == TO_EXIT ? exit : native[patches[p].target];
+        patch32(patches[p].at, (int32_t)(to - (patches[p].at + 4)));
+    }
+    free(native);
+    free(target);
+    free(slots);
+    slots = NULL;
+
+    /* written, then made executable: never both at once */
+    void *code = mmap(NULL, out_count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) return -1;
+    memcpy(code, out, out_count);
+    if (mprotect(code, out_count, PROT_READ | PROT_EXEC) != 0) {
+        munmap(code, out_count);
+        return -1;
+    }
+    jit->code = code;
+    jit->size = out_count;
+    return 0;
+}
+
+VmStatus jit_run(const JitCode *jit, Vm *vm) {
+    VmStatus (*entry)(Vm *, int32_t *, int32_t *);
+    memcpy(&entry, &jit->code, sizeof(entry));
+    vm->executed = 0;
+    return entry(vm, vm->memory, vm->stack);
+}
+
+void jit_free(JitCode *jit) {
+    if (jit->code != NULL) munmap(jit->code, jit->size);
+    jit->code = NULL;
+    jit->size = 0;
+}
+
+#else
+
+int jit_compile(JitCode *jit, const VmProgram *prog) {
+    (void)prog;
+    jit->code = NULL;
+    jit->size = 0;
+    return -1;
+}
+
+VmStatus jit_run(const JitCode *jit, Vm *vm) {
+    (void)jit;
+    (void)vm;
+    return VM_ERR_LOAD;
+}
+
+void jit_free(JitCode *jit) {
+    jit->code = NULL;
+    jit->size = 0;
+}
+
+#endif
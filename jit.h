@@ -0,0 +1,29 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+
+#include "vm.h"
+
+/*
+ * Translation of a loaded program into x86-64 machine code, run in place
+ * of the interpreter. Each instruction becomes a few machine
+ * instructions in an mmap'd buffer: no assembler, no dispatch. The stack
+ * height of every instruction is known from vm_load(), so each operand
+ * stack slot has a fixed home, the first ones in registers and the
+ * others in vm->stack, and constants pushed by Empiler or Valeurg stay
+ * in the translator until an instruction consumes them. Lire and Ecrire
+ * call back into C. Errors stop the run with the status and vm->pc the
+ * interpreter would give; vm->executed is not counted.
+ */
+typedef struct {
+    void *code;         /* executable mapping, NULL when not compiled */
+    size_t size;
+} JitCode;
+
+/* returns -1 when this machine has no JIT or the mapping fails */
+int jit_compile(JitCode *jit, const VmProgram *prog);
+VmStatus jit_run(const JitCode *jit, Vm *vm);
+void jit_free(JitCode *jit);
+
+#endif
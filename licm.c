@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "erreur.h"
+#include "symtab.h"
+
+/*
+ * Loop-invariant code motion. An expression inside while loops only
+ * depends on the variables it reads; it gives the same value on every
+ * iteration of each enclosing loop that assigns none of them, so it can
+ * be computed once into a temporary just before the outermost such loop
+ * (in the loop's preheader, the N_BLOCK in c of N_WHILE) and read from
+ * there. Only expressions that cannot fail are moved: the preheader runs
+ * even when the loop body, or the branch the expression was in, does
+ * not. Comparisons stay where they are, to keep their fused branch.
+ *
+ * The tree is in post-order, so a subtree is the range of nodes from its
+ * first descendant to itself, and "loop L assigns v" is "one of the
+ * assignments to v is in L's range" (a binary search).
+ */
+
+_Thread_local int licm_count;
+
+static _Thread_local int *lo = NULL;          /* first node of each subtree */
+static _Thread_local int *level = NULL;       /* per expression node, see hoist_expression() */
+static _Thread_local AstIndex stores;         /* N_ASSIGN and N_READ, by variable */
+
+/* loops around the statement being visited, outermost first */
+static _Thread_local int *chain = NULL;
+static _Thread_local int depth = 0;
+
+/* hoisted assignments, as (loop, N_ASSIGN) pairs */
+static _Thread_local int *hoisted = NULL;
+static _Thread_local int nhoisted = 0;
+static _Thread_local int hoisted_capacity = 0;
+
+static void *allocate(int n, size_t size) {
+    void *p = malloc((n > 0 ? (size_t)n : 1) * size);
+    if (p == NULL) {
+        erreur("Syntax tree memory overflow");
+    }
+    return p;
+}
+
+/* does the loop chain[k] assign address v? */
+static int assigns(int k, int v) {
+    return ast_index_any(&stores, v, lo[chain[k]], chain[k]);
+}
+
+/* index in chain of the innermost loop assigning v, -1 if none; the loops
+   are nested, so those that do are a prefix of the chain (all of it for
+   an address that is not ours) */
+static int innermost_assigning(int v) {
+    int a = 0, b = depth;
+    while (a < b) {
+        int m = (a + b) / 2;
+        if (assigns(m, v)) a = m + 1;
+        else b = m;
+    }
+    return a - 1;
+}
+
+static void hoist(int loop, int e) {
+    /* e becomes a read of the temporary; its old contents move to a new
+       node that the preheader assigns */
+    int32_t temp = next_address++;
+    int moved = ast_new(N_CONST, 0, -1, -1, -1);
+    ast_nodes[moved] = ast_nodes[e];
+    AstNode *n = &ast_nodes[e];
+    n->kind = N_VAR;
+    n->op = 0;
+    n->value = temp;
+    n->a = n->b = n->c = -1;
+    int assign = ast_new(N_ASSIGN, temp, moved, -1, -1);
+
+    if (nhoisted + 2 > hoisted_capacity) {
+        hoisted_capacity = hoisted_capacity ? hoisted_capacity * 2 : 64;
+        hoisted = realloc(hoisted, (size_t)hoisted_capacity * sizeof(int));
+        if (hoisted == NULL) {
+            erreur("Syntax tree memory overflow");
+        }
+    }
+    hoisted[nhoisted++] = loop;
+    hoisted[nhoisted++] = assign;
+    licm_count++;
+}
+
+/*
+ * level[x] is how many of the enclosing loops x must stay inside: one
+ * more than the innermost of them assigning a variable x reads. A first
+ * scan computes it bottom-up. A second one, top-down, tracks in where[]
+ * how many loops each node is evaluated inside, and hoists every node
+ * that can be evaluated further out than its parent.
+ */
+static _Thread_local int *where = NULL;
+
+static void hoist_expression(int root) {
+    int kids[3];
+    for (int x = lo[root]; x <= root; ++x) {
+        const AstNode *n = &ast_nodes[x];
+        where[x] = -1;      /* until reached from the root: optimiser() leaves orphans */
+        if (n->kind == N_CONST) level[x] = 0;
+        else if (n->kind == N_VAR) level[x] = innermost_assigning(n->value) + 1;
+        else {
+            level[x] = 0;
+            for (int k = ast_children(x, kids); k-- > 0; ) {
+                if (level[kids[k]] > level[x]) level[x] = level[kids[k]];
+            }
+        }
+    }
+
+    where[root] = depth;
+    for (int x = root; x >= lo[root]; --x) {
+        if (where[x] < 0) continue;
+        int at = where[x], kind = ast_nodes[x].kind;
+        int n = ast_children(x, kids);
+        if (level[x] < at && n > 0 && kind != N_COMPARE && !ast_nodes[x].may_trap) {
+            at = level[x];
+            hoist(chain[at], x);
+        }
+        while (n-- > 0) where[kids[n]] = at;
+    }
+}
+
+typedef struct {
+    int node;
+    int step;
+} Visit;
+
+static int32_t stored_address(int i) {
+    return ast_nodes[i].kind == N_ASSIGN || ast_nodes[i].kind == N_READ ? ast_nodes[i].value : -1;
+}
+
+void licm(int root) {
+    int count = ast_count;
+
+    lo = ast_subtree_starts();
+    ast_index_build(&stores, next_address, stored_address);
+
+    level = allocate(count, sizeof(int));
+    where = allocate(count, sizeof(int));
+    chain = allocate(count, sizeof(int));
+    Visit *stack = allocate(count, sizeof(Visit));
+    int top = 0;
+    depth = 0;
+    nhoisted = 0;
+
+    stack[top++] = (Visit){ast_nodes[root].b, 0};
+    while (top > 0) {
+        Visit *v = &stack[top - 1];
+        int s = v->node;
+        switch (ast_nodes[s].kind) {
+            case N_BLOCK:
+                top--;
+                for (int k = ast_nodes[s].value; k-- > 0; ) stack[top++] = (Visit){ast_lists[ast_nodes[s].a + k], 0};
+                break;
+            case N_ASSIGN:
+                top--;
+                if (depth > 0) hoist_expression(ast_nodes[s].a);
+                break;
+            case N_IF:
+                top--;
+                if (depth > 0) hoist_expression(ast_nodes[s].a);
+                if (ast_nodes[s].c >= 0) stack[top++] = (Visit){ast_nodes[s].c, 0};
+                stack[top++] = (Visit){ast_nodes[s].b, 0};
+                break;
+            case N_WHILE:
+                if (v->step == 0) {
+                    v->step = 1;
+                    chain[depth++] = s;
+                    hoist_expression(ast_nodes[s].a);
+                    stack[top++] = (Visit){ast_nodes[s].b, 0};
+                } else {
+                    depth--;
+                    top--;
+                }
+                break;
+            default:
+                top--;
+                break;
+        }
+    }
+
+    /* one preheader per loop, its assignments in the order they were
+       made: where[] now links the hoisted pairs of each loop */
+    int *first = level;
+    for (int i = 0; i < count; ++i) first[i] = -1;
+    for (int h = nhoisted - 2; h >= 0; h -= 2) {
+        where[h / 2] = first[hoisted[h]];
+        first[hoisted[h]] = h / 2;
+    }
+    for (int h = 0; h < nhoisted; h += 2) {
+        int loop = hoisted[h];
+        if (first[loop] < 0) continue;
+        int mark = ast_list_mark();
+        for (int k = first[loop]; k >= 0; k = where[k]) ast_list_push(hoisted[2 * k + 1]);
+        first[loop] = -1;
+        int32_t n;
+        int list = ast_list_close(mark, &n);
+        ast_nodes[loop].c = ast_new(N_BLOCK, n, list, -1, -1);
+    }
+
+    free(lo);
+    free(level);
+    free(where);
+    free(chain);
+    free(stack);
+    free(hoisted);
+    ast_index_free(&stores);
+    lo = level = where = chain = hoisted = NULL;
+    hoisted_capacity = nhoisted = 0;
+}
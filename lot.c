@@ -0,0 +1,175 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "analyseur_synt.h"
+#include "entrees.h"
+#include "pool.h"
+
+/* Compiles many programs at once (see analyseur_synt.h).
+   Usage: lot [-j N] [-O0] [-o sortie] [-l liste] (source | repertoire)...
+   A directory stands for the .pas files in it, -l for the file names in
+   liste, one per line. Each worker thread compiles the files of its own
+   queue, then steals half of the remaining files of another queue, until
+   every queue is empty. For a source prog.pas, sortie/ gets
+   prog.pile_code.txt, prog.symbol_table.txt and prog.etiquettes.txt, so
+   two sources may not have the same name; the summary, one line per file
+   in input order, goes to stdout and to sortie/resume.txt.
+   Exit status 1 if a file failed to compile. */
+
+typedef struct {
+    const char *source;
+    int status;             /* compiler()'s return */
+    int before, count;      /* instructions generated, then kept */
+    double seconds;
+    char erreur[256];
+} Job;
+
+static Entrees entrees;
+static Job *jobs = NULL;
+static int job_count = 0;
+static PoolStats *stats = NULL;
+static int nworkers = 1;
+static int optimise = 1;
+static const char *sortie = "sortie";
+
+/* sortie/<source name without directory and .pas>.<suffix> */
+static void output_name(char *buffer, size_t size, const char *source, const char *suffix) {
+    const char *base = strrchr(source, '/');
+    base = base ? base + 1 : source;
+    size_t len = strlen(base);
+    if (len > 4 && strcmp(base + len - 4, ".pas") == 0) len -= 4;
+    snprintf(buffer, size, "%s/%.*s.%s", sortie, (int)len, base, suffix);
+}
+
+static void compile_job(void *data, int w, int j) {
+    Job *job = &jobs[j];
+    char code_file[4096], symtab_file[4096], labels_file[4096];
+    Compilation c;
+
+    (void)data;
+    (void)w;
+    output_name(code_file, sizeof(code_file), job->source, "pile_code.txt");
+    output_name(symtab_file, sizeof(symtab_file), job->source, "symbol_table.txt");
+    output_name(labels_file, sizeof(labels_file), job->source, "etiquettes.txt");
+    compilation_init(&c, job->source);
+    if (!optimise) {
+        c.optimise = 0;
+        c.rules = 0;
+    }
+    c.code_file = code_file;
+    c.symtab_file = symtab_file;
+    c.labels_file = labels_file;
+
+    double t0 = pool_now();
+    job->status = compiler(&c);
+    job->seconds = pool_now() - t0;
+    job->before = c.before;
+    job->count = c.count;
+    memcpy(job->erreur, c.erreur, sizeof(job->erreur));
+}
+
+static void write_summary(FILE *file, double seconds) {
+    int failed = 0;
+    long long before = 0, count = 0;
+
+    for (int j = 0; j < job_count; ++j) {
+        const Job *job = &jobs[j];
+        if (job->status == 0) {
+            fprintf(file, "%s: ok, %d -> %d instructions, %.3f ms\n",
+                    job->source, job->before, job->count, job->seconds * 1e3);
+            before += job->before;
+            count += job->count;
+        } else {
+            fprintf(file, "%s: erreur: %s\n", job->source, job->erreur);
+            failed++;
+        }
+    }
+    fprintf(file, "\n%d fichiers, %d compiles, %d en erreur\n", job_count, job_count - failed, failed);
+    fprintf(file, "instructions %lld -> %lld\n", before, count);
+    fprintf(file, "%d threads, %.3f s (%.0f fichiers/s)\n", nworkers, seconds,
+            seconds > 0 ? job_count / seconds : 0.0);
+    for (int w = 0; w < nworkers; ++w)
+        fprintf(file, "  thread %d: %d fichiers, %d vols, %.3f s de compilation\n",
+                w, stats[w].done, stats[w].steals, stats[w].busy);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j N] [-O0] [-o sortie] [-l liste] (source | repertoire)...\n", prog);
+    fprintf(stderr, "  -j N       N compiler threads (default: one per processor)\n");
+    fprintf(stderr, "  -O0        compile without optimization, as analyseur_synt -O0\n");
+    fprintf(stderr, "  -o sortie  directory of the listings and resume.txt (default: sortie)\n");
+    fprintf(stderr, "  -l liste   also compile the files named in liste, one per line (- = stdin)\n");
+    fprintf(stderr, "  repertoire stands for the .pas files it contains\n");
+}
+
+int main(int argc, char **argv) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    nworkers = processors > 0 ? (int)processors : 1;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nworkers = atoi(argv[++i]);
+            if (nworkers < 1) {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-O0") == 0) {
+            optimise = 0;
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            sortie = argv[++i];
+        } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            if (entrees_add_list(&entrees, argv[++i]) != 0) return 1;
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else if (entrees_add_path(&entrees, argv[i], ".pas") != 0) {
+            return 1;
+        }
+    }
+    if (entrees.count == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (entrees_uniques(&entrees, ".pas") != 0) return 1;
+    job_count = entrees.count;
+    jobs = calloc((size_t)job_count, sizeof(Job));
+    if (jobs == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int j = 0; j < job_count; ++j) jobs[j].source = entrees.paths[j];
+    if (mkdir(sortie, 0777) != 0 && errno != EEXIST) {
+        perror(sortie);
+        return 1;
+    }
+    if (nworkers > job_count) nworkers = job_count;
+
+    stats = calloc((size_t)nworkers, sizeof(PoolStats));
+    if (stats == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double t0 = pool_now();
+    if (pool_run(nworkers, job_count, compile_job, NULL, stats) != 0) return 1;
+    double seconds = pool_now() - t0;
+
+    char filename[4096];
+    snprintf(filename, sizeof(filename), "%s/resume.txt", sortie);
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) {
+        perror(filename);
+        return 1;
+    }
+    write_summary(file, seconds);
+    fclose(file);
+    write_summary(stdout, seconds);
+
+    free(stats);
+    int failed = 0;
+    for (int j = 0; j < job_count; ++j) failed |= jobs[j].status != 0;
+    return failed;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "module.h"
+
+/* ---------- writer ---------- */
+
+static int write_module(FILE *file, const VmProgram *prog, const char *const *names, int nnames) {
+    ModHeader header;
+    uint32_t pool_size = 0;
+
+    if (names == NULL) nnames = 0;
+    for (int a = 0; a < nnames; ++a) {
+        if (names[a] != NULL) pool_size += (uint32_t)strlen(names[a]) + 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MOD_MAGIC, 4);
+    header.version = MOD_VERSION;
+    header.instr_size = sizeof(Instr);
+    header.ordre = MOD_ORDRE;
+    header.count = (uint32_t)prog->count;
+    header.nvars = (uint32_t)prog->nvars;
+    header.max_stack = (uint32_t)prog->max_stack;
+    header.names = (uint32_t)nnames;
+    header.pool_size = pool_size;
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(prog->code, sizeof(Instr), (size_t)prog->count + 1, file) != (size_t)prog->count + 1)
+        return -1;
+
+    uint32_t offset = 0;
+    for (int a = 0; a < nnames; ++a) {
+        uint32_t entry = names[a] != NULL ? offset : MOD_NO_NAME;
+        if (names[a] != NULL) offset += (uint32_t)strlen(names[a]) + 1;
+        if (fwrite(&entry, sizeof(entry), 1, file) != 1) return -1;
+    }
+    for (int a = 0; a < nnames; ++a) {
+        if (names[a] != NULL && fwrite(names[a], 1, strlen(names[a]) + 1, file) != strlen(names[a]) + 1)
+            return -1;
+    }
+    return 0;
+}
+
+int module_write_file(const char *filename, const VmProgram *prog, const char *const *names, int nnames) {
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL) {
+        perror(filename);
+        return -1;
+    }
+    int status = write_module(file, prog, names, nnames);
+    if (fclose(file) != 0) status = -1;
+    if (status != 0) fprintf(stderr, "Error writing %s\n", filename);
+    return status;
+}
+
+/* ---------- loader ---------- */
+
+int module_open(Module *m, const char *filename) {
+    memset(m, 0, sizeof(*m));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror(filename);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ModHeader)) {
+        fprintf(stderr, "%s: not a compiled module\n", filename);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(filename);
+        return -1;
+    }
+    m->map = map;
+    m->map_size = (size_t)st.st_size;
+
+    const ModHeader *header = map;
+    if (memcmp(header->magic, MOD_MAGIC, 4) != 0 || header->ordre != MOD_ORDRE ||
+        header->version != MOD_VERSION || header->instr_size != sizeof(Instr)) {
+        fprintf(stderr, "%s: not a version %d compiled module for this machine\n", filename, MOD_VERSION);
+        module_close(m);
+        return -1;
+    }
+    /* 64-bit sums: no 32-bit field can overflow them */
+    uint64_t size = sizeof(ModHeader) + ((uint64_t)header->count + 1) * sizeof(Instr) +
+                    (uint64_t)header->names * sizeof(uint32_t) + header->pool_size;
+    const Instr *code = (const Instr *)(m->map + sizeof(ModHeader));
+    if (size != m->map_size || header->count >= INT32_MAX || header->nvars >= INT32_MAX ||
+        header->max_stack >= INT32_MAX || code[header->count].op != OP_HALTE ||
+        (header->pool_size > 0 && m->map[m->map_size - 1] != '\0')) {
+        fprintf(stderr, "%s: truncated compiled module\n", filename);
+        module_close(m);
+        return -1;
+    }
+
+    /* the interpreter only reads the code */
+    m->prog.code = (Instr *)code;
+    m->prog.count = (int)header->count;
+    m->prog.nvars = (int)header->nvars;
+    m->prog.max_stack = (int)header->max_stack;
+    m->names = (const uint32_t *)(code + header->count + 1);
+    m->name_count = header->names;
+    m->pool = (const char *)(m->names + m->name_count);
+    m->pool_size = header->pool_size;
+    if (vm_verify(&m->prog) != 0) {
+        fprintf(stderr, "%s: invalid code in compiled module\n", filename);
+        module_close(m);
+        return -1;
+    }
+    return 0;
+}
+
+const char *module_name(const Module *m, int address) {
+    if (address < 0 || (uint32_t)address >= m->name_count) return NULL;
+    uint32_t offset = m->names[address];
+    return offset < m->pool_size ? m->pool + offset : NULL;
+}
+
+void module_close(Module *m) {
+    if (m->map != NULL) munmap((void *)m->map, m->map_size);
+    memset(m, 0, sizeof(*m));
+}
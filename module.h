@@ -0,0 +1,71 @@
+#ifndef MODULE_H
+#define MODULE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vm.h"
+
+/*
+ * Compiled module: the backpatched stack code in the layout the
+ * interpreter runs, so that a program starts without parsing
+ * pile_code.txt or copying anything.
+ *
+ *   header  32 bytes          ModHeader
+ *   code    (count + 1) x 8   Instr, the last one the Halte vm_load() adds
+ *   debug   names x 4         pool offset of the name of each variable
+ *                             address, MOD_NO_NAME for none
+ *           pool_size         NUL-terminated names
+ *
+ * Integers are in the byte order of the machine that wrote the module;
+ * a machine of the other order refuses it. module_open() maps the file,
+ * checks the header and the section sizes, and verifies the code with
+ * vm_verify(), in one pass over it: a module may come from anywhere, and
+ * the run loop trusts its opcodes, jumps, addresses and stack depth.
+ * vm_run() then executes the code where it lies; only the variables and
+ * the operand stack are allocated, by vm_init(), with the sizes of the
+ * header. vm_load() on its code gives the JIT and the register machine
+ * the stack heights they need.
+ */
+
+#define MOD_MAGIC "PMOD"
+#define MOD_VERSION 2
+#define MOD_ORDRE 0x01020304u
+#define MOD_NO_NAME 0xFFFFFFFFu
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t instr_size;
+    uint32_t ordre;         /* MOD_ORDRE, as written */
+    uint32_t count;         /* instructions, without the final Halte */
+    uint32_t nvars;
+    uint32_t max_stack;
+    uint32_t names;         /* entries of the debug section, 0 for none */
+    uint32_t pool_size;
+} ModHeader;
+
+typedef struct {
+    const unsigned char *map;
+    size_t map_size;
+    VmProgram prog;         /* code in the map; for vm_init() */
+    const uint32_t *names;
+    const char *pool;
+    uint32_t name_count;
+    uint32_t pool_size;
+} Module;
+
+/* writes prog, loaded by vm_load(); names[a] is the name of the variable
+   at address a (nnames entries, NULL where there is none), or names is
+   NULL for a module without debug section. Returns 0, or -1 with a
+   message on stderr. */
+int module_write_file(const char *filename, const VmProgram *prog, const char *const *names, int nnames);
+
+/* maps and verifies the file; returns 0 on success, -1 with a message
+   on stderr */
+int module_open(Module *m, const char *filename);
+/* name of the variable at address, NULL if the debug section has none */
+const char *module_name(const Module *m, int address);
+void module_close(Module *m);
+
+#endif
@@ -0,0 +1,48 @@
+/* Generated by gen_mots_cles.c - do not edit. */
+#ifndef MOTS_CLES_H
+#define MOTS_CLES_H
+
+#include "analyseur_lex.h"
+
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 7
+#define KEYWORD_HASH(c0, c1, len) (((unsigned)(c0) * 1u + (unsigned)(c1) * 4u + (unsigned)(len)) & 31u)
+
+typedef struct {
+    char text[8];
+    unsigned char length;
+    unsigned char type;
+} KeywordSlot;
+
+static const KeywordSlot keyword_table[32] = {
+    [ 0] = { "end", 3, END },
+    [ 2] = { "do", 2, DO },
+    [ 3] = { "if", 2, IF },
+    [ 4] = { "write", 5, WRITE },
+    [ 6] = { "writeln", 7, WRITELN },
+    [ 7] = { "char", 4, CHAR },
+    [ 8] = { "integer", 7, INTEGER },
+    [10] = { "read", 4, READ },
+    [12] = { "readln", 6, READLN },
+    [24] = { "then", 4, THEN },
+    [25] = { "else", 4, ELSE },
+    [27] = { "begin", 5, BEGIN },
+    [28] = { "while", 5, WHILE },
+    [29] = { "var", 3, VAR },
+    [31] = { "program", 7, PROGRAM },
+};
+
+/* Keyword type of an identifier made of letters and digits, compared
+   case-insensitively in place (c | 0x20 folds A-Z and keeps digits). */
+static inline int keyword_lookup(const char *s, unsigned length, TokenType *type) {
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return 0;
+    const KeywordSlot *k = &keyword_table[KEYWORD_HASH(s[0] | 0x20, s[1] | 0x20, length)];
+    if (k->length != length) return 0;
+    for (unsigned i = 0; i < length; ++i) {
+        if ((s[i] | 0x20) != k->text[i]) return 0;
+    }
+    *type = (TokenType)k->type;
+    return 1;
+}
+
+#endif
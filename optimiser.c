@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "code.h"
+
+/*
+ * Constant folding and algebraic simplification, in place. Children come
+ * before their parents in ast_nodes, so a single forward scan sees every
+ * operand already simplified. A node that reduces to one of its operands
+ * becomes a copy of it; the nodes left unreferenced are simply never
+ * visited again.
+ */
+
+static AstNode *node(int i) {
+    return &ast_nodes[i];
+}
+
+static int is_const(int i) {
+    return ast_nodes[i].kind == N_CONST;
+}
+
+static void make_const(int i, int32_t value) {
+    AstNode *n = node(i);
+    n->kind = N_CONST;
+    n->value = value;
+    n->a = n->b = n->c = -1;
+    n->may_trap = 0;
+}
+
+/* k if value == 2^k with 1 <= k <= 30, else 0 */
+static int log2_exact(int32_t value) {
+    if (value < 2 || (value & (value - 1)) != 0) return 0;
+    return __builtin_ctz((unsigned)value);
+}
+
+/* node i becomes e + k, reusing its constant operand cst for k; an
+   enclosing e' +/- c folds in, and negative constants are written as
+   subtractions */
+static void add_const(int i, int e, int cst, int32_t k) {
+    const AstNode *inner = node(e);
+    if ((inner->kind == N_ADD || inner->kind == N_SUB) && is_const(inner->b)) {
+        uint32_t c = (uint32_t)node(inner->b)->value;
+        if (inner->kind == N_SUB) c = 0u - c;
+        k = (int32_t)(c + (uint32_t)k);
+        e = inner->a;
+    }
+    if (k == 0) {
+        ast_nodes[i] = ast_nodes[e];
+        return;
+    }
+    AstNode *n = node(i);
+    n->a = e;
+    n->b = cst;
+    n->may_trap = node(e)->may_trap;
+    if (k < 0 && k != INT32_MIN) {
+        n->kind = N_SUB;
+        node(cst)->value = -k;
+    } else {
+        n->kind = N_ADD;
+        node(cst)->value = k;
+    }
+}
+
+static void simplify(int i) {
+    AstNode *n = node(i);
+    int l = n->a, r = n->b;
+
+    if (is_const(l) && is_const(r)) {
+        uint32_t a = (uint32_t)node(l)->value, b = (uint32_t)node(r)->value;
+        switch (n->kind) {
+            case N_ADD: make_const(i, (int32_t)(a + b)); return;
+            case N_SUB: make_const(i, (int32_t)(a - b)); return;
+            case N_MUL: make_const(i, (int32_t)(a * b)); return;
+            case N_DIV:
+                if (b == 0) break;      /* left for the run-time error */
+                if (node(r)->value == -1) make_const(i, (int32_t)(0u - a));
+                else make_const(i, node(l)->value / node(r)->value);
+                return;
+            case N_MOD:
+                if (b == 0) break;
+                make_const(i, node(r)->value == -1 ? 0 : node(l)->value % node(r)->value);
+                return;
+        }
+    }
+
+    /* constants go to the right of + and *, where the rules below and
+       the peephole Incr pattern look for them */
+    if ((n->kind == N_ADD || n->kind == N_MUL) && is_const(l)) {
+        n->a = r;
+        n->b = l;
+        l = n->a;
+        r = n->b;
+    }
+
+    if (is_const(r)) {
+        int32_t c = node(r)->value;
+        switch (n->kind) {
+            case N_ADD:
+                add_const(i, l, r, c);
+                return;
+            case N_SUB:
+                add_const(i, l, r, (int32_t)(0u - (uint32_t)c));
+                return;
+            case N_MUL:
+                if (c == 1) {
+                    ast_nodes[i] = ast_nodes[l];
+                    return;
+                }
+                if (c == 0 && !node(l)->may_trap) {
+                    make_const(i, 0);
+                    return;
+                }
+                if (log2_exact(c)) {
+                    n->kind = N_SHL;
+                    n->value = log2_exact(c);
+                    n->b = -1;
+                }
+                break;
+            case N_DIV:
+                if (c == 1) {
+                    ast_nodes[i] = ast_nodes[l];
+                    return;
+                }
+                if (log2_exact(c)) {
+                    n->kind = N_SHR;
+                    n->value = log2_exact(c);
+                    n->b = -1;
+                }
+                break;
+            case N_MOD:
+                if ((c == 1 || c == -1) && !node(l)->may_trap) {
+                    make_const(i, 0);
+                    return;
+                }
+                break;
+        }
+    }
+
+    n->may_trap = node(n->a)->may_trap;
+    if (n->b >= 0) n->may_trap |= node(n->b)->may_trap;
+    if ((n->kind == N_DIV || n->kind == N_MOD) && (!is_const(n->b) || node(n->b)->value == 0)) n->may_trap = 1;
+}
+
+/* a comparison of two constants is the constant 0 or 1 */
+static void simplify_compare(int i) {
+    AstNode *n = node(i);
+    if (!is_const(n->a) || !is_const(n->b)) {
+        n->may_trap = node(n->a)->may_trap | node(n->b)->may_trap;
+        return;
+    }
+    int32_t x = node(n->a)->value, y = node(n->b)->value;
+    int holds;
+    switch (n->op) {
+        case OP_COMPARER_SUP:       holds = x > y; break;
+        case OP_COMPARER_INF:       holds = x < y; break;
+        case OP_COMPARER_EGAL:      holds = x == y; break;
+        case OP_COMPARER_SUP_EGAL:  holds = x >= y; break;
+        case OP_COMPARER_INF_EGAL:  holds = x <= y; break;
+        default:                    holds = x != y; break;
+    }
+    make_const(i, holds);
+}
+
+/* a shift of a constant, once propagation has made its operand one */
+static void simplify_shift(int i) {
+    AstNode *n = node(i);
+    if (!is_const(n->a)) {
+        n->may_trap = node(n->a)->may_trap;
+        return;
+    }
+    int32_t x = node(n->a)->value;
+    if (n->kind == N_SHL) make_const(i, (int32_t)((uint32_t)x << n->value));
+    else make_const(i, x / (1 << n->value));
+}
+
+void simplifier(int i) {
+    switch (ast_nodes[i].kind) {
+        case N_ADD:
+        case N_SUB:
+        case N_MUL:
+        case N_DIV:
+        case N_MOD:
+            simplify(i);
+            break;
+        case N_SHL:
+        case N_SHR:
+            simplify_shift(i);
+            break;
+        case N_COMPARE:
+            simplify_compare(i);
+            break;
+        default:
+            break;
+    }
+}
+
+void optimiser(int root) {
+    for (int i = 0; i <= root; ++i) simplifier(i);
+}
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erreur.h"
+#include "peephole.h"
+
+_Thread_local int peephole_counts[PH_COUNT];
+
+static const char *const rule_names[PH_COUNT] = {
+    [PH_SAUT_SUIVANT] = "saut-suivant",
+    [PH_SAUT_DE_SAUT] = "saut-de-saut",
+    [PH_AFFECTATION_INUTILE] = "affectation-inutile",
+    [PH_STOCKAGE_ECRASE] = "stockage-ecrase",
+    [PH_INCR] = "incr",
+    [PH_ETIQ_INUTILE] = "etiquette-inutile"
+};
+
+const char *peephole_rule_name(PeepholeRule rule) {
+    return (unsigned)rule < PH_COUNT ? rule_names[rule] : "?";
+}
+
+int peephole_parse_rules(const char *list, unsigned *rules) {
+    *rules = 0;
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        if (len == 6 && strncmp(list, "toutes", 6) == 0) {
+            *rules = PH_TOUTES;
+        } else if (!(len == 6 && strncmp(list, "aucune", 6) == 0)) {
+            int r;
+            for (r = 0; r < PH_COUNT; ++r) {
+                if (strlen(rule_names[r]) == len && strncmp(list, rule_names[r], len) == 0) break;
+            }
+            if (r == PH_COUNT) return -1;
+            *rules |= 1u << r;
+        }
+        list += len;
+        if (*list == ',') list++;
+    }
+    return 0;
+}
+
+/* ---------- labels ---------- */
+
+/* position of each label's Etiq marker, the instruction a jump to it
+   lands on (count if none), and number of jumps to it */
+static _Thread_local int *label_pos = NULL;
+static _Thread_local int *label_land = NULL;
+static _Thread_local int *label_refs = NULL;
+static _Thread_local int *final_label = NULL;     /* per label, filled by thread_jumps() and drop_jumps_to_next() */
+static _Thread_local int *label_path = NULL;
+static _Thread_local int label_capacity = 0;
+
+static int index_labels(const Instr *code, int count) {
+    int max_label = -1;
+    for (int i = 0; i < count; ++i) {
+        if ((code[i].op == OP_ETIQ || opcode_is_jump(code[i].op)) && code[i].arg > max_label)
+            max_label = code[i].arg;
+    }
+    if (max_label >= label_capacity) {
+        int capacity = label_capacity ? label_capacity : 64;
+        while (capacity <= max_label) capacity *= 2;
+        int *pos = realloc(label_pos, (size_t)capacity * sizeof(int));
+        if (pos != NULL) label_pos = pos;
+        int *land = realloc(label_land, (size_t)capacity * sizeof(int));
+        if (land != NULL) label_land = land;
+        int *refs = realloc(label_refs, (size_t)capacity * sizeof(int));
+        if (refs != NULL) label_refs = refs;
+        int *final = realloc(final_label, (size_t)capacity * sizeof(int));
+        if (final != NULL) final_label = final;
+        int *path = realloc(label_path, (size_t)capacity * sizeof(int));
+        if (path != NULL) label_path = path;
+        if (pos == NULL || land == NULL || refs == NULL || final == NULL || path == NULL) {
+            erreur("Code memory overflow");
+        }
+        label_capacity = capacity;
+    }
+    for (int l = 0; l <= max_label; ++l) {
+        label_pos[l] = -1;
+        label_land[l] = count;
+        label_refs[l] = 0;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (code[i].arg < 0) continue;      /* malformed: left for backpatch() to report */
+        if (code[i].op == OP_ETIQ) label_pos[code[i].arg] = i;
+        else if (opcode_is_jump(code[i].op)) label_refs[code[i].arg]++;
+    }
+    /* backward, so a run of labels shares one landing */
+    for (int i = count - 1, next = count; i >= 0; --i) {
+        if (code[i].op != OP_ETIQ) next = i;
+        else if (code[i].arg >= 0 && label_pos[code[i].arg] == i) label_land[code[i].arg] = next;
+    }
+    return max_label + 1;
+}
+
+/* the instruction a jump to label lands on, or count */
+static int landing(int count, int label) {
+    return label < 0 ? count : label_land[label];
+}
+
+/* ---------- rules ---------- */
+
+static int rule_on(unsigned rules, PeepholeRule rule) {
+    return (rules >> rule) & 1;
+}
+
+static int fire(PeepholeRule rule) {
+    peephole_counts[rule]++;
+    return 1;
+}
+
+#define UNSEEN  (-2)
+#define ON_PATH (-3)
+
+/* The label a jump to l really reaches once Aller chains are followed.
+   Results are memoized over the whole chain, so threading is linear even
+   for the long chains nested if statements produce; labels on a cycle
+   of Aller (an empty infinite loop) and those leading into it are left
+   alone. */
+static int final_target(const Instr *code, int count, int l) {
+    int n = 0, cur = l, result;
+    for (;;) {
+        if (final_label[cur] >= 0) {
+            result = final_label[cur];
+            break;
+        }
+        if (final_label[cur] == ON_PATH) {
+            result = -1;
+            break;
+        }
+        final_label[cur] = ON_PATH;
+        label_path[n++] = cur;
+        int t = landing(count, cur);
+        if (t == count || code[t].op != OP_ALLER || code[t].arg < 0 || code[t].arg == cur) {
+            result = cur;
+            break;
+        }
+        cur = code[t].arg;
+    }
+    for (int k = 0; k < n; ++k) final_label[label_path[k]] = result == -1 ? label_path[k] : result;
+    return final_label[l];
+}
+
+static int thread_jumps(Instr *code, int count, int nlabels) {
+    int changed = 0;
+    for (int l = 0; l < nlabels; ++l) final_label[l] = UNSEEN;
+    /* all chains are measured before any jump changes; retargeting
+       never changes where a jump ends up, so the results stay valid */
+    for (int l = 0; l < nlabels; ++l) final_target(code, count, l);
+
+    for (int i = 0; i < count; ++i) {
+        if (!opcode_is_jump(code[i].op) || code[i].arg < 0) continue;
+        int target = final_label[code[i].arg];
+        if (target != code[i].arg) {
+            code[i].arg = target;
+            changed = fire(PH_SAUT_DE_SAUT);
+        }
+
+        int t = landing(count, target);
+        if (code[i].op == OP_ALLER && t < count && code[t].op == OP_HALTE) {
+            code[i].op = OP_HALTE;
+            code[i].arg = 0;
+            changed = fire(PH_SAUT_DE_SAUT);
+        }
+    }
+    return changed;
+}
+
+/* Drops each Aller whose target is reached by falling through anyway.
+   Scanning backward, next is where control lands after the instruction
+   at i once the jumps already dropped are gone, so a run of such jumps
+   (the ends of nested ifs) goes in one pass. */
+static int drop_jumps_to_next(Instr *code, int *count) {
+    int n = *count, kept = n, next = n, changed = 0;
+    for (int i = n - 1; i >= 0; --i) {
+        Instr instr = code[i];
+        if (instr.op == OP_ETIQ) {
+            if (instr.arg >= 0) final_label[instr.arg] = next;
+        } else if (instr.op == OP_ALLER && instr.arg >= 0 && label_pos[instr.arg] > i &&
+                   final_label[instr.arg] == next) {
+            changed = fire(PH_SAUT_SUIVANT);
+            continue;
+        } else {
+            next = kept - 1;
+        }
+        code[--kept] = instr;
+    }
+    memmove(code, code + kept, (size_t)(n - kept) * sizeof(Instr));
+    *count = n - kept;
+    return changed;
+}
+
+/* Valeurd or Empiler: one push with no side effect */
+static int simple_push(Instr instr) {
+    return instr.op == OP_VALEURD || instr.op == OP_EMPILER;
+}
+
+/* rewrites code[0..*count) in one left-to-right sweep */
+static int sweep(Instr *code, int *count, unsigned rules) {
+    int n = *count, kept = 0, changed = 0;
+
+    for (int i = 0; i < n; ) {
+        const Instr *c = &code[i];
+        int left = n - i;
+
+        if (rule_on(rules, PH_INCR) && left >= 5 && c[0].op == OP_VALEURG && c[4].op == OP_AFFECTER) {
+            int32_t a = c[0].arg;
+            int64_t delta = INT64_MAX;
+            if (c[1].op == OP_VALEURD && c[1].arg == a && c[2].op == OP_EMPILER) {
+                if (c[3].op == OP_ADD) delta = c[2].arg;
+                else if (c[3].op == OP_SUB) delta = -(int64_t)c[2].arg;
+            } else if (c[1].op == OP_EMPILER && c[2].op == OP_VALEURD && c[2].arg == a && c[3].op == OP_ADD) {
+                delta = c[1].arg;
+            }
+            if (delta >= INT16_MIN && delta <= INT16_MAX) {
+                code[kept].op = OP_INCR;
+                code[kept].arg = a;
+                code[kept].arg2 = (int16_t)delta;
+                kept++;
+                changed = fire(PH_INCR);
+                i += 5;
+                continue;
+            }
+        }
+
+        if (rule_on(rules, PH_AFFECTATION_INUTILE) && left >= 3 && c[0].op == OP_VALEURG &&
+            c[1].op == OP_VALEURD && c[1].arg == c[0].arg && c[2].op == OP_AFFECTER) {
+            changed = fire(PH_AFFECTATION_INUTILE);
+            i += 3;
+            continue;
+        }
+
+        /* the second right-hand side must not read x: Lire is fine, the
+           first store's value is lost either way */
+        if (rule_on(rules, PH_STOCKAGE_ECRASE) && left >= 6 && c[0].op == OP_VALEURG &&
+            simple_push(c[1]) && c[2].op == OP_AFFECTER &&
+            c[3].op == OP_VALEURG && c[3].arg == c[0].arg && c[5].op == OP_AFFECTER &&
+            (c[4].op == OP_EMPILER || c[4].op == OP_LIRE || (c[4].op == OP_VALEURD && c[4].arg != c[0].arg))) {
+            changed = fire(PH_STOCKAGE_ECRASE);
+            i += 3;
+            continue;
+        }
+
+        code[kept++] = code[i++];
+    }
+    *count = kept;
+    return changed;
+}
+
+static int drop_unused_labels(Instr *code, int *count) {
+    int kept = 0, changed = 0;
+    for (int i = 0; i < *count; ++i) {
+        if (code[i].op == OP_ETIQ && code[i].arg >= 0 && label_refs[code[i].arg] == 0) {
+            changed = fire(PH_ETIQ_INUTILE);
+            continue;
+        }
+        code[kept++] = code[i];
+    }
+    *count = kept;
+    return changed;
+}
+
+void peephole(Instr *code, int *count, unsigned rules) {
+    int changed;
+    do {
+        changed = 0;
+        int nlabels = index_labels(code, *count);
+        if (rule_on(rules, PH_SAUT_DE_SAUT)) changed |= thread_jumps(code, *count, nlabels);
+        if (rule_on(rules, PH_SAUT_SUIVANT)) {
+            index_labels(code, *count);
+            changed |= drop_jumps_to_next(code, count);
+        }
+        index_labels(code, *count);
+        changed |= sweep(code, count, rules);
+        if (rule_on(rules, PH_ETIQ_INUTILE)) {
+            index_labels(code, *count);
+            changed |= drop_unused_labels(code, count);
+        }
+    } while (changed);
+}
+
+void peephole_print_stats(FILE *file) {
+    for (int r = 0; r < PH_COUNT; ++r) {
+        fprintf(file, "peephole %-20s %d\n", rule_names[r], peephole_counts[r]);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdio.h>
+
+#include "code.h"
+
+/*
+ * Peephole optimizer over the generated code, run before backpatch():
+ * label markers are still in the stream, so a pattern never spans a jump
+ * target and deleting an instruction needs no jump renumbering. Rules
+ * are applied until none fires.
+ */
+typedef enum {
+    PH_SAUT_SUIVANT,        /* Aller to the instruction that follows anyway */
+    PH_SAUT_DE_SAUT,        /* jump to an Aller takes its target; Aller to Halte is Halte */
+    PH_AFFECTATION_INUTILE, /* x := x */
+    PH_STOCKAGE_ECRASE,     /* x := a immediately followed by x := b */
+    PH_INCR,                /* x := x + c, x := c + x, x := x - c -> Incr x c */
+    PH_ETIQ_INUTILE,        /* label no jump refers to any more */
+    PH_COUNT
+} PeepholeRule;
+
+#define PH_TOUTES ((1u << PH_COUNT) - 1)
+
+/* times each rule fired, summed over every peephole() call of the
+   thread */
+extern _Thread_local int peephole_counts[PH_COUNT];
+
+const char *peephole_rule_name(PeepholeRule rule);
+/* parses a comma-separated list of rule names ("toutes", "aucune" are
+   accepted too); returns -1 on an unknown name */
+int peephole_parse_rules(const char *list, unsigned *rules);
+
+/* optimizes code[0..*count) in place with the rules of the mask */
+void peephole(Instr *code, int *count, unsigned rules);
+void peephole_print_stats(FILE *file);
+
+#endif
@@ -0,0 +1,124 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "pool.h"
+
+/* Each worker owns the jobs [first, last) of the list: it takes them from
+   the front, thieves take them from the back. */
+typedef struct {
+    pthread_mutex_t lock;
+    int first, last;
+    PoolStats stats;
+} Queue;
+
+typedef struct {
+    Queue *queues;
+    int nworkers;
+    void (*job)(void *data, int w, int j);
+    void *data;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int w;
+} Worker;
+
+/* next job of worker w: from its own queue, else stolen; -1 when every
+   queue is empty */
+static int next_job(Pool *pool, int w) {
+    Queue *own = &pool->queues[w];
+
+    pthread_mutex_lock(&own->lock);
+    int j = own->first < own->last ? own->first++ : -1;
+    pthread_mutex_unlock(&own->lock);
+    if (j >= 0) return j;
+
+    for (int k = 1; k < pool->nworkers; ++k) {
+        Queue *victim = &pool->queues[(w + k) % pool->nworkers];
+        int first = 0, last = 0;
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->last - victim->first;
+        if (left > 0) {
+            /* the back half, rounded up so that a last job is taken too */
+            last = victim->last;
+            first = last - (left + 1) / 2;
+            victim->last = first;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (last > first) {
+            pthread_mutex_lock(&own->lock);
+            own->first = first + 1;
+            own->last = last;
+            own->stats.steals++;
+            pthread_mutex_unlock(&own->lock);
+            return first;
+        }
+    }
+    return -1;
+}
+
+static void *worker(void *arg) {
+    Worker *self = arg;
+    Pool *pool = self->pool;
+    Queue *own = &pool->queues[self->w];
+
+    for (int j; (j = next_job(pool, self->w)) >= 0;) {
+        double t0 = pool_now();
+        pool->job(pool->data, self->w, j);
+        own->stats.done++;
+        own->stats.busy += pool_now() - t0;
+    }
+    return NULL;
+}
+
+int pool_run(int nworkers, int count, void (*job)(void *data, int w, int j), void *data, PoolStats *stats) {
+    Pool pool = { NULL, nworkers, job, data };
+    int started = 1;
+
+    pool.queues = calloc((size_t)nworkers, sizeof(Queue));
+    Worker *workers = malloc((size_t)nworkers * sizeof(Worker));
+    pthread_t *threads = malloc((size_t)nworkers * sizeof(pthread_t));
+    if (pool.queues == NULL || workers == NULL || threads == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        free(pool.queues);
+        free(workers);
+        free(threads);
+        return -1;
+    }
+    for (int w = 0; w < nworkers; ++w) {
+        pthread_mutex_init(&pool.queues[w].lock, NULL);
+        pool.queues[w].first = (int)((long long)count * w / nworkers);
+        pool.queues[w].last = (int)((long long)count * (w + 1) / nworkers);
+        workers[w].pool = &pool;
+        workers[w].w = w;
+    }
+
+    /* a worker that cannot start leaves its queue to the others, who
+       steal it like any other */
+    for (int w = 1; w < nworkers; ++w, ++started) {
+        if (pthread_create(&threads[w], NULL, worker, &workers[w]) != 0) {
+            fprintf(stderr, "Cannot start thread %d\n", w);
+            break;
+        }
+    }
+    worker(&workers[0]);
+    for (int w = 1; w < started; ++w) pthread_join(threads[w], NULL);
+
+    for (int w = 0; w < nworkers; ++w) {
+        if (stats != NULL) stats[w] = pool.queues[w].stats;
+        pthread_mutex_destroy(&pool.queues[w].lock);
+    }
+    free(pool.queues);
+    free(workers);
+    free(threads);
+    return 0;
+}
+
+double pool_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
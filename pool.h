@@ -0,0 +1,29 @@
+#ifndef POOL_H
+#define POOL_H
+
+/*
+ * Work-stealing thread pool for a fixed list of jobs, shared by the batch
+ * tools (lot.c, executions.c). The jobs are numbered 0 .. count - 1 and
+ * split into contiguous shares, one queue per worker, so that a worker
+ * takes its jobs in list order. A worker takes jobs from the front of
+ * its own queue; once it is empty, it steals the back half of another
+ * queue, until every queue is empty.
+ */
+
+typedef struct {
+    int done;           /* jobs run by the worker */
+    int steals;
+    double busy;        /* seconds spent in them */
+} PoolStats;
+
+/* runs job(data, w, j) for every j on nworkers threads, w being the
+   worker (0 .. nworkers - 1, the calling thread is worker 0); stats gets
+   nworkers entries, or is NULL. A thread that cannot start is reported
+   on stderr and its jobs are run by the others. Returns 0, or -1 when
+   out of memory (no job has run then). */
+int pool_run(int nworkers, int count, void (*job)(void *data, int w, int j), void *data, PoolStats *stats);
+
+/* monotonic clock, in seconds */
+double pool_now(void);
+
+#endif
@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ast.h"
+#include "erreur.h"
+#include "symtab.h"
+
+static int32_t address_of(int name) {
+    int idx = symtab_get_index(name);
+    if (idx == -1 || symtab[idx].declared == 0) {
+        erreur("Error: Undeclared identifier '%s'", intern_name(name));
+    }
+    return symtab[idx].address;
+}
+
+/* Enters the declarations in the symbol table and replaces every variable
+   name by its address. The tree is in post-order and the declarations
+   were parsed first, so one scan sees every declaration before any use.
+   The parser already refused undeclared names, in source order, also
+   in the statements incremental.h reparses; this check is a guard. */
+void sema(int root) {
+    for (int i = 0; i <= root; ++i) {
+        AstNode *n = &ast_nodes[i];
+        switch (n->kind) {
+            case N_DECL:
+                for (int k = 0; k < n->value; ++k) symtab_add(ast_lists[n->a + k]);
+                for (int k = 0; k < n->value; ++k) symtab_set_type(ast_lists[n->a + k], (TokenType)n->op);
+                break;
+            case N_ASSIGN:
+            case N_READ:
+            case N_WRITE:
+            case N_VAR:
+                n->value = address_of(n->value);
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,478 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "analyseur_synt.h"
+#include "code.h"
+#include "dataflow.h"
+#include "peephole.h"
+#include "serveur.h"
+#include "symtab.h"
+
+/* Long-lived compile server (see serveur.h for the protocol).
+   Usage: serveur [-s socket] [-j N] [-c entrees]
+   Each connection gets a thread of its own, which reads its requests
+   and answers them, so an idle or long-lived connection holds up no
+   other. A miss is compiled by one of N compiler threads (default 4),
+   each keeping its compiler context (analyseur_synt.h) from one request
+   to the next; the connection thread waits for it.
+   Answers are cached by a hash of the options and the source, up to
+   the given number of entries (default 4096), the oldest going first.
+   A hit is a lookup and a copy, without compiling. */
+
+enum { TEXTE_CODE, TEXTE_SYMTAB, TEXTE_ETIQUETTES, TEXTE_MESSAGES, TEXTES };
+
+typedef struct {
+    int optimise;
+    unsigned passes;
+    unsigned rules;
+} Options;
+
+typedef struct Entree {
+    uint64_t hash;
+    Options options;
+    char *source;
+    size_t size;
+    int status;
+    char *texte;                /* the four texts, back to back */
+    size_t longueur[TEXTES];
+    struct Entree *suivante;    /* next entry of the same bucket */
+} Entree;
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static Entree **buckets = NULL;
+static unsigned bucket_mask = 0;
+static Entree **ordre = NULL;   /* entries in insertion order, circular */
+static int capacite = 4096;
+static int premiere = 0;
+static int entrees = 0;
+static long long requetes = 0, hits = 0;
+static long long octets = 0;
+
+static const char *chemin = SERVEUR_SOCKET;
+
+/* FNV-1a, 64 bits */
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211u;
+    }
+    return h;
+}
+
+static uint64_t hash_request(const Options *o, const char *source, size_t size) {
+    uint64_t h = 14695981039346656037u;
+    h = hash_bytes(h, &o->optimise, sizeof(o->optimise));
+    h = hash_bytes(h, &o->passes, sizeof(o->passes));
+    h = hash_bytes(h, &o->rules, sizeof(o->rules));
+    return hash_bytes(h, source, size);
+}
+
+static size_t total(const Entree *e) {
+    size_t n = 0;
+    for (int t = 0; t < TEXTES; ++t) n += e->longueur[t];
+    return n;
+}
+
+/* caller holds cache_lock */
+static Entree *lookup(uint64_t hash, const Options *o, const char *source, size_t size) {
+    for (Entree *e = buckets[hash & bucket_mask]; e != NULL; e = e->suivante) {
+        if (e->hash == hash && e->size == size && e->options.optimise == o->optimise &&
+            e->options.passes == o->passes && e->options.rules == o->rules &&
+            memcmp(e->source, source, size) == 0)
+            return e;
+    }
+    return NULL;
+}
+
+static void free_entree(Entree *e) {
+    free(e->source);
+    free(e->texte);
+    free(e);
+}
+
+/* takes e; caller holds cache_lock */
+static void insert(Entree *e) {
+    if (entrees == capacite) {
+        Entree *old = ordre[premiere];
+        Entree **p = &buckets[old->hash & bucket_mask];
+        while (*p != old) p = &(*p)->suivante;
+        *p = old->suivante;
+        octets -= (long long)(old->size + total(old));
+        free_entree(old);
+        premiere = (premiere + 1) % capacite;
+        entrees--;
+    }
+    ordre[(premiere + entrees) % capacite] = e;
+    entrees++;
+    e->suivante = buckets[e->hash & bucket_mask];
+    buckets[e->hash & bucket_mask] = e;
+    octets += (long long)(e->size + total(e));
+}
+
+/* compiles source in the calling thread's context into a new entry */
+static Entree *compile_entree(const Options *o, const char *source, size_t size, uint64_t hash) {
+    Compilation c;
+    FILE *stream[TEXTES];
+    char *texte[TEXTES];
+    size_t longueur[TEXTES];
+
+    compilation_init(&c, "requete");
+    c.text = source;
+    c.size = size;
+    c.optimise = o->optimise;
+    c.passes = o->passes;
+    c.rules = o->rules;
+    int status = compiler(&c) == 0 ? 0 : 1;
+
+    for (int t = 0; t < TEXTES; ++t) {
+        stream[t] = open_memstream(&texte[t], &longueur[t]);
+        if (stream[t] == NULL) {
+            while (--t >= 0) {
+                fclose(stream[t]);
+                free(texte[t]);
+            }
+            return NULL;
+        }
+    }
+    if (status == 0) {
+        write_code(stream[TEXTE_CODE]);
+        write_symtab(stream[TEXTE_SYMTAB]);
+        write_labels(stream[TEXTE_ETIQUETTES]);
+    } else {
+        fprintf(stream[TEXTE_MESSAGES], "%s\n", c.erreur);
+    }
+    for (int t = 0; t < TEXTES; ++t) fclose(stream[t]);
+
+    Entree *e = calloc(1, sizeof(Entree));
+    size_t n = 0;
+    for (int t = 0; t < TEXTES; ++t) n += longueur[t];
+    if (e != NULL) {
+        e->source = malloc(size ? size : 1);
+        e->texte = malloc(n ? n : 1);
+    }
+    if (e == NULL || e->source == NULL || e->texte == NULL) {
+        if (e != NULL) free_entree(e);
+        e = NULL;
+    } else {
+        e->hash = hash;
+        e->options = *o;
+        memcpy(e->source, source, size);
+        e->size = size;
+        e->status = status;
+        n = 0;
+        for (int t = 0; t < TEXTES; ++t) {
+            memcpy(e->texte + n, texte[t], longueur[t]);
+            e->longueur[t] = longueur[t];
+            n += longueur[t];
+        }
+    }
+    for (int t = 0; t < TEXTES; ++t) free(texte[t]);
+    return e;
+}
+
+/* the options after the length on a compiler line; -1 on a bad one,
+   with the message in out */
+static int parse_options(char *words, Options *o, FILE *out) {
+    o->optimise = 1;
+    o->passes = DF_TOUTES;
+    o->rules = PH_TOUTES;
+    char *rest;
+    for (char *w = strtok_r(words, " \n", &rest); w != NULL; w = strtok_r(NULL, " \n", &rest)) {
+        if (strcmp(w, "-O0") == 0) {
+            o->optimise = 0;
+            o->rules = 0;
+        } else if (strcmp(w, "--dataflow") == 0 && (w = strtok_r(NULL, " \n", &rest)) != NULL) {
+            if (dataflow_parse_passes(w, &o->passes) != 0) {
+                fprintf(out, "Unknown dataflow pass in '%s'\n", w);
+                return -1;
+            }
+        } else if (strcmp(w, "--peephole") == 0 && (w = strtok_r(NULL, " \n", &rest)) != NULL) {
+            if (peephole_parse_rules(w, &o->rules) != 0) {
+                fprintf(out, "Unknown peephole rule in '%s'\n", w);
+                return -1;
+            }
+        } else {
+            fprintf(out, "Unknown option '%s'\n", w);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void reply(FILE *out, int status, int cache, const size_t longueur[TEXTES], const char *texte) {
+    size_t n = 0;
+    fprintf(out, "%d %d %zu %zu %zu %zu\n", status, cache,
+            longueur[0], longueur[1], longueur[2], longueur[3]);
+    for (int t = 0; t < TEXTES; ++t) n += longueur[t];
+    fwrite(texte, 1, n, out);
+}
+
+/* a miss waiting for a compiler thread, on the stack of its connection */
+typedef struct Travail {
+    const Options *options;
+    const char *source;
+    size_t size;
+    uint64_t hash;
+    Entree *entree;             /* the answer, NULL when out of memory */
+    int fini;
+    struct Travail *suivant;
+} Travail;
+
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t file_attente = PTHREAD_COND_INITIALIZER;  /* a job queued */
+static pthread_cond_t file_fini = PTHREAD_COND_INITIALIZER;     /* a job done */
+static Travail *tete = NULL, *queue = NULL;
+
+static void *compilateur(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&file_lock);
+        while (tete == NULL) pthread_cond_wait(&file_attente, &file_lock);
+        Travail *t = tete;
+        tete = t->suivant;
+        if (tete == NULL) queue = NULL;
+        pthread_mutex_unlock(&file_lock);
+
+        Entree *e = compile_entree(t->options, t->source, t->size, t->hash);
+
+        pthread_mutex_lock(&file_lock);
+        t->entree = e;
+        t->fini = 1;
+        pthread_cond_broadcast(&file_fini);
+        pthread_mutex_unlock(&file_lock);
+    }
+    return NULL;
+}
+
+/* compiles on a compiler thread, in the order of the requests */
+static Entree *compile_attente(const Options *o, const char *source, size_t size, uint64_t hash) {
+    Travail t = { o, source, size, hash, NULL, 0, NULL };
+
+    pthread_mutex_lock(&file_lock);
+    if (queue != NULL) queue->suivant = &t;
+    else tete = &t;
+    queue = &t;
+    pthread_cond_signal(&file_attente);
+    while (!t.fini) pthread_cond_wait(&file_fini, &file_lock);
+    pthread_mutex_unlock(&file_lock);
+    return t.entree;
+}
+
+/* answers the requests of one connection until it closes */
+static void serve(int fd) {
+    FILE *in = fdopen(fd, "r");
+    int fd2 = dup(fd);
+    FILE *out = fd2 < 0 ? NULL : fdopen(fd2, "w");
+    char line[SERVEUR_LIGNE];
+    char *source = NULL, *copie = NULL;
+    size_t source_capacity = 0, copie_capacity = 0;
+
+    if (in == NULL || out == NULL) {
+        if (in != NULL) fclose(in);
+        else close(fd);
+        if (out != NULL) fclose(out);
+        else if (fd2 >= 0) close(fd2);
+        return;
+    }
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (strcmp(line, "stats\n") == 0) {
+            pthread_mutex_lock(&cache_lock);
+            fprintf(out, "requests %lld hits %lld entries %d bytes %lld\n", requetes, hits, entrees, octets);
+            pthread_mutex_unlock(&cache_lock);
+            fflush(out);
+            continue;
+        }
+        if (strcmp(line, "arret\n") == 0) {
+            unlink(chemin);
+            exit(0);
+        }
+        size_t size;
+        int n;
+        if (sscanf(line, "compiler %zu%n", &size, &n) != 1) break;
+        /* %zu takes a negative length modulo SIZE_MAX + 1 */
+        if (line[8 + strspn(line + 8, " \t")] == '-') size = SIZE_MAX;
+        /* the source is not read, so the connection ends after the answer */
+        if (size > SERVEUR_SOURCE_MAX) {
+            char messages[128];
+            snprintf(messages, sizeof(messages), "Source longer than %u bytes\n", SERVEUR_SOURCE_MAX);
+            size_t longueur[TEXTES] = { 0, 0, 0, strlen(messages) };
+            reply(out, 1, 0, longueur, messages);
+            break;
+        }
+        if (size + 1 > source_capacity) {
+            free(source);
+            source_capacity = size + 1;
+            source = malloc(source_capacity);
+            if (source == NULL) break;
+        }
+        if (fread(source, 1, size, in) != size) break;
+
+        Options o;
+        char messages[SERVEUR_LIGNE + 64];
+        FILE *m = fmemopen(messages, sizeof(messages), "w");
+        if (m == NULL) break;
+        int bad = parse_options(line + n, &o, m);
+        fclose(m);
+        if (bad) {
+            size_t longueur[TEXTES] = { 0, 0, 0, strlen(messages) };
+            reply(out, 1, 0, longueur, messages);
+            fflush(out);
+            continue;
+        }
+
+        /* a hit is copied out under the lock: the entry may be evicted
+           as soon as it is released */
+        uint64_t hash = hash_request(&o, source, size);
+        size_t longueur[TEXTES];
+        int status = 0, cache = 0;
+        pthread_mutex_lock(&cache_lock);
+        requetes++;
+        Entree *e = lookup(hash, &o, source, size);
+        if (e != NULL) {
+            size_t t = total(e);
+            if (t > copie_capacity) {
+                free(copie);
+                copie_capacity = t;
+                copie = malloc(copie_capacity);
+            }
+            if (copie != NULL) {
+                memcpy(copie, e->texte, t);
+                memcpy(longueur, e->longueur, sizeof(longueur));
+                status = e->status;
+                cache = 1;
+                hits++;
+            } else {
+                copie_capacity = 0;
+            }
+        }
+        pthread_mutex_unlock(&cache_lock);
+
+        if (!cache) {
+            e = compile_attente(&o, source, size, hash);
+            if (e == NULL) break;
+            reply(out, e->status, 0, e->longueur, e->texte);
+            pthread_mutex_lock(&cache_lock);
+            if (lookup(hash, &o, source, size) == NULL) insert(e);
+            else free_entree(e);
+            pthread_mutex_unlock(&cache_lock);
+        } else {
+            reply(out, status, 1, longueur, copie);
+        }
+        if (fflush(out) != 0) break;
+    }
+    free(source);
+    free(copie);
+    fclose(in);
+    fclose(out);
+}
+
+static void *connexion(void *arg) {
+    serve((int)(intptr_t)arg);
+    return NULL;
+}
+
+/* accepts connections for good, one thread each */
+static void accepter(int listener) {
+    for (;;) {
+        int fd = accept(listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("accept");
+            /* out of descriptors or memory: let the connections in
+               progress end rather than retry at once */
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                struct timespec pause = { 0, 100 * 1000 * 1000 };
+                nanosleep(&pause, NULL);
+            }
+            continue;
+        }
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, connexion, (void *)(intptr_t)fd) != 0) {
+            fprintf(stderr, "Cannot start a thread for a connection\n");
+            close(fd);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+}
+
+int main(int argc, char **argv) {
+    int nthreads = 4;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            chemin = argv[++i];
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            nthreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            capacite = atoi(argv[++i]);
+        } else {
+            nthreads = 0;
+            break;
+        }
+    }
+    if (nthreads < 1 || capacite < 1) {
+        fprintf(stderr, "Usage: %s [-s socket] [-j N] [-c entrees]\n", argv[0]);
+        fprintf(stderr, "  -s socket   Unix socket to listen on (default: %s)\n", SERVEUR_SOCKET);
+        fprintf(stderr, "  -j N        compiler threads (default: 4)\n");
+        fprintf(stderr, "  -c entrees  cached answers kept, the oldest dropped first (default: 4096)\n");
+        return 1;
+    }
+
+    unsigned size = 16;
+    while (size < (unsigned)capacite * 2) size *= 2;
+    buckets = calloc(size, sizeof(Entree *));
+    ordre = malloc((size_t)capacite * sizeof(Entree *));
+    if (buckets == NULL || ordre == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    bucket_mask = size - 1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(chemin) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", chemin);
+        return 1;
+    }
+    strcpy(addr.sun_path, chemin);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        perror("socket");
+        return 1;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        fprintf(stderr, "%s: a server is already listening\n", chemin);
+        return 1;
+    }
+    if (probe >= 0) close(probe);
+    unlink(chemin);     /* left by a server that did not stop cleanly */
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+        perror(chemin);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);   /* a client gone away is a write error */
+
+    for (int t = 0; t < nthreads; ++t) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, compilateur, NULL) != 0) {
+            fprintf(stderr, "Cannot start thread %d\n", t);
+            return 1;
+        }
+        pthread_detach(thread);
+    }
+    accepter(listener);
+    return 0;
+}
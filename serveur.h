@@ -0,0 +1,33 @@
+#ifndef SERVEUR_H
+#define SERVEUR_H
+
+/*
+ * Protocol of the compile server (serveur.c) and its client (client.c),
+ * over a Unix stream socket. A connection carries any number of
+ * requests, each answered before the next is read:
+ *
+ *   compiler <n> [-O0] [--dataflow passes] [--peephole regles]\n
+ *   then the n bytes of the source, n at most SERVEUR_SOURCE_MAX; a
+ *   longer one is answered with status 1 and the connection closed
+ *     -> <status> <cache> <code> <symtab> <labels> <messages>\n
+ *        then four texts of those lengths: pile_code.txt,
+ *        symbol_table.txt, etiquettes.txt and what analyseur_synt would
+ *        print on stderr. status is 0 when the source compiled, 1
+ *        otherwise; cache is 1 when the answer comes from the cache.
+ *   stats\n
+ *     -> requests <r> hits <h> entries <e> bytes <b>\n
+ *   arret\n
+ *     -> the server removes its socket and exits
+ *
+ * The options are those of analyseur_synt, with the same defaults.
+ */
+
+#define SERVEUR_SOCKET "/tmp/compilateur.sock"
+
+/* longest request line */
+#define SERVEUR_LIGNE 1024
+
+/* longest source a request may carry */
+#define SERVEUR_SOURCE_MAX (64u << 20)
+
+#endif
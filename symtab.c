@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "erreur.h"
+#include "symtab.h"
+
+static void *grow(void *ptr, int *capacity, size_t elem, int minimum) {
+    int n = *capacity ? *capacity * 2 : minimum;
+    void *grown = realloc(ptr, (size_t)n * elem);
+    if (grown == NULL) {
+        erreur("Symbol table overflow");
+    }
+    *capacity = n;
+    return grown;
+}
+
+static unsigned hash_chars(const char *s, unsigned length) {
+    unsigned h = 2166136261u;
+    for (unsigned i = 0; i < length; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static unsigned hash_id(int id) {
+    return (unsigned)id * 2654435761u;
+}
+
+/* ---------- interned names ---------- */
+
+static _Thread_local char *name_chars = NULL;     /* NUL-terminated names, back to back */
+static _Thread_local int name_chars_size = 0;
+static _Thread_local int name_chars_capacity = 0;
+static _Thread_local int *name_offset = NULL;     /* id -> offset in name_chars */
+static _Thread_local unsigned *name_hash = NULL;
+static _Thread_local int name_count = 0;
+static _Thread_local int name_capacity = 0;
+static _Thread_local int *name_slots = NULL;      /* open addressing: id + 1, 0 = empty */
+static _Thread_local unsigned name_mask = 0;
+
+static void intern_rehash(void) {
+    unsigned size = name_mask ? (name_mask + 1) * 2 : 256;
+    int *slots = calloc(size, sizeof(int));
+    if (slots == NULL) {
+        erreur("Symbol table overflow");
+    }
+    for (int id = 0; id < name_count; ++id) {
+        unsigned h = name_hash[id] & (size - 1);
+        while (slots[h] != 0) h = (h + 1) & (size - 1);
+        slots[h] = id + 1;
+    }
+    free(name_slots);
+    name_slots = slots;
+    name_mask = size - 1;
+}
+
+int intern(const char *name, unsigned length) {
+    unsigned hash = hash_chars(name, length);
+
+    if (name_slots == NULL) intern_rehash();
+    unsigned h = hash & name_mask;
+    while (name_slots[h] != 0) {
+        int id = name_slots[h] - 1;
+        const char *s = name_chars + name_offset[id];
+        if (name_hash[id] == hash && strncmp(s, name, length) == 0 && s[length] == '\0') return id;
+        h = (h + 1) & name_mask;
+    }
+
+    while (name_chars_size + (int)length + 1 > name_chars_capacity)
+        name_chars = grow(name_chars, &name_chars_capacity, 1, 4096);
+    if (name_count == name_capacity) {
+        int capacity = name_capacity;
+        name_offset = grow(name_offset, &capacity, sizeof(int), 256);
+        name_hash = grow(name_hash, &name_capacity, sizeof(unsigned), 256);
+    }
+
+    int id = name_count++;
+    memcpy(name_chars + name_chars_size, name, length);
+    name_chars[name_chars_size + length] = '\0';
+    name_offset[id] = name_chars_size;
+    name_hash[id] = hash;
+    name_chars_size += (int)length + 1;
+    name_slots[h] = id + 1;
+
+    if ((unsigned)name_count * 2 > name_mask + 1) intern_rehash();
+    return id;
+}
+
+const char *intern_name(int id) {
+    return name_chars + name_offset[id];
+}
+
+/* ---------- symbol table ---------- */
+
+_Thread_local Symbol *symtab = NULL;
+_Thread_local int symtab_count = 0;
+_Thread_local int next_address = 0;
+
+static _Thread_local int symtab_capacity = 0;
+static _Thread_local int *symtab_slots = NULL;    /* open addressing: symbol index + 1 */
+static _Thread_local unsigned symtab_mask = 0;
+
+static void symtab_rehash(void) {
+    unsigned size = symtab_mask ? (symtab_mask + 1) * 2 : 64;
+    int *slots = calloc(size, sizeof(int));
+    if (slots == NULL) {
+        erreur("Symbol table overflow");
+    }
+    for (int i = 0; i < symtab_count; ++i) {
+        unsigned h = hash_id(symtab[i].name) & (size - 1);
+        while (slots[h] != 0) h = (h + 1) & (size - 1);
+        slots[h] = i + 1;
+    }
+    free(symtab_slots);
+    symtab_slots = slots;
+    symtab_mask = size - 1;
+}
+
+int symtab_get_index(int name) {
+    if (symtab_slots == NULL) return -1;
+    for (unsigned h = hash_id(name) & symtab_mask; symtab_slots[h] != 0; h = (h + 1) & symtab_mask) {
+        int idx = symtab_slots[h] - 1;
+        if (symtab[idx].name == name) return idx;
+    }
+    return -1;
+}
+
+int symtab_add(int name) {
+    int idx = symtab_get_index(name);
+    if (idx != -1) return idx;
+    if (symtab_count == symtab_capacity) symtab = grow(symtab, &symtab_capacity, sizeof(Symbol), 64);
+    if (symtab_slots == NULL || (unsigned)(symtab_count + 1) * 2 > symtab_mask + 1) symtab_rehash();
+
+    idx = symtab_count++;
+    symtab[idx].name = name;
+    symtab[idx].type = ERROR;
+    symtab[idx].declared = 0;
+    symtab[idx].address = -1;
+
+    unsigned h = hash_id(name) & symtab_mask;
+    while (symtab_slots[h] != 0) h = (h + 1) & symtab_mask;
+    symtab_slots[h] = idx + 1;
+    return idx;
+}
+
+void symtab_set_type(int name, TokenType type) {
+    int idx = symtab_add(name);
+    symtab[idx].type = type;
+    symtab[idx].declared = 1;
+    symtab[idx].address = next_address++;
+}
+
+void intern_reset(void) {
+    free(name_chars);
+    free(name_offset);
+    free(name_hash);
+    free(name_slots);
+    name_chars = NULL;
+    name_offset = NULL;
+    name_hash = NULL;
+    name_slots = NULL;
+    name_chars_size = name_chars_capacity = 0;
+    name_count = name_capacity = 0;
+    name_mask = 0;
+}
+
+void symtab_reset(void) {
+    free(symtab);
+    free(symtab_slots);
+    symtab = NULL;
+    symtab_slots = NULL;
+    symtab_count = symtab_capacity = 0;
+    symtab_mask = 0;
+    next_address = 0;
+}
+
+static void symtab_write(FILE *file) {
+    for (int i = 0; i < symtab_count; ++i) {
+        if (symtab[i].type == INTEGER)
+            fprintf(file, "%3d: %-12s  type=INTEGER  declared=%d  address=%d\n",
+                    i, intern_name(symtab[i].name), symtab[i].declared, symtab[i].address);
+        else if (symtab[i].type == CHAR)
+            fprintf(file, "%3d: %-12s  type=CHAR     declared=%d  address=%d\n",
+                    i, intern_name(symtab[i].name), symtab[i].declared, symtab[i].address);
+    }
+}
+
+void symtab_print(void) {
+    printf("\n--- Symbol table (%d entries) ---\n", symtab_count);
+    symtab_write(stdout);
+}
+
+void write_symtab(FILE *file) {
+    symtab_write(file);
+    fprintf(file, "\n");
+}
+
+void write_symtab_to_file(const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (file == NULL) erreur("Error opening file %s for writing", filename);
+
+    write_symtab(file);
+    fclose(file);
+}
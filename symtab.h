@@ -0,0 +1,36 @@
+#ifndef SYMTAB_H
+#define SYMTAB_H
+
+#include "analyseur_lex.h"
+
+/* Identifier names are interned once: every later comparison is between
+   integer ids. */
+int intern(const char *name, unsigned length);
+const char *intern_name(int id);
+/* forgets every interned name: ids given before are no longer valid */
+void intern_reset(void);
+
+typedef struct {
+    int name;           /* interned id */
+    TokenType type;
+    int declared;
+    int address;
+} Symbol;
+
+/* entries in insertion order; the hash table only maps names to indexes */
+extern _Thread_local Symbol *symtab;
+extern _Thread_local int symtab_count;
+extern _Thread_local int next_address;
+
+int symtab_get_index(int name);
+int symtab_add(int name);
+void symtab_set_type(int name, TokenType type);
+/* forgets every symbol, for the next compilation in the same thread
+   (names stay interned) */
+void symtab_reset(void);
+void symtab_print(void);
+/* symbol_table.txt contents */
+void write_symtab(FILE *file);
+void write_symtab_to_file(const char *filename);
+
+#endif
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tokens_bin.h"
+
+static uint32_t le32(uint32_t x) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap32(x);
+#else
+    return x;
+#endif
+}
+
+static uint16_t le16(uint16_t x) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap16(x);
+#else
+    return x;
+#endif
+}
+
+/* ---------- writer ---------- */
+
+struct TokBinWriter {
+    FILE *file;
+    uint32_t count;
+    char *pool;
+    uint32_t pool_size;
+    uint32_t pool_capacity;
+    uint32_t *slots;        /* open addressing: pool offset + 1, 0 = empty */
+    uint32_t slot_mask;
+    uint32_t distinct;
+};
+
+static uint32_t hash_lexeme(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int pool_grow_slots(TokBinWriter *w) {
+    uint32_t size = (w->slot_mask + 1) * 2;
+    uint32_t *slots = calloc(size, sizeof(uint32_t));
+    if (slots == NULL) return -1;
+    for (uint32_t i = 0; i <= w->slot_mask; ++i) {
+        if (w->slots[i] == 0) continue;
+        const char *s = w->pool + w->slots[i] - 1;
+        uint32_t h = hash_lexeme(s, strlen(s)) & (size - 1);
+        while (slots[h] != 0) h = (h + 1) & (size - 1);
+        slots[h] = w->slots[i];
+    }
+    free(w->slots);
+    w->slots = slots;
+    w->slot_mask = size - 1;
+    return 0;
+}
+
+/* offset of the len-byte lexeme in the pool, adding it the first time it
+   is seen */
+static int pool_intern(TokBinWriter *w, const char *lexeme, size_t len, uint32_t *offset) {
+    uint32_t h = hash_lexeme(lexeme, len) & w->slot_mask;
+
+    while (w->slots[h] != 0) {
+        const char *s = w->pool + w->slots[h] - 1;
+        if (strncmp(s, lexeme, len) == 0 && s[len] == '\0') {
+            *offset = w->slots[h] - 1;
+            return 0;
+        }
+        h = (h + 1) & w->slot_mask;
+    }
+
+    if (w->pool_size + len + 1 > w->pool_capacity) {
+        uint32_t capacity = w->pool_capacity * 2;
+        while (capacity < w->pool_size + len + 1) capacity *= 2;
+        char *pool = realloc(w->pool, capacity);
+        if (pool == NULL) return -1;
+        w->pool = pool;
+        w->pool_capacity = capacity;
+    }
+    memcpy(w->pool + w->pool_size, lexeme, len);
+    w->pool[w->pool_size + len] = '\0';
+    *offset = w->pool_size;
+    w->slots[h] = w->pool_size + 1;
+    w->pool_size += (uint32_t)len + 1;
+
+    if (++w->distinct * 2 > w->slot_mask + 1) return pool_grow_slots(w);
+    return 0;
+}
+
+TokBinWriter *tokbin_create(const char *filename) {
+    TokBinWriter *w = calloc(1, sizeof(TokBinWriter));
+    if (w == NULL) return NULL;
+
+    w->file = fopen(filename, "wb");
+    w->pool_capacity = 4096;
+    w->pool = malloc(w->pool_capacity);
+    w->slot_mask = 1023;
+    w->slots = calloc(w->slot_mask + 1, sizeof(uint32_t));
+    if (w->file == NULL || w->pool == NULL || w->slots == NULL) {
+        perror(filename);
+        if (w->file) fclose(w->file);
+        free(w->pool);
+        free(w->slots);
+        free(w);
+        return NULL;
+    }
+
+    /* placeholder, rewritten by tokbin_finish() once the sizes are known */
+    TokBinHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, w->file);
+    return w;
+}
+
+int tokbin_write(TokBinWriter *w, const Token *token) {
+    TokBinRecord rec;
+    uint32_t lexeme;
+    if (pool_intern(w, token_chars(token), token_size(token), &lexeme) != 0) {
+        fprintf(stderr, "Token pool overflow\n");
+        return -1;
+    }
+    uint32_t length = token->length > TOKBIN_MAX_LENGTH ? TOKBIN_MAX_LENGTH : token->length;
+    rec.offset = le32(token->offset);
+    rec.lexeme = le32(lexeme);
+    rec.type_length = le32((uint32_t)token->type << 24 | length);
+    if (fwrite(&rec, sizeof(rec), 1, w->file) != 1) return -1;
+    w->count++;
+    return 0;
+}
+
+int tokbin_finish(TokBinWriter *w) {
+    TokBinHeader header;
+    int status = 0;
+
+    memcpy(header.magic, TOKBIN_MAGIC, 4);
+    header.version = le16(TOKBIN_VERSION);
+    header.record_size = le16(sizeof(TokBinRecord));
+    header.count = le32(w->count);
+    header.pool_size = le32(w->pool_size);
+
+    if (fwrite(w->pool, 1, w->pool_size, w->file) != w->pool_size) status = -1;
+    if (fseek(w->file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, w->file) != 1) status = -1;
+    if (fclose(w->file) != 0) status = -1;
+
+    free(w->pool);
+    free(w->slots);
+    free(w);
+    return status;
+}
+
+/* ---------- reader ---------- */
+
+int tokbin_open(TokBinReader *r, const char *filename) {
+    memset(r, 0, sizeof(*r));
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror(filename);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TokBinHeader)) {
+        fprintf(stderr, "%s: not a binary token file\n", filename);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(filename);
+        return -1;
+    }
+    r->map = map;
+    r->map_size = (size_t)st.st_size;
+
+    const TokBinHeader *header = map;
+    if (memcmp(header->magic, TOKBIN_MAGIC, 4) != 0 ||
+        le16(header->version) != TOKBIN_VERSION ||
+        le16(header->record_size) != sizeof(TokBinRecord)) {
+        fprintf(stderr, "%s: not a version %d binary token file\n", filename, TOKBIN_VERSION);
+        tokbin_close(r);
+        return -1;
+    }
+    r->count = le32(header->count);
+    r->pool_size = le32(header->pool_size);
+    if (sizeof(TokBinHeader) + (size_t)r->count * sizeof(TokBinRecord) + r->pool_size != r->map_size ||
+        (r->count > 0 && (r->pool_size == 0 || r->map[r->map_size - 1] != '\0'))) {
+        fprintf(stderr, "%s: truncated binary token file\n", filename);
+        tokbin_close(r);
+        return -1;
+    }
+    r->records = (const TokBinRecord *)(r->map + sizeof(TokBinHeader));
+    r->pool = (const char *)(r->records + r->count);
+    return 0;
+}
+
+void tokbin_read(TokBinReader *r, Token *token) {
+    token->text = NULL;
+    if (r->next >= r->count) {
+        token->type = EOF_TOKEN;
+        strcpy(token->lexeme, "EOF");
+        token->offset = TOKBIN_NO_OFFSET;
+        token->length = 0;
+        return;
+    }
+
+    const TokBinRecord *rec = &r->records[r->next++];
+    uint32_t lexeme = le32(rec->lexeme);
+    uint32_t type_length = le32(rec->type_length);
+    token->type = (TokenType)(type_length >> 24);
+    token->offset = le32(rec->offset);
+    token->length = type_length & TOKBIN_MAX_LENGTH;
+    if (lexeme >= r->pool_size) lexeme = r->pool_size - 1;
+    /* a lexeme that is the source text stays in the pool, others (EOF,
+       error messages) are short */
+    const char *s = r->pool + lexeme;
+    size_t len = strlen(s);
+    if (len == token->length) {
+        token->text = s;
+    } else if (len < sizeof(token->lexeme)) {
+        memcpy(token->lexeme, s, len + 1);
+    } else {
+        token->type = ERROR;
+        strcpy(token->lexeme, "Lexème trop long");
+    }
+}
+
+void tokbin_close(TokBinReader *r) {
+    if (r->map != NULL) munmap((void *)r->map, r->map_size);
+    memset(r, 0, sizeof(*r));
+}
+
+/* ---------- text format ---------- */
+
+void write_text_token(FILE *file, const Token *token) {
+    fprintf(file, "Token: %.*s (Code: %d)\n", (int)token_size(token), token_chars(token), (int)token->type);
+}
+
+Token read_text_token(FILE *file) {
+    Token token;
+    char line[256];
+
+    token.offset = TOKBIN_NO_OFFSET;
+    token.length = 0;
+    token.text = NULL;
+
+    /* the lexeme may contain spaces ("Caractère invalide: x"), so cut the
+       line at the last " (Code: " rather than scanning it with %s */
+    if (fgets(line, sizeof(line), file) != NULL && strncmp(line, "Token: ", 7) == 0) {
+        if (strchr(line, '\n') == NULL && !feof(file)) {
+            /* longer than any lexeme: skip the rest of the line */
+            int c;
+            while ((c = fgetc(file)) != EOF && c != '\n') continue;
+            token.type = ERROR;
+            strcpy(token.lexeme, "Lexème trop long");
+            return token;
+        }
+        char *sep = NULL;
+        for (char *p = strstr(line, " (Code: "); p != NULL; p = strstr(p + 1, " (Code: ")) sep = p;
+        int code;
+        if (sep != NULL && sscanf(sep, " (Code: %d)", &code) == 1) {
+            size_t len = (size_t)(sep - (line + 7));
+            if (len >= sizeof(token.lexeme)) {
+                token.type = ERROR;
+                strcpy(token.lexeme, "Lexème trop long");
+                return token;
+            }
+            memcpy(token.lexeme, line + 7, len);
+            token.lexeme[len] = '\0';
+            token.type = (TokenType)code;
+            token.length = (unsigned)len;
+            return token;
+        }
+    }
+    token.type = EOF_TOKEN;
+    strcpy(token.lexeme, "EOF");
+    return token;
+}
@@ -0,0 +1,70 @@
+#ifndef TOKENS_BIN_H
+#define TOKENS_BIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "analyseur_lex.h"
+
+/*
+ * Binary token stream, the compact counterpart of tokens.txt.
+ *
+ *   header   16 bytes   TokBinHeader
+ *   records  count x 12 TokBinRecord
+ *   pool     pool_size  NUL-terminated lexemes, each stored once
+ *
+ * All integers are little-endian. A record packs the token type in the
+ * top 8 bits of type_length and its source length in the low 24, and
+ * refers to its lexeme by byte offset in the pool. Tokens converted from
+ * tokens.txt have no source position: their offset is TOKBIN_NO_OFFSET.
+ */
+
+#define TOKBIN_MAGIC "PTOK"
+#define TOKBIN_VERSION 1
+#define TOKBIN_NO_OFFSET 0xFFFFFFFFu
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t count;
+    uint32_t pool_size;
+} TokBinHeader;
+
+#define TOKBIN_MAX_LENGTH 0x00FFFFFFu
+
+typedef struct {
+    uint32_t offset;
+    uint32_t lexeme;
+    uint32_t type_length;
+} TokBinRecord;
+
+typedef struct TokBinWriter TokBinWriter;
+
+TokBinWriter *tokbin_create(const char *filename);
+int tokbin_write(TokBinWriter *w, const Token *token);
+/* writes the lexeme pool and the header, then frees the writer */
+int tokbin_finish(TokBinWriter *w);
+
+typedef struct {
+    const unsigned char *map;
+    size_t map_size;
+    const TokBinRecord *records;
+    const char *pool;
+    uint32_t count;
+    uint32_t pool_size;
+    uint32_t next;
+} TokBinReader;
+
+/* maps the file; returns 0 on success, -1 with a message on stderr */
+int tokbin_open(TokBinReader *r, const char *filename);
+/* fills *token with the next record; EOF_TOKEN once the stream is exhausted */
+void tokbin_read(TokBinReader *r, Token *token);
+void tokbin_close(TokBinReader *r);
+
+/* "Token: <lexeme> (Code: N)" line format of tokens.txt */
+void write_text_token(FILE *file, const Token *token);
+Token read_text_token(FILE *file);
+
+#endif
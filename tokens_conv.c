@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tokens_bin.h"
+
+/* Converts between tokens.txt and the binary token format so existing
+   tooling can keep consuming the text form.
+   Usage: tokens_conv txt2bin tokens.txt tokens.bin
+          tokens_conv bin2txt tokens.bin tokens.txt */
+
+static int txt2bin(const char *in_name, const char *out_name) {
+    FILE *in = fopen(in_name, "r");
+    if (in == NULL) {
+        perror(in_name);
+        return 1;
+    }
+    TokBinWriter *out = tokbin_create(out_name);
+    if (out == NULL) {
+        fclose(in);
+        return 1;
+    }
+
+    Token t;
+    do {
+        t = read_text_token(in);
+        if (tokbin_write(out, &t) != 0) {
+            fprintf(stderr, "Error writing %s\n", out_name);
+            return 1;
+        }
+    } while (t.type != EOF_TOKEN);
+
+    fclose(in);
+    return tokbin_finish(out) == 0 ? 0 : 1;
+}
+
+static int bin2txt(const char *in_name, const char *out_name) {
+    TokBinReader in;
+    if (tokbin_open(&in, in_name) != 0) return 1;
+    FILE *out = fopen(out_name, "w");
+    if (out == NULL) {
+        perror(out_name);
+        tokbin_close(&in);
+        return 1;
+    }
+
+    Token t;
+    do {
+        tokbin_read(&in, &t);
+        write_text_token(out, &t);
+    } while (t.type != EOF_TOKEN);
+
+    tokbin_close(&in);
+    return fclose(out) == 0 ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc == 4 && strcmp(argv[1], "txt2bin") == 0) return txt2bin(argv[2], argv[3]);
+    if (argc == 4 && strcmp(argv[1], "bin2txt") == 0) return bin2txt(argv[2], argv[3]);
+
+    fprintf(stderr, "Usage: %s txt2bin tokens.txt tokens.bin\n", argv[0]);
+    fprintf(stderr, "       %s bin2txt tokens.bin tokens.txt\n", argv[0]);
+    return 1;
+}
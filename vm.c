@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vm.h"
+
+/* Direct-threaded dispatch through computed goto where the compiler
+   supports it; -DVM_SWITCH forces the portable switch loop. */
+#if defined(__GNUC__) && !defined(VM_SWITCH)
+#define VM_THREADED 1
+#endif
+
+typedef struct {
+    const void *handler;
+    int32_t arg;
+    int32_t arg2;
+} VmThreaded;
+
+static VmStatus vm_exec(Vm *vm, const void *const **handlers);
+#ifdef VM_THREADED
+static VmStatus vm_exec_en_place(Vm *vm, const void *const **handlers);
+#endif
+
+/* ---------- loading ---------- */
+
+/* Follows every path to find each instruction's stack height (kept in
+   prog->height): rejects underflow and paths that meet with different
+   heights, and sizes the operand stack. Also finds the number of
+   variables. */
+static int verify(VmProgram *prog) {
+    const Instr *code = prog->code;
+    int count = prog->count;
+    int *height = malloc((size_t)(count + 1) * sizeof(int));
+    int *work = malloc((size_t)(count + 1) * sizeof(int));
+    int nwork = 0, status = 0;
+
+    if (height == NULL || work == NULL) {
+        free(height);
+        free(work);
+        return -1;
+    }
+    for (int i = 0; i <= count; ++i) height[i] = -1;
+    prog->max_stack = 0;
+    prog->nvars = 0;
+
+    for (int i = 0; i < count; ++i) {
+        if (code[i].op == OP_VALEURG || code[i].op == OP_VALEURD || code[i].op == OP_INCR) {
+            if (code[i].arg < 0) {
+                fprintf(stderr, "Error: instruction %d uses negative address %d\n", i, code[i].arg);
+                status = -1;
+            } else if (code[i].arg >= prog->nvars) {
+                prog->nvars = code[i].arg + 1;
+            }
+        }
+    }
+
+    height[0] = 0;
+    work[nwork++] = 0;
+    while (nwork > 0 && status == 0) {
+        int i = work[--nwork];
+        int h = height[i];
+        int pops = 0, pushes = 0;
+        int succ[2], nsucc = 0;
+
+        switch (code[i].op) {
+            case OP_VALEURG: case OP_VALEURD: case OP_EMPILER: case OP_LIRE:
+                pushes = 1; break;
+            case OP_AFFECTER:
+                pops = 2; break;
+            case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+            case OP_COMPARER_SUP: case OP_COMPARER_INF: case OP_COMPARER_EGAL:
+            case OP_COMPARER_SUP_EGAL: case OP_COMPARER_INF_EGAL: case OP_COMPARER_DIFF:
+                pops = 2; pushes = 1; break;
+            case OP_ALLER_SI_PAS_SUP: case OP_ALLER_SI_PAS_INF: case OP_ALLER_SI_PAS_EGAL:
+            case OP_ALLER_SI_PAS_SUP_EGAL: case OP_ALLER_SI_PAS_INF_EGAL: case OP_ALLER_SI_PAS_DIFF:
+                pops = 2; break;
+            case OP_DECALER_GAUCHE: case OP_DECALER_DROITE:
+                if (code[i].arg < 0 || code[i].arg > 30) {
+                    fprintf(stderr, "Error: instruction %d shifts by %d\n", i, code[i].arg);
+                    status = -1;
+                    continue;
+                }
+                pops = 1; pushes = 1; break;
+            case OP_ALLER_SI_FAUX: case OP_ECRIRE:
+                pops = 1; break;
+            case OP_ALLER: case OP_HALTE: case OP_INCR:
+                break;
+            case OP_ETIQ:
+                fprintf(stderr, "Error: instruction %d is an unresolved label Etiq_%d\n", i, code[i].arg);
+                status = -1;
+                continue;
+            default:
+                fprintf(stderr, "Error: instruction %d has unknown opcode %d\n", i, code[i].op);
+                status = -1;
+                continue;
+        }
+        if (h < pops) {
+            fprintf(stderr, "Error: instruction %d pops an empty stack\n", i);
+            status = -1;
+            continue;
+        }
+        h = h - pops + pushes;
+        if (h > prog->max_stack) prog->max_stack = h;
+
+        if (code[i].op == OP_HALTE) continue;
+        if (opcode_is_jump(code[i].op) && (code[i].arg < 0 || code[i].arg > count)) {
+            fprintf(stderr, "Error: instruction %d jumps outside the code (%d)\n", i, code[i].arg);
+            status = -1;
+            continue;
+        }
+        if (code[i].op != OP_ALLER) succ[nsucc++] = i + 1;
+        if (opcode_is_jump(code[i].op)) succ[nsucc++] = code[i].arg;
+        for (int k = 0; k < nsucc; ++k) {
+            int s = succ[k];
+            if (height[s] == -1) {
+                height[s] = h;
+                if (s < count) work[nwork++] = s;
+            } else if (height[s] != h) {
+                fprintf(stderr, "Error: stack height %d and %d meet at instruction %d\n", height[s], h, s);
+                status = -1;
+            }
+        }
+    }
+
+    prog->height = height;
+    free(work);
+    return status;
+}
+
+int vm_verify(const VmProgram *prog) {
+    VmProgram found = *prog;
+    int status = verify(&found);
+    free(found.height);
+    if (status == 0 && (found.nvars > prog->nvars || found.max_stack > prog->max_stack)) {
+        fprintf(stderr, "Error: the code needs %d variables and a stack of %d, not %d and %d\n",
+                found.nvars, found.max_stack, prog->nvars, prog->max_stack);
+        status = -1;
+    }
+    return status;
+}
+
+int vm_load(VmProgram *prog, const Instr *code, int count) {
+    memset(prog, 0, sizeof(*prog));
+
+    /* one extra Halte so that running off the end stops the machine */
+    prog->code = malloc((size_t)(count + 1) * sizeof(Instr));
+    if (prog->code == NULL) {
+        fprintf(stderr, "Code memory overflow\n");
+        return -1;
+    }
+    memcpy(prog->code, code, (size_t)count * sizeof(Instr));
+    prog->code[count].op = OP_HALTE;
+    prog->code[count].arg = 0;
+    prog->count = count;
+
+    if (verify(prog) != 0) {
+        vm_free_program(prog);
+        return -1;
+    }
+
+#ifdef VM_THREADED
+    const void *const *handlers;
+    vm_exec(NULL, &handlers);
+    VmThreaded *threaded = malloc((size_t)(count + 1) * sizeof(VmThreaded));
+    if (threaded == NULL) {
+        vm_free_program(prog);
+        return -1;
+    }
+    for (int i = 0; i <= count; ++i) {
+        threaded[i].handler = handlers[prog->code[i].op];
+        threaded[i].arg = prog->code[i].arg;
+        threaded[i].arg2 = prog->code[i].arg2;
+    }
+    prog->threaded = threaded;
+#endif
+    return 0;
+}
+
+int vm_load_file(VmProgram *prog, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (file == NULL) {
+        perror(filename);
+        return -1;
+    }
+
+    Instr *code = NULL;
+    int count = 0, capacity = 0, status = 0, symbolic = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *text = strchr(line, ':');
+        int index;
+        if (sscanf(line, "%d", &index) != 1 || text == NULL) continue;   /* blank or header line */
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            Instr *grown = realloc(code, (size_t)capacity * sizeof(Instr));
+            if (grown == NULL) {
+                status = -1;
+                break;
+            }
+            code = grown;
+        }
+        int parsed = index == count ? parse_instr(text + 1, &code[count]) : -1;
+        if (parsed < 0) {
+            fprintf(stderr, "%s: bad instruction line: %s", filename, line);
+            status = -1;
+            break;
+        }
+        symbolic |= parsed;
+        count++;
+    }
+    fclose(file);
+
+    /* a listing that still has Etiq markers is backpatched here */
+    if (status == 0 && symbolic) {
+        int nlabels;
+        int *table = backpatch(code, &count, &nlabels);
+        if (table == NULL) status = -1;
+        free(table);
+    }
+    if (status == 0) status = vm_load(prog, code, count);
+    free(code);
+    return status;
+}
+
+void vm_free_program(VmProgram *prog) {
+    free(prog->code);
+    free(prog->height);
+    free(prog->threaded);
+    memset(prog, 0, sizeof(*prog));
+}
+
+/* ---------- execution ---------- */
+
+int vm_init(Vm *vm, const VmProgram *prog, FILE *in, FILE *out) {
+    memset(vm, 0, sizeof(*vm));
+    vm->prog = prog;
+    vm->in = in;
+    vm->out = out;
+    vm->memory = calloc((size_t)prog->nvars + 1, sizeof(int32_t));
+    vm->stack = malloc(((size_t)prog->max_stack + 1) * sizeof(int32_t));
+    if (vm->memory == NULL || vm->stack == NULL) {
+        vm_free(vm);
+        return -1;
+    }
+    return 0;
+}
+
+void vm_reset(Vm *vm, FILE *in, FILE *out) {
+    memset(vm->memory, 0, ((size_t)vm->prog->nvars + 1) * sizeof(int32_t));
+    vm->in = in;
+    vm->out = out;
+    vm->executed = 0;
+    vm->pc = 0;
+}
+
+void vm_free(Vm *vm) {
+    free(vm->memory);
+    free(vm->stack);
+    vm->memory = NULL;
+    vm->stack = NULL;
+}
+
+VmStatus vm_run(Vm *vm) {
+#ifdef VM_THREADED
+    if (vm->prog->threaded == NULL) return vm_exec_en_place(vm, NULL);
+#endif
+    return vm_exec(vm, NULL);
+}
+
+const char *vm_status_message(VmStatus status) {
+    switch (status) {
+        case VM_OK: return "ok";
+        case VM_ERR_LOAD: return "code invalide";
+        case VM_ERR_DIV_ZERO: return "division par zéro";
+        case VM_ERR_ADDRESS: return "adresse invalide";
+        case VM_ERR_INPUT: return "entier attendu en entrée";
+        case VM_ERR_FUEL: return "carburant épuisé";
+    }
+    return "?";
+}
+
+/* Arithmetic wraps around on 32 bits, like the hardware would. */
+#define WRAP(expr) ((int32_t)(uint32_t)(expr))
+
+#ifdef VM_THREADED
+/* direct threading through the handler addresses of vm_load() */
+#define VM_CODE     VmThreaded
+#define VM_BASE     vm->prog->threaded
+#define DISPATCH()  goto *ip->handler
+#else
+#define VM_CODE     Instr
+#define VM_BASE     vm->prog->code
+#endif
+static VmStatus vm_exec(Vm *vm, const void *const **handlers) {
+#include "vm_boucle.h"
+}
+
+#ifdef VM_THREADED
+/* Code run where it lies, without the handler array: a module mapped by
+   module_open(). The handler is looked up by opcode, one more load per
+   instruction. */
+#define VM_CODE     Instr
+#define VM_BASE     vm->prog->code
+#define DISPATCH()  goto *table[ip->op]
+static VmStatus vm_exec_en_place(Vm *vm, const void *const **handlers) {
+#include "vm_boucle.h"
+}
+#endif
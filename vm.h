@@ -0,0 +1,68 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "code.h"
+
+/*
+ * Interpreter for the stack automaton code. Jumps arrive as instruction
+ * indexes (see backpatch() in code.h) and the stack depth of every
+ * instruction is checked once at load time, so the run loop needs no
+ * label search and no stack bounds test.
+ */
+
+typedef enum {
+    VM_OK = 0,
+    VM_ERR_LOAD,        /* unreadable or malformed code */
+    VM_ERR_DIV_ZERO,
+    VM_ERR_ADDRESS,     /* := through a value that is not a variable address */
+    VM_ERR_INPUT,       /* Lire found no integer */
+    VM_ERR_FUEL         /* stopped by Vm.fuel */
+} VmStatus;
+
+typedef struct {
+    Instr *code;        /* jump operands are instruction indexes */
+    int count;
+    int nvars;          /* 1 + highest address used */
+    int max_stack;      /* deepest operand stack reached on any path */
+    int *height;        /* operand stack height before each instruction,
+                           -1 where no path reaches it; NULL in a module */
+    void *threaded;     /* handler addresses, when built with computed goto;
+                           NULL for code run in place (module.h) */
+} VmProgram;
+
+typedef struct {
+    const VmProgram *prog;
+    int32_t *memory;
+    int32_t *stack;
+    FILE *in;
+    FILE *out;
+    uint64_t fuel;      /* vm_run() stops at the first jump taken once this
+                           many instructions ran; 0 = no limit (set by
+                           vm_init()). Without a jump there is no loop,
+                           so a run overshoots by less than the code. */
+    uint64_t executed;  /* instructions run by the last vm_run() */
+    int pc;             /* instruction that stopped the run */
+} Vm;
+
+/* copies and checks an in-memory code buffer, already backpatched */
+int vm_load(VmProgram *prog, const Instr *code, int count);
+/* parses a pile_code.txt listing, backpatching it if it still has labels */
+int vm_load_file(VmProgram *prog, const char *filename);
+void vm_free_program(VmProgram *prog);
+/* checks code that was not loaded by vm_load() (module.h) as vm_load()
+   does, and that its nvars and max_stack are large enough for it;
+   0 or -1 with a message on stderr */
+int vm_verify(const VmProgram *prog);
+
+int vm_init(Vm *vm, const VmProgram *prog, FILE *in, FILE *out);
+/* makes vm ready for another run of its program: variables back to 0 */
+void vm_reset(Vm *vm, FILE *in, FILE *out);
+VmStatus vm_run(Vm *vm);
+void vm_free(Vm *vm);
+
+const char *vm_status_message(VmStatus status);
+
+#endif
@@ -0,0 +1,248 @@
+/* Body of the run loop of vm.c, included there once per layout of the
+   code it runs: VM_CODE is the type of an instruction, VM_BASE the first
+   one and, with computed goto, DISPATCH() jumps to the handler of the
+   instruction at ip. No include guard, on purpose. */
+#ifdef VM_THREADED
+    static const void *const table[OP_COUNT] = {
+        [OP_VALEURG] = &&op_valeurg,
+        [OP_VALEURD] = &&op_valeurd,
+        [OP_EMPILER] = &&op_empiler,
+        [OP_AFFECTER] = &&op_affecter,
+        [OP_ADD] = &&op_add,
+        [OP_SUB] = &&op_sub,
+        [OP_MUL] = &&op_mul,
+        [OP_DIV] = &&op_div,
+        [OP_MOD] = &&op_mod,
+        [OP_DECALER_GAUCHE] = &&op_decaler_gauche,
+        [OP_DECALER_DROITE] = &&op_decaler_droite,
+        [OP_COMPARER_SUP] = &&op_comparer_sup,
+        [OP_COMPARER_INF] = &&op_comparer_inf,
+        [OP_COMPARER_EGAL] = &&op_comparer_egal,
+        [OP_COMPARER_SUP_EGAL] = &&op_comparer_sup_egal,
+        [OP_COMPARER_INF_EGAL] = &&op_comparer_inf_egal,
+        [OP_COMPARER_DIFF] = &&op_comparer_diff,
+        [OP_ALLER] = &&op_aller,
+        [OP_ALLER_SI_FAUX] = &&op_aller_si_faux,
+        [OP_ALLER_SI_PAS_SUP] = &&op_aller_si_pas_sup,
+        [OP_ALLER_SI_PAS_INF] = &&op_aller_si_pas_inf,
+        [OP_ALLER_SI_PAS_EGAL] = &&op_aller_si_pas_egal,
+        [OP_ALLER_SI_PAS_SUP_EGAL] = &&op_aller_si_pas_sup_egal,
+        [OP_ALLER_SI_PAS_INF_EGAL] = &&op_aller_si_pas_inf_egal,
+        [OP_ALLER_SI_PAS_DIFF] = &&op_aller_si_pas_diff,
+        [OP_INCR] = &&op_incr,
+        [OP_LIRE] = &&op_lire,
+        [OP_ECRIRE] = &&op_ecrire,
+        [OP_HALTE] = &&op_halte
+    };
+    if (handlers != NULL) {
+        *handlers = table;
+        return VM_OK;
+    }
+
+    const VM_CODE *base = VM_BASE;
+    const VM_CODE *ip = base;
+#define PC          ((int)(ip - base))
+#define ARG         (ip->arg)
+#define ARG2        (ip->arg2)
+#define CASE(name)  name:
+#define NEXT()      do { ++ip; ++executed; DISPATCH(); } while (0)
+#define JUMP(t)     do { ip = base + (t); if (++executed >= limit) goto out_of_fuel; DISPATCH(); } while (0)
+#else
+    (void)handlers;
+    const VM_CODE *base = VM_BASE;
+    const VM_CODE *ip = base;
+#define PC          ((int)(ip - base))
+#define ARG         (ip->arg)
+#define ARG2        (ip->arg2)
+#define CASE(name)  case name:
+#define DISPATCH()  continue
+/* plain blocks: a do/while wrapper would capture the continue */
+#define NEXT()      { ++ip; ++executed; continue; }
+#define JUMP(t)     { ip = base + (t); if (++executed >= limit) goto out_of_fuel; continue; }
+#define op_valeurg OP_VALEURG
+#define op_valeurd OP_VALEURD
+#define op_empiler OP_EMPILER
+#define op_affecter OP_AFFECTER
+#define op_add OP_ADD
+#define op_sub OP_SUB
+#define op_mul OP_MUL
+#define op_div OP_DIV
+#define op_mod OP_MOD
+#define op_decaler_gauche OP_DECALER_GAUCHE
+#define op_decaler_droite OP_DECALER_DROITE
+#define op_comparer_sup OP_COMPARER_SUP
+#define op_comparer_inf OP_COMPARER_INF
+#define op_comparer_egal OP_COMPARER_EGAL
+#define op_comparer_sup_egal OP_COMPARER_SUP_EGAL
+#define op_comparer_inf_egal OP_COMPARER_INF_EGAL
+#define op_comparer_diff OP_COMPARER_DIFF
+#define op_aller OP_ALLER
+#define op_aller_si_faux OP_ALLER_SI_FAUX
+#define op_aller_si_pas_sup OP_ALLER_SI_PAS_SUP
+#define op_aller_si_pas_inf OP_ALLER_SI_PAS_INF
+#define op_aller_si_pas_egal OP_ALLER_SI_PAS_EGAL
+#define op_aller_si_pas_sup_egal OP_ALLER_SI_PAS_SUP_EGAL
+#define op_aller_si_pas_inf_egal OP_ALLER_SI_PAS_INF_EGAL
+#define op_aller_si_pas_diff OP_ALLER_SI_PAS_DIFF
+#define op_incr OP_INCR
+#define op_lire OP_LIRE
+#define op_ecrire OP_ECRIRE
+#define op_halte OP_HALTE
+#endif
+
+    int32_t *mem = vm->memory;
+    int32_t *sp = vm->stack - 1;    /* points at the top element */
+    uint64_t executed = 0;
+    /* checked on taken jumps only: every loop takes one */
+    uint64_t limit = vm->fuel ? vm->fuel : UINT64_MAX;
+    VmStatus status = VM_OK;
+    int32_t a, b;
+
+#ifdef VM_THREADED
+    DISPATCH();
+#else
+    for (;;) switch (ip->op) {
+#endif
+
+    CASE(op_valeurg)
+        *++sp = ARG;
+        NEXT();
+    CASE(op_valeurd)
+        *++sp = mem[ARG];
+        NEXT();
+    CASE(op_empiler)
+        *++sp = ARG;
+        NEXT();
+    CASE(op_affecter)
+        b = *sp--;
+        a = *sp--;
+        if ((uint32_t)a >= (uint32_t)vm->prog->nvars) {
+            status = VM_ERR_ADDRESS;
+            goto stop;
+        }
+        mem[a] = b;
+        NEXT();
+    CASE(op_add)
+        b = *sp--;
+        *sp = WRAP((uint32_t)*sp + (uint32_t)b);
+        NEXT();
+    CASE(op_sub)
+        b = *sp--;
+        *sp = WRAP((uint32_t)*sp - (uint32_t)b);
+        NEXT();
+    CASE(op_mul)
+        b = *sp--;
+        *sp = WRAP((uint32_t)*sp * (uint32_t)b);
+        NEXT();
+    CASE(op_div)
+        b = *sp--;
+        if (b == 0) {
+            status = VM_ERR_DIV_ZERO;
+            goto stop;
+        }
+        *sp = (b == -1) ? WRAP(0u - (uint32_t)*sp) : *sp / b;
+        NEXT();
+    CASE(op_mod)
+        b = *sp--;
+        if (b == 0) {
+            status = VM_ERR_DIV_ZERO;
+            goto stop;
+        }
+        *sp = (b == -1) ? 0 : *sp % b;
+        NEXT();
+    CASE(op_decaler_gauche)
+        *sp = WRAP((uint32_t)*sp << ARG);
+        NEXT();
+    CASE(op_decaler_droite)
+        /* arithmetic shift rounds toward -infinity: bias negative values
+           by 2^k - 1 so the result truncates like op_div */
+        a = *sp;
+        *sp = WRAP((uint32_t)a + ((uint32_t)(a >> 31) & ((1u << ARG) - 1))) >> ARG;
+        NEXT();
+    CASE(op_comparer_sup)
+        b = *sp--;
+        *sp = *sp > b;
+        NEXT();
+    CASE(op_comparer_inf)
+        b = *sp--;
+        *sp = *sp < b;
+        NEXT();
+    CASE(op_comparer_egal)
+        b = *sp--;
+        *sp = *sp == b;
+        NEXT();
+    CASE(op_comparer_sup_egal)
+        b = *sp--;
+        *sp = *sp >= b;
+        NEXT();
+    CASE(op_comparer_inf_egal)
+        b = *sp--;
+        *sp = *sp <= b;
+        NEXT();
+    CASE(op_comparer_diff)
+        b = *sp--;
+        *sp = *sp != b;
+        NEXT();
+    CASE(op_aller)
+        JUMP(ARG);
+    CASE(op_aller_si_faux)
+        if (*sp-- == 0) JUMP(ARG);
+        NEXT();
+    CASE(op_aller_si_pas_sup)
+        sp -= 2;
+        if (!(sp[1] > sp[2])) JUMP(ARG);
+        NEXT();
+    CASE(op_aller_si_pas_inf)
+        sp -= 2;
+        if (!(sp[1] < sp[2])) JUMP(ARG);
+        NEXT();
+    CASE(op_aller_si_pas_egal)
+        sp -= 2;
+        if (sp[1] != sp[2]) JUMP(ARG);
+        NEXT();
+    CASE(op_aller_si_pas_sup_egal)
+        sp -= 2;
+        if (sp[1] < sp[2]) JUMP(ARG);
+        NEXT();
+    CASE(op_aller_si_pas_inf_egal)
+        sp -= 2;
+        if (sp[1] > sp[2]) JUMP(ARG);
+        NEXT();
+    CASE(op_aller_si_pas_diff)
+        sp -= 2;
+        if (sp[1] == sp[2]) JUMP(ARG);
+        NEXT();
+    CASE(op_incr)
+        mem[ARG] = WRAP((uint32_t)mem[ARG] + (uint32_t)ARG2);
+        NEXT();
+    CASE(op_lire)
+        if (fscanf(vm->in, "%d", &a) != 1) {
+            status = VM_ERR_INPUT;
+            goto stop;
+        }
+        *++sp = a;
+        NEXT();
+    CASE(op_ecrire)
+        fprintf(vm->out, "%d\n", *sp--);
+        NEXT();
+    CASE(op_halte)
+        ++executed;
+        goto stop;
+
+#ifndef VM_THREADED
+    default:
+        status = VM_ERR_LOAD;
+        goto stop;
+    }
+#endif
+
+out_of_fuel:
+    status = VM_ERR_FUEL;
+stop:
+    vm->pc = PC;
+    vm->executed = executed;
+    return status;
+
+#undef VM_CODE
+#undef VM_BASE
+#undef DISPATCH